@@ -0,0 +1,82 @@
+#ifndef BLE_CMD_H
+#define BLE_CMD_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* huart2 must be created by CubeMX, with hdma_usart2_rx in circular mode */
+extern UART_HandleTypeDef huart2;
+
+/* Output formats for reported UIDs */
+#define BLE_FMT_ASCII   0u   /* "UID:<hex>\r\n" */
+#define BLE_FMT_BINARY  1u   /* A5 LEN UID... CS  (CS makes the sum of LEN..CS zero) */
+
+/* Reader settings that can be changed over the link at runtime.
+   Written only from BLE_CMD_Poll(), i.e. in main-loop context. */
+typedef struct {
+    uint32_t quiet_ms;   /* hold-off after a card was seen */
+    uint32_t idle_ms;    /* poll period while no card is present */
+    uint32_t brty;       /* InListPassiveTarget BrTy; only 0 (106 kbps type A):
+                            FeliCa and type B need InitiatorData, and the
+                            UID parse is type A's */
+    uint32_t fmt;        /* BLE_FMT_* */
+    uint32_t mtu;        /* notification payload size the output is packed to */
+    uint32_t hold_ms;    /* longest a partial notification is held back */
+    uint32_t dbg;        /* diagnostics sink, DBG_SINK_* */
+    uint32_t diag;       /* 1 = diagnostics report wanted; cleared when done */
+    uint32_t prof;       /* 1 = dump scope timings, 2 = dump and clear; cleared when done */
+    uint32_t i2c;        /* 1 = dump the PN532 I2C trace (i2c_trace.h); cleared when done */
+} ReaderConfig_t;
+
+extern ReaderConfig_t reader_cfg;
+
+/* Longest command line accepted, without the line ending */
+#ifndef BLE_CMD_MAX
+#define BLE_CMD_MAX  40u
+#endif
+
+/* Bytes of complete lines queued between the USART2 interrupt and
+   BLE_CMD_Poll() (power of two); lines that do not fit are dropped */
+#ifndef BLE_CMD_QUEUE
+#define BLE_CMD_QUEUE  64u
+#endif
+
+/* Start background reception (receive-to-idle, circular DMA).
+   Call after BLE_Begin(), which still uses blocking reads. */
+void BLE_CMD_Start(void);
+
+/* Execute the oldest queued command line, if any. Never blocks on RX;
+   replies are written to the link. Returns true if a command ran
+   (reader_cfg may have changed). */
+bool BLE_CMD_Poll(void);
+
+/* Called from the USART2 interrupt each time a line is queued for
+   BLE_CMD_Poll(). Weak, empty by default; override to wake the loop. */
+void BLE_CMD_ReadyCallback(void);
+
+/* Commands (one per line, CR/LF terminated):
+     GET                 -> "quiet=.. idle=.. proto=.. fmt=.. mtu=.. hold=.. dbg=.. diag=.. prof=.. i2c=.."
+     SET <key> <value>   -> "OK" or "ERR"      key: quiet|idle|proto|fmt|mtu|hold|dbg|diag|prof|i2c
+     CLK                 -> "burst=<ms> idle=<ms> sw=<switches> sleep=<ms> duty=<permille awake>
+                             [msierr=<ppm found>/<ppm left>]"
+     MET                 -> binary metrics frame (A6 LEN ..., metrics.h), or "BUSY"
+                            while the TX ring cannot take it whole
+     LAT                 -> "n=<taps> lost=<given up> rf=.. i2c=.. fmt=.. queue=.. wire=.. total=.."
+                            (mean us per stage, latency.h)
+     LAT <stage>         -> "n=.. avg=<us> max=<us> h=<b0>,..,<b11>"  stage: rf|i2c|fmt|queue|wire|total
+     LAT RESET           -> "OK", all latency stats cleared
+     NRG                 -> "run_b=<ms> run_i=.. slp_b=.. slp_i=.. rf=.. tx=.. nAh=<charge>"
+                            (residency per state and the estimate, energy.h)
+     NRG UA              -> the current table, uA: the names above and base
+     NRG <state> <uA>    -> "OK" or "ERR", sets one entry of the table
+     NRG RESET           -> "OK", residency cleared */
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* BLE_CMD_H */
@@ -0,0 +1,118 @@
+#ifndef BLE_LINK_H
+#define BLE_LINK_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* huart2 must be created by CubeMX (BLE module on PA2/PA3) */
+extern UART_HandleTypeDef huart2;
+
+/* Rate the module ships with; also the fallback when negotiation fails */
+#ifndef BLE_BAUD_DEFAULT
+#define BLE_BAUD_DEFAULT      9600u
+#endif
+
+/* Highest rate we will ask the module for */
+#ifndef BLE_BAUD_MAX
+#define BLE_BAUD_MAX          115200u
+#endif
+
+/* Data EEPROM slot for the last good rate: word + inverted copy (8 bytes) */
+#ifndef BLE_BAUD_EEPROM_ADDR
+#define BLE_BAUD_EEPROM_ADDR  (FLASH_EEPROM_BASE + 0x00u)
+#endif
+
+/* Number of AT/OK round trips a new rate must survive before we keep it */
+#ifndef BLE_ECHO_ROUNDS
+#define BLE_ECHO_ROUNDS       8u
+#endif
+
+/* TX ring drained by DMA in the background (power of two) */
+#ifndef BLE_TX_SIZE
+#define BLE_TX_SIZE           128u
+#endif
+
+/* Ring fill level above which producers should hold back */
+#ifndef BLE_TX_HIWAT
+#define BLE_TX_HIWAT          (BLE_TX_SIZE * 3u / 4u)
+#endif
+
+/* Output coalescing: bytes are released to the wire in chunks of one BLE
+   notification payload (20 for the default ATT MTU, up to 244 with DLE),
+   or earlier once the oldest queued byte has waited BLE_HOLD_MS. A chunk
+   must fill without tripping BLE_TX_HIWAT, so the default ring takes up
+   to 96. 244 needs -DBLE_TX_SIZE=512 (mark 384): 384 B more static RAM,
+   out of 4 KB on the L100C6. 256 is not enough, its mark is 192. */
+#ifndef BLE_NOTIFY_SIZE
+#define BLE_NOTIFY_SIZE       20u
+#endif
+#ifndef BLE_HOLD_MS
+#define BLE_HOLD_MS           10u
+#endif
+
+/* Bring module and USART2 to the fastest rate that passes the echo check.
+   Tries the persisted rate first, so a normal reboot costs one AT round trip.
+   Falls back to BLE_BAUD_DEFAULT if the module cannot be found.
+   Call once after MX_USART2_UART_Init(), before anything else uses huart2.
+   Returns the rate in use. */
+uint32_t BLE_Begin(void);
+
+/* Rate USART2 is currently programmed for */
+uint32_t BLE_GetBaud(void);
+
+/* Reprogram USART2 only (the module is not told). Not while TX is queued. */
+bool BLE_SetLocalBaud(uint32_t baud);
+
+/* Queue bytes for transmission. All or nothing, never blocks: returns false
+   and queues nothing if the ring cannot take all of it. With RTS/CTS the
+   USART stops on its own while the module holds CTS; the ring absorbs that. */
+bool BLE_Write(const void *data, uint16_t len);
+
+/* BLE_Write() that also follows these bytes out: BLE_TxMarkStartCallback()
+   runs when the DMA transfer holding the first one starts, and
+   BLE_TxMarkSentCallback() once the last one has left the USART. One mark
+   at a time; a new marked write replaces an unfinished one. Both callbacks
+   are weak and empty, and may run in interrupt context. */
+bool BLE_WriteMarked(const void *data, uint16_t len);
+void BLE_TxMarkStartCallback(void);
+void BLE_TxMarkSentCallback(void);
+
+/* The USART starts (true) or stops (false) sending, in interrupt or
+   BLE_Write() context; back-to-back chunks count as one stretch. Weak,
+   empty by default. */
+void BLE_TxActiveCallback(bool active);
+
+/* Free space in the TX ring */
+uint16_t BLE_TxFree(void);
+
+/* True while the ring is above BLE_TX_HIWAT: the module is holding CTS or
+   the wire cannot keep up. Producers should coalesce or slow down. */
+bool BLE_Backpressure(void);
+
+/* Wait until everything queued has left, up to timeout_ms. Bypasses the
+   hold timer. */
+bool BLE_Flush(uint32_t timeout_ms);
+
+/* Change chunk size (1..BLE_TX_HIWAT) and hold time; hold_ms = 0 sends at
+   once. Returns false, and keeps the chunk size, if it is out of range; the
+   hold time is taken either way. */
+bool BLE_SetCoalesce(uint16_t chunk, uint16_t hold_ms);
+
+/* Release held bytes whose hold time is up. Called from SysTick_Handler. */
+void BLE_Tick(void);
+
+/* Stop starting transfers and wait up to timeout_ms for the one in flight,
+   e.g. before the USART clock changes. Returns false (still paused) if the
+   DMA did not finish, typically because the module is holding CTS. */
+bool BLE_TxPause(uint32_t timeout_ms);
+void BLE_TxResume(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* BLE_LINK_H */
@@ -0,0 +1,58 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* huart2 and hi2c1 are retimed on every switch */
+extern UART_HandleTypeDef huart2;
+extern I2C_HandleTypeDef  hi2c1;
+
+typedef enum {
+    CLK_IDLE = 0,   /* low MSI range, voltage range 3, 0 WS; I2C off */
+    CLK_BURST,      /* HSI + PLL 32 MHz, voltage range 1, 1 WS, ACC64 + prefetch */
+    CLK_N
+} ClkProfile_t;
+
+/* Lowest MSI range (0..5) idle may use. The range actually used is raised
+   until USART2 can still run its current baud rate (PCLK >= 16 x baud). */
+#ifndef CLK_IDLE_MSI_MIN
+#define CLK_IDLE_MSI_MIN  3u        /* 524 kHz */
+#endif
+
+/* I2C SCL while in burst */
+#ifndef CLK_I2C_HZ
+#define CLK_I2C_HZ        400000u
+#endif
+
+/* Longest wait for an in-flight BLE DMA transfer before a switch is skipped */
+#ifndef CLK_TX_WAIT_MS
+#define CLK_TX_WAIT_MS    20u
+#endif
+
+/* Call once USART2 and I2C1 are initialised. Enters CLK_BURST. */
+void CLK_Init(void);
+
+/* Switch profile; no-op if already there. Returns false if the switch was
+   skipped (BLE transfer stuck behind CTS, or an RCC error). I2C runs at
+   CLK_I2C_HZ in CLK_BURST; in idle it is slow or off, so talk to the PN532
+   in CLK_BURST only. A byte arriving on USART2 during the switch may be
+   lost. Main-loop context only. */
+bool CLK_Set(ClkProfile_t p);
+ClkProfile_t CLK_Get(void);
+
+/* Milliseconds spent in a profile since CLK_Init, including the current stay */
+uint32_t CLK_TimeIn(ClkProfile_t p);
+
+/* Profile switches since CLK_Init */
+uint32_t CLK_Switches(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CLOCK_H */
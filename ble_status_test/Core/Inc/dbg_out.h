@@ -0,0 +1,54 @@
+#ifndef DBG_OUT_H
+#define DBG_OUT_H
+
+#include "stm32l1xx_hal.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Where diagnostics go */
+#define DBG_SINK_NONE  0u
+#define DBG_SINK_BLE   1u   /* the BLE UART ring, only while it has headroom */
+#define DBG_SINK_SWO   2u   /* ITM text port (PB3), see trace.h */
+
+#ifndef DBG_SINK_DEFAULT
+#define DBG_SINK_DEFAULT  DBG_SINK_BLE
+#endif
+
+/* Longest formatted line; DBG_Printf formats on the stack, never mallocs */
+#ifndef DBG_LINE_MAX
+#define DBG_LINE_MAX  64u
+#endif
+
+/* Set to 1 if newlib printf() is used: stdout is made unbuffered so stdio
+   never allocates a buffer out of the 0x200 heap. */
+#ifndef DBG_STDIO
+#define DBG_STDIO  0
+#endif
+
+void DBG_Init(void);
+
+void    DBG_SetSink(uint8_t sink);
+uint8_t DBG_GetSink(void);
+
+/* Bounded time, never blocks: what the sink cannot take right now is
+   dropped and counted. Returns bytes accepted. _write() for stdout and
+   stderr lands here. The BLE sink takes main-loop writes only. */
+uint16_t DBG_Write(const void *data, uint16_t len);
+
+/* printf subset: %c %s %d %i %u %x %X %%, optional '0' flag, width and
+   'l'. Output longer than DBG_LINE_MAX is cut. Returns bytes accepted. */
+int DBG_Printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+int DBG_Format(char *buf, uint16_t size, const char *fmt, va_list ap);
+
+/* Bytes dropped since boot */
+uint32_t DBG_Dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DBG_OUT_H */
@@ -0,0 +1,77 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Energy model without a power analyser: residency of each MCU and
+   peripheral state, updated at every transition (TMR_Micros() time), times
+   a current table gives the charge drawn since boot or NRG_Reset(). The
+   table starts from the NRG_UA_* typicals below and can be replaced at run
+   time with figures measured on the board (NRG command, ble_cmd.h). */
+
+typedef enum {
+    NRG_RUN_BURST = 0,   /* MCU awake, CLK_BURST    } exactly one */
+    NRG_RUN_IDLE,        /* MCU awake, CLK_IDLE     } of these four */
+    NRG_SLEEP_BURST,     /* MCU in WFI, CLK_BURST   } at a time */
+    NRG_SLEEP_IDLE,      /* MCU in WFI, CLK_IDLE    } */
+    NRG_RF,              /* PN532 field on for a card poll, on top of BASE */
+    NRG_UART_TX,         /* BLE UART transmitting, on top of BASE */
+    NRG_BASE,            /* always: PN532 and BLE module idle, regulator */
+    NRG_N
+} NrgState_t;
+
+/* Default currents, uA */
+#ifndef NRG_UA_RUN_BURST
+#define NRG_UA_RUN_BURST    7400u    /* 32 MHz, range 1, from flash */
+#endif
+#ifndef NRG_UA_RUN_IDLE
+#define NRG_UA_RUN_IDLE      150u    /* MSI ~1 MHz, range 3 */
+#endif
+#ifndef NRG_UA_SLEEP_BURST
+#define NRG_UA_SLEEP_BURST  1800u
+#endif
+#ifndef NRG_UA_SLEEP_IDLE
+#define NRG_UA_SLEEP_IDLE     40u
+#endif
+#ifndef NRG_UA_RF
+#define NRG_UA_RF         100000u    /* PN532 with the antenna driven */
+#endif
+#ifndef NRG_UA_UART_TX
+#define NRG_UA_UART_TX      8000u    /* BLE module radio active */
+#endif
+#ifndef NRG_UA_BASE
+#define NRG_UA_BASE        10000u
+#endif
+
+/* Start accounting, awake in CLK_BURST. Call after CLK_Init(). */
+void NRG_Init(void);
+
+/* MCU transitions: TMR_Sleep() around WFI, CLK_Set() after a switch */
+void NRG_Sleep(bool asleep);
+void NRG_Clock(bool burst);
+
+/* Peripheral states (NRG_RF, NRG_UART_TX); ISR-safe */
+void NRG_Set(NrgState_t s, bool on);
+
+uint32_t NRG_ResidencyMs(NrgState_t s);
+
+/* Charge drawn by all states, nAh */
+uint32_t NRG_ChargeNAh(void);
+
+const char *NRG_Name(NrgState_t s);
+uint32_t NRG_GetUA(NrgState_t s);
+bool     NRG_SetUA(NrgState_t s, uint32_t ua);
+
+/* Clear the residency counters; the current table stays */
+void NRG_Reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* ENERGY_H */
@@ -0,0 +1,63 @@
+#ifndef I2C_TRACE_H
+#define I2C_TRACE_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Always-on flight recorder for the PN532 I2C traffic: the last
+   I2CT_DEPTH transactions with direction, length, HAL status, start time,
+   duration and the first I2CT_BYTES bytes. Repeats of the same 1-byte
+   status read are folded into one entry, so a ready poll does not wipe
+   the history. The ring is frozen while it is dumped, as text lines on
+   the diagnostics sink; tools/i2c_timeline.c turns a dump back into an
+   annotated PN532 protocol timeline. Main-loop use only. */
+
+/* Recording: while TRACE_PORT_I2C is on (trace.h), every transaction also
+   goes out on SWO in full, whether or not the ring is frozen: a header
+   word (I2CT_REC_HDR), the start time in us, then the bytes. swo_decode
+   prints these as dump lines with every byte, a transcript that
+   tools/host/i2c_replay.h feeds back to the driver on the host. */
+#define I2CT_REC_MAGIC  0xC2u
+#define I2CT_REC_HDR(rx, st, dur_us, len)                                       \
+    (((uint32_t)I2CT_REC_MAGIC << 24) | ((uint32_t)((rx) ? 1u : 0u) << 23) |    \
+     (((uint32_t)(st) & 3u) << 21) | (((uint32_t)(dur_us) & 0x1FFFu) << 8) |    \
+     ((uint32_t)(len) & 0xFFu))
+
+/* Entries kept (power of two) and bytes captured per entry */
+#ifndef I2CT_DEPTH
+#define I2CT_DEPTH    16u
+#endif
+#ifndef I2CT_BYTES
+#define I2CT_BYTES    8u
+#endif
+
+/* Faults in a row (I2CT_Fault() without I2CT_Clean() in between) that
+   ask for a dump */
+#ifndef I2CT_STREAK
+#define I2CT_STREAK   4u
+#endif
+
+/* Record one transaction that started at TMR_Micros() == t0_us */
+void I2CT_Record(bool rx, const uint8_t *data, uint16_t len, HAL_StatusTypeDef st, uint32_t t0_us);
+
+/* Protocol outcome of an exchange. I2CT_Fault() returns true once per
+   streak, when it reaches I2CT_STREAK: time to dump. */
+bool I2CT_Fault(void);
+void I2CT_Clean(void);
+
+/* Freeze the ring and return the number of dump lines; I2CT_Line(i) for
+   i below that writes line i ("I2C BEGIN ...", one "I2C <t_us> ..." per
+   entry oldest first, "I2C END"). I2CT_Resume() starts recording again. */
+uint8_t  I2CT_Freeze(void);
+uint16_t I2CT_Line(uint8_t i, char *buf, uint16_t size);
+void     I2CT_Resume(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* I2C_TRACE_H */
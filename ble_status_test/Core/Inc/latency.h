@@ -0,0 +1,81 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Tap-to-notification latency: from the start of the poll that first sees
+   a card to the last byte of its UID event leaving the USART, split into
+   stages and kept as log2 histograms in static RAM. One event is followed
+   at a time; taps while it is in flight are not timed. Times are
+   TMR_Micros() readings. Read out and cleared with the LAT command
+   (ble_cmd.h). */
+
+/* Stages; LAT_TOTAL is the whole span, the others add up to it */
+typedef enum {
+    LAT_RF = 0,        /* poll start to PN532 ready: command, RF, anticollision */
+    LAT_I2C,           /* response frame read and parsed */
+    LAT_FORMAT,        /* UID event formatted and handed to the link */
+    LAT_QUEUE,         /* waiting: UID queue, BLE ring, notification hold */
+    LAT_WIRE,          /* first byte's DMA start to last byte sent */
+    LAT_TOTAL,
+    LAT_N
+} LatStage_t;
+
+/* Time points, in the order they are taken */
+typedef enum {
+    LAT_T_POLL = 0,    /* poll started */
+    LAT_T_READY,       /* PN532 signalled the response ready */
+    LAT_T_READ,        /* UID parsed */
+    LAT_T_FMT0,        /* output of the event started */
+    LAT_T_FMT1,        /* event formatted, about to be queued */
+    LAT_T_TXSTART,     /* DMA picked up its first byte */
+    LAT_T_N
+} LatPoint_t;
+
+/* Bucket 0 holds values below LAT_BASE_US, bucket k >= 1 holds
+   [LAT_BASE_US * 2^(k-1), LAT_BASE_US * 2^k), the last one everything above */
+#define LAT_BUCKETS  12u
+#define LAT_BASE_US  128u
+
+/* An event not finished after this long is given up (LAT_Lost) */
+#ifndef LAT_STALE_US
+#define LAT_STALE_US  2000000u
+#endif
+
+typedef struct {
+    uint32_t n;
+    uint32_t max;        /* us */
+    uint64_t sum;        /* us */
+} LatStats_t;
+
+/* A new UID event: start following it with the first three points.
+   Returns false (event not timed) while another one is still in flight. */
+bool LAT_Begin(uint32_t poll_us, uint32_t ready_us, uint32_t read_us);
+
+/* Stop following the event, e.g. when it was dropped before output */
+void LAT_Cancel(void);
+
+/* Take a later point now; ignored when no event is followed. TXSTART is
+   ISR-safe. */
+void LAT_Stamp(LatPoint_t p);
+
+/* Last byte sent: record every stage and finish. ISR-safe. */
+void LAT_Done(void);
+
+bool LAT_Busy(void);
+void LAT_Stats(LatStage_t s, LatStats_t *out);
+const uint16_t *LAT_Hist(LatStage_t s);       /* LAT_BUCKETS saturating counts */
+const char *LAT_Name(LatStage_t s);
+uint32_t LAT_Lost(void);
+void LAT_Reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* LATENCY_H */
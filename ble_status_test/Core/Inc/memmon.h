@@ -0,0 +1,49 @@
+#ifndef MEMMON_H
+#define MEMMON_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* RAM budget monitor. At boot the free RAM between the heap and the stack
+   is painted; a later scan, a few words at a time, finds the lowest word
+   the stack has overwritten. Headroom is the untouched gap between the
+   heap's high-water mark (from _sbrk in sysmem.c) and that stack peak.
+   When it falls below MEM_WARN_BYTES a warning goes to the diagnostics
+   sink and a TRACE_EV_MEMLOW event is emitted, again at each new low. */
+
+/* Headroom below which to warn */
+#ifndef MEM_WARN_BYTES
+#define MEM_WARN_BYTES   256u
+#endif
+
+/* Bytes left unpainted below the caller's stack pointer in MEM_Paint() */
+#ifndef MEM_PAINT_GUARD
+#define MEM_PAINT_GUARD  64u
+#endif
+
+/* Paint free RAM. Call first thing in main(), before anything deep runs. */
+void MEM_Paint(void);
+
+/* Check up to 'words' words of the current pass. Returns true when a pass
+   has finished and the figures below are fresh. Bounded, never stalls. */
+bool MEM_Scan(uint16_t words);
+
+/* Deepest stack use seen (bytes below _estack) and the gap left, in bytes */
+uint32_t MEM_StackPeak(void);
+uint32_t MEM_Headroom(void);
+
+/* _sbrk bookkeeping (sysmem.c): bytes handed out now and at most, and
+   requests refused because they would run into the stack reserve */
+uint32_t SYSMEM_HeapUsed(void);
+uint32_t SYSMEM_HeapPeak(void);
+uint32_t SYSMEM_HeapFails(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* MEMMON_H */
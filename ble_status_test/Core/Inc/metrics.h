@@ -0,0 +1,72 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Fleet metrics: fixed counters and log2 histograms in static RAM. An
+   update is one load/add/store, so each counter has exactly one writer
+   context (noted below); readers may see it a step behind. The whole set
+   is scraped in one binary frame with the MET command (ble_cmd.h). */
+
+/* Counters; the snapshot carries them in this order */
+typedef enum {
+    MET_POLLS = 0,       /* card polls run                          main */
+    MET_HITS,            /* polls that found a card                 main */
+    MET_UIDS,            /* new UID events                          main */
+    MET_UID_DROPPED,     /* UID events lost to a full queue         main */
+    MET_ACK_FAIL,        /* PN532 ACK missing or wrong              main */
+    MET_FRAME_ERR,       /* response frame bad (LCS/DCS/format)     main */
+    MET_I2C_ERR,         /* HAL I2C errors and timeouts             main */
+    MET_READY_TIMEOUT,   /* PN532 not ready in time, card wait aside main */
+    MET_BLE_FULL,        /* UID writes refused by the BLE ring      main */
+    MET_CMDS,            /* command lines run                       main */
+    MET_CMD_DROPPED,     /* command lines lost, queue full          USART2 ISR */
+    MET_DBG_DROPPED,     /* diagnostic bytes dropped (DBG_Dropped)  sampled */
+    MET_SCHED_DROPPED,   /* scheduler posts lost (SCHED_Dropped)    sampled */
+    MET_STACK_PEAK,      /* deepest stack use seen, bytes           sampled */
+    MET_RAM_HEADROOM,    /* free gap between heap and stack, bytes  sampled */
+    MET_HEAP_PEAK,       /* most heap handed out by _sbrk, bytes    sampled */
+    MET_CHARGE_NAH,      /* estimated charge drawn (energy.h), nAh  sampled */
+    MET_N
+} MetricId_t;
+
+/* Histograms, all main-loop; bucket k holds values in [2^(k-1), 2^k),
+   bucket 0 holds 0 and the last one everything above */
+typedef enum {
+    MET_H_UID_MS = 0,    /* poll start to UID event queued, ms */
+    MET_H_POLL_MS,       /* whole poll, ms */
+    MET_H_N
+} MetricHist_t;
+
+#define MET_BUCKETS   8u
+
+/* Snapshot frame, little endian:
+     A6 LEN | VER N_CNT N_HIST N_BKT | uptime_s:u32 | cnt[N_CNT]:u32 |
+     hist[N_HIST][N_BKT]:u16 (saturating) | CS
+   LEN counts the bytes from VER up to CS; CS makes the sum of LEN..CS zero,
+   as in the binary UID frame. */
+#define MET_FRAME_MAGIC    0xA6u
+#define MET_FRAME_VERSION  1u
+#define MET_FRAME_SIZE     (2u + 4u + 4u + 4u * MET_N + 2u * MET_H_N * MET_BUCKETS + 1u)
+
+extern uint32_t met_count[MET_N];
+
+static inline void MET_Inc(MetricId_t id)                { met_count[id]++; }
+static inline void MET_Add(MetricId_t id, uint32_t n)    { met_count[id] += n; }
+static inline void MET_Set(MetricId_t id, uint32_t v)    { met_count[id] = v; }
+
+void MET_Observe(MetricHist_t h, uint32_t value);
+
+/* Build the snapshot frame; buf must hold MET_FRAME_SIZE. Returns its length. */
+uint16_t MET_Snapshot(uint8_t *buf);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* METRICS_H */
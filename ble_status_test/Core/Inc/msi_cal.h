@@ -0,0 +1,59 @@
+#ifndef MSI_CAL_H
+#define MSI_CAL_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* MSI calibration against the 32.768 kHz LSE. TIM10 input 1 is remapped to
+   the LSE and captures every 8th LSE edge with SYSCLK as the timer clock,
+   so the MSI frequency is measured directly; RCC_ICSCR.MSITRIM is then
+   stepped towards zero error. Only meaningful while SYSCLK is the MSI. */
+
+#ifndef MSICAL_LSE_HZ
+#define MSICAL_LSE_HZ      32768u
+#endif
+
+/* Captures per measurement (8 LSE periods each): 64 -> 15.6 ms */
+#ifndef MSICAL_CAPTURES
+#define MSICAL_CAPTURES    64u
+#endif
+
+/* Trim steps tried per run */
+#ifndef MSICAL_STEPS
+#define MSICAL_STEPS       8u
+#endif
+
+/* Suggested interval between runs, for drift over temperature */
+#ifndef MSICAL_PERIOD_MS
+#define MSICAL_PERIOD_MS   60000u
+#endif
+
+/* Start the LSE (does not wait; a missing crystal only makes MSICAL_Step
+   find nothing) */
+void MSICAL_Init(void);
+
+/* One measurement of a run, 15.6 ms with the defaults: the first finds the
+   error, each later one tries the next trim step. Returns true when the run
+   is over and false while another call is wanted. A run that cannot start
+   (LSE not running, SYSCLK not the MSI, a missed capture) ends at once
+   without touching the trim; one cut short later keeps the best trim so
+   far. */
+bool MSICAL_Step(void);
+
+/* Error of the MSI against its nominal frequency in ppm: as found by the
+   last run before trimming, and what was left after it. False until the
+   first successful run. */
+bool MSICAL_Error(int32_t *found_ppm, int32_t *left_ppm);
+
+/* Current MSITRIM value (signed, added to the factory MSICAL) */
+int8_t MSICAL_Trim(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* MSI_CAL_H */
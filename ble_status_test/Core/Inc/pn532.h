@@ -17,7 +17,9 @@ extern "C" {
 /* hi2c1 must be created by CubeMX */
 extern I2C_HandleTypeDef hi2c1;
 
-/* Basic init: wakes chip and puts it in “Normal mode” for host control */
+/* Basic init: wakes chip and puts it in “Normal mode” for host control.
+   No fixed delay and no firmware query; call PN532_GetFirmwareVersion
+   separately if the identity is wanted. */
 bool PN532_Begin(void);
 
 /* Optional: read firmware version (IC, Ver, Rev, Support) into 32-bit */
@@ -27,7 +29,8 @@ bool PN532_GetFirmwareVersion(uint32_t *out);
    mode=0x01 (Normal), timeout=0x14 (50ms), use_irq=0x01/0x00 (ignored if no IRQ) */
 bool PN532_SAMConfiguration(void);
 
-/* Scan for one ISO14443A (106 kbps) card; returns UID bytes and len.
+/* Scan for one ISO14443A (106 kbps) card; returns UID bytes (up to 10,
+   uid must hold that many) and len.
    timeout_ms is overall wait time for a response frame. */
 bool PN532_ReadPassiveTargetA(uint8_t *uid, uint8_t *uid_len, uint16_t timeout_ms);
 
@@ -0,0 +1,74 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Scope timing on the DWT cycle counter. A scope is bracketed with
+   PROF_START(t) ... PROF_STOP(PROF_xxx, t); each stop adds one sample to a
+   fixed table (count, min, max, sum). Samples are converted to 0.1 us at the
+   clock running at the stop, so burst and idle profiles compare. Time the
+   core spends in WFI inside a scope is added back from SysTick (CYCCNT may
+   stop while the core sleeps). Built with PROF_ENABLE 0 the macros are
+   empty and nothing is linked in. */
+
+#ifndef PROF_ENABLE
+#ifdef DEBUG
+#define PROF_ENABLE  1
+#else
+#define PROF_ENABLE  0
+#endif
+#endif
+
+/* Scopes; names in prof.c */
+typedef enum {
+    PROF_PN532_TX = 0,   /* command frame out over I2C */
+    PROF_PN532_READY,    /* polling the status byte until ready */
+    PROF_PN532_ACK,      /* ACK frame read */
+    PROF_PN532_RX,       /* response frame read */
+    PROF_PN532_PARSE,    /* response frame checks */
+    PROF_POLL,           /* whole InListPassiveTarget round */
+    PROF_BLE_PRINT,      /* formatting + queueing one UID event */
+    PROF_CMD,            /* one command line */
+    PROF_N
+} ProfId_t;
+
+#if PROF_ENABLE
+
+#define PROF_START(t)       uint32_t t = PROF_Now()
+#define PROF_STOP(id, t)    PROF_Add((id), PROF_Now() - (t))
+
+void     PROF_Init(void);
+uint32_t PROF_Now(void);
+void     PROF_Add(ProfId_t id, uint32_t cycles);
+
+/* From TMR_Sleep(): c0 = PROF_Now() before WFI, counts = core cycles the
+   SysTick saw pass */
+void     PROF_Slept(uint32_t c0, uint32_t counts);
+
+#else
+
+#define PROF_START(t)       ((void)0)
+#define PROF_STOP(id, t)    ((void)0)
+
+static inline void     PROF_Init(void) { }
+static inline uint32_t PROF_Now(void) { return 0u; }
+static inline void     PROF_Slept(uint32_t c0, uint32_t counts) { (void)c0; (void)counts; }
+
+#endif
+
+/* Format scope i as "name n=.. min=.. avg=.. max=.. us" into buf. Returns
+   the length, 0 past the last scope, for empty scopes, or when compiled out. */
+uint16_t PROF_Line(uint8_t i, char *buf, uint16_t size);
+
+void PROF_Reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* PROF_H */
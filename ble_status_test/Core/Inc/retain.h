@@ -0,0 +1,56 @@
+#ifndef RETAIN_H
+#define RETAIN_H
+
+#include "stm32l1xx_hal.h"
+#include "metrics.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* State that survives a warm restart (NRST pin, software, watchdog or
+   fault reset) in the .noinit RAM section, which the startup code leaves
+   alone. A checksum and the reset flags decide whether it is trusted: after
+   power-on, or when the block does not check out, it starts from zero.
+   Fields are read and written directly, in main-loop context; RET_Commit()
+   seals them again. */
+
+/* Cause of a fault reset, for the next boot to report once and clear.
+   Only set right before the reset. */
+#define RET_FAULT_NONE     0u
+#define RET_FAULT_HARD     1u   /* HardFault, reset by the handler */
+#define RET_FAULT_ERROR    2u   /* Error_Handler(), reset */
+
+typedef struct {
+    uint32_t magic;
+    uint16_t size;           /* sizeof(RetState_t): a new layout is not trusted */
+    uint16_t warm_boots;     /* restarts that resumed from this block */
+    uint8_t  pn532_ready;    /* SAMConfiguration done and no PN532 fault since */
+    uint8_t  fault;          /* RET_FAULT_* */
+    uint8_t  reset_flags;    /* RCC_CSR reset flags of this boot, >> 24 */
+    uint8_t  last_len;       /* reader debounce: card in the field, 0 = none */
+    uint8_t  last_uid[10];
+    uint16_t pad;
+    uint32_t met[MET_N];     /* met_count as of the last commit */
+    uint32_t sum;
+} RetState_t;
+
+extern RetState_t ret_state;
+
+/* Call once, early in main(). Reads and clears the reset flags; restores
+   met_count on a warm restart. Returns true if the block was resumed. */
+bool RET_Boot(void);
+
+/* Copy met_count in and reseal the block */
+void RET_Commit(void);
+
+/* Note the cause of the reset about to follow and commit; safe from fault
+   handlers */
+void RET_Fault(uint8_t cause);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* RETAIN_H */
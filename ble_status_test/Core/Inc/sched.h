@@ -0,0 +1,49 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Run-to-completion scheduler. Work is a deferred call (function + argument)
+   posted into one of a few fixed queues, one per priority; the loop always
+   takes the oldest call from the highest non-empty queue and runs it to the
+   end. Timers (tmr.h) post or run their own work. With nothing queued and
+   no timer due, the core sleeps until the next timer or interrupt.
+   All memory is static: SCHED_PRIO_N x SCHED_QUEUE_LEN slots. */
+
+typedef void (*SchedFn)(void *arg);
+
+#define SCHED_PRIO_HIGH    0u   /* commands, output */
+#define SCHED_PRIO_NORMAL  1u   /* card polling */
+#define SCHED_PRIO_LOW     2u   /* housekeeping */
+#define SCHED_PRIO_N       3u
+
+/* Slots per priority (power of two) */
+#ifndef SCHED_QUEUE_LEN
+#define SCHED_QUEUE_LEN    8u
+#endif
+
+/* Queue fn(arg). Safe from interrupts and from tasks. Returns false and
+   counts a drop if that priority's queue is full. */
+bool SCHED_Post(SchedFn fn, void *arg, uint8_t prio);
+
+/* Run the highest-priority queued call, if any. Returns true if one ran. */
+bool SCHED_RunOnce(void);
+
+/* Loop forever: queued calls, then due timers, then idle() (may be NULL)
+   followed by TMR_Sleep(). idle() is where the caller drops its clock. */
+__NO_RETURN void SCHED_Run(void (*idle)(void));
+
+/* Calls lost to full queues, and the deepest any queue has been */
+uint32_t SCHED_Dropped(void);
+uint8_t  SCHED_HighWater(uint8_t prio);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* SCHED_H */
@@ -0,0 +1,141 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Lock-free single-producer/single-consumer ring, generated per element type:
+
+     SPSC_DEFINE(uidq, UidEvent_t, 4)     ->  uidq_t, uidq_push(), uidq_pop(), ...
+
+   One context only ever pushes and one only ever pops (e.g. an ISR and the
+   main loop); then no interrupt masking is needed. Indices are free-running
+   16-bit counters, the size a power of two up to 32768, so head - tail is
+   the fill level and full and empty need no spare slot. Only the producer
+   writes head, only the consumer writes tail; a DMB orders the element
+   copy against the index update. The Cortex-M3 has no data cache, so the
+   indices are not padded apart. A zero-initialised ring is empty.
+
+   Generated functions (r is a pointer to the ring):
+     count(r), space(r)            fill level / free slots, from either side
+     push(r, &v), pop(r, &v)       one element; false when full / empty
+     push_n(r, v, n)               up to n elements, returns how many
+     push_all(r, v, n)             all n or none
+     pop_n(r, v, n)                up to n elements, returns how many
+     span(r, &p)                   consumer: p = oldest element, returns how
+                                   many follow contiguously (for DMA)
+     drop(r, n)                    consumer: release n elements from span() */
+
+#define SPSC_DEFINE(name, type, size)                                          \
+typedef struct {                                                               \
+    type              buf[size];                                               \
+    volatile uint16_t head;                                                    \
+    volatile uint16_t tail;                                                    \
+} name##_t;                                                                    \
+                                                                               \
+typedef char name##_size_check[((size) & ((size) - 1u)) == 0 &&                \
+                               (size) <= 32768u ? 1 : -1];                     \
+                                                                               \
+static inline uint16_t name##_count(const name##_t *r)                         \
+{                                                                              \
+    return (uint16_t)(r->head - r->tail);                                      \
+}                                                                              \
+                                                                               \
+static inline uint16_t name##_space(const name##_t *r)                         \
+{                                                                              \
+    return (uint16_t)((size) - name##_count(r));                               \
+}                                                                              \
+                                                                               \
+/* copy n elements in at head, in up to two runs; caller checked space */      \
+static inline void name##_put(name##_t *r, uint16_t head,                      \
+                              const type *v, uint16_t n)                       \
+{                                                                              \
+    uint16_t off = (uint16_t)(head & ((size) - 1u));                           \
+    uint16_t run = (uint16_t)((size) - off);                                   \
+    if (run > n) run = n;                                                      \
+    memcpy(&r->buf[off], v, run * sizeof(type));                               \
+    memcpy(&r->buf[0], v + run, (uint16_t)(n - run) * sizeof(type));           \
+    __DMB();                                /* elements before index */        \
+    r->head = (uint16_t)(head + n);                                            \
+}                                                                              \
+                                                                               \
+static inline uint16_t name##_push_n(name##_t *r, const type *v, uint16_t n)   \
+{                                                                              \
+    uint16_t head = r->head;                                                   \
+    uint16_t room = (uint16_t)((size) - (uint16_t)(head - r->tail));           \
+    if (n > room) n = room;                                                    \
+    if (n) name##_put(r, head, v, n);                                          \
+    return n;                                                                  \
+}                                                                              \
+                                                                               \
+static inline bool name##_push_all(name##_t *r, const type *v, uint16_t n)     \
+{                                                                              \
+    uint16_t head = r->head;                                                   \
+    if (n > (uint16_t)((size) - (uint16_t)(head - r->tail))) return false;     \
+    if (n) name##_put(r, head, v, n);                                          \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool name##_push(name##_t *r, const type *v)                     \
+{                                                                              \
+    uint16_t head = r->head;                                                   \
+    if ((uint16_t)(head - r->tail) >= (size)) return false;                    \
+    r->buf[head & ((size) - 1u)] = *v;                                         \
+    __DMB();                                                                   \
+    r->head = (uint16_t)(head + 1u);                                           \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline uint16_t name##_span(name##_t *r, type **p)                      \
+{                                                                              \
+    uint16_t tail = r->tail;                                                   \
+    uint16_t n    = (uint16_t)(r->head - tail);                                \
+    uint16_t off  = (uint16_t)(tail & ((size) - 1u));                          \
+    __DMB();                                /* index before elements */        \
+    if (n > (size) - off) n = (uint16_t)((size) - off);                        \
+    *p = &r->buf[off];                                                         \
+    return n;                                                                  \
+}                                                                              \
+                                                                               \
+static inline void name##_drop(name##_t *r, uint16_t n)                        \
+{                                                                              \
+    __DMB();                                /* reads before release */         \
+    r->tail = (uint16_t)(r->tail + n);                                         \
+}                                                                              \
+                                                                               \
+static inline uint16_t name##_pop_n(name##_t *r, type *v, uint16_t n)          \
+{                                                                              \
+    uint16_t got = 0;                                                          \
+    while (got < n) {                                                          \
+        type    *p;                                                            \
+        uint16_t run = name##_span(r, &p);                                     \
+        if (run == 0) break;                                                   \
+        if (run > n - got) run = (uint16_t)(n - got);                          \
+        memcpy(v + got, p, run * sizeof(type));                                \
+        name##_drop(r, run);                                                   \
+        got = (uint16_t)(got + run);                                           \
+    }                                                                          \
+    return got;                                                                \
+}                                                                              \
+                                                                               \
+static inline bool name##_pop(name##_t *r, type *v)                            \
+{                                                                              \
+    uint16_t tail = r->tail;                                                   \
+    if (r->head == tail) return false;                                         \
+    __DMB();                                                                   \
+    *v = r->buf[tail & ((size) - 1u)];                                         \
+    __DMB();                                                                   \
+    r->tail = (uint16_t)(tail + 1u);                                           \
+    return true;                                                               \
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* SPSC_H */
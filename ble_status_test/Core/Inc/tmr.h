@@ -0,0 +1,66 @@
+#ifndef TMR_H
+#define TMR_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Software timers on the HAL millisecond tick, plus a tickless sleep: while
+   nothing is due, SysTick is reprogrammed to fire once at the next deadline
+   instead of every millisecond, and uwTick is caught up on wake-up, so
+   HAL_GetTick() and every HAL timeout stay correct. The core sleeps (WFI);
+   DMA, USART and I2C keep running and any interrupt ends the sleep early.
+   HAL_Delay() is overridden to sleep the same way. */
+
+typedef void (*TmrFn)(void *arg);
+
+/* Caller-owned; keep it alive while it is started */
+typedef struct Tmr {
+    struct Tmr *next;
+    uint32_t    due;       /* tick of the next expiry */
+    uint32_t    period;    /* 0 = one-shot */
+    TmrFn       fn;
+    void       *arg;
+    bool        active;
+} Tmr_t;
+
+/* Start (or restart) t: first expiry after delay_ms, then every period_ms
+   (0 = one-shot). Callbacks run from TMR_Poll(), in main-loop context. */
+void TMR_Start(Tmr_t *t, uint32_t delay_ms, uint32_t period_ms, TmrFn fn, void *arg);
+void TMR_Stop(Tmr_t *t);
+
+/* Run the callbacks that are due. Returns true if any ran. */
+bool TMR_Poll(void);
+
+/* Milliseconds until the earliest active timer, capped at limit */
+uint32_t TMR_NextDue(uint32_t limit);
+
+/* Make the current or next TMR_Sleep() return at once; ISR-safe. For code
+   that hands work to the main loop. TMR_WakePending() reads and clears. */
+void TMR_Wake(void);
+bool TMR_WakePending(void);
+
+/* Sleep until the next timer is due, an interrupt arrives, TMR_Wake() is
+   called, or max_ms have passed, whichever is first. Never sleeps past a
+   held BLE notification. */
+void TMR_Sleep(uint32_t max_ms);
+
+/* Microseconds since boot from uwTick and the SysTick count, ISR-safe;
+   wraps every 71 minutes, so only differences mean anything. A clock
+   profile switch restarts the tick in progress, so a span across one can
+   read up to a tick short. */
+uint32_t TMR_Micros(void);
+
+/* Time asleep since boot, and the awake share in 1/1000.
+   TMR_Sleep(), TMR_Micros() and these live in tmr_tickless.c; the rest is portable. */
+uint32_t TMR_SleepMs(void);
+uint16_t TMR_DutyPermille(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* TMR_H */
@@ -0,0 +1,95 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ITM trace on SWO (PB3, SYS_JTDO-TRACESWO). The firmware programs the TPIU
+   itself (NRZ at TRACE_SWO_HZ, formatter off) and re-derives the divider on
+   every clock profile switch, so the capture side must not reconfigure it:
+   a debugger in "external/ no-init" SWO mode or a plain USB-UART on PB3 at
+   TRACE_SWO_HZ. ITM local timestamps (core clock / 64) follow the packets;
+   a TRACE_EV_CLK event gives the decoder the clock to convert them with.
+   tools/swo_decode.c turns a captured byte stream back into text. */
+
+#ifndef TRACE_ENABLE
+#ifdef DEBUG
+#define TRACE_ENABLE  1
+#else
+#define TRACE_ENABLE  0
+#endif
+#endif
+
+/* 131072 Bd divides every MSI range from 524 kHz up, and is 0.06 % off
+   at 32 MHz */
+#ifndef TRACE_SWO_HZ
+#define TRACE_SWO_HZ  131072u
+#endif
+
+/* Polls of a busy stimulus port before the rest of a write is dropped */
+#ifndef TRACE_SPIN
+#define TRACE_SPIN    64u
+#endif
+
+/* Stimulus ports */
+#define TRACE_PORT_TEXT   0u   /* log text; the DBG_SINK_SWO sink */
+#define TRACE_PORT_EVENT  1u   /* one 32-bit word per event: id << 24 | value */
+#define TRACE_PORT_PROF   2u   /* profiler samples: scope << 24 | 0.1 us */
+#define TRACE_PORT_I2C    3u   /* every PN532 I2C transfer in full (i2c_trace.h) */
+
+/* TRACE_PORT_I2C roughly doubles the SWO traffic while a card is polled,
+   so TRACE_Init() only enables it when built with TRACE_I2C 1 (or a
+   debugger sets its ITM->TER bit) */
+#ifndef TRACE_I2C
+#define TRACE_I2C         0
+#endif
+
+/* Event ids on TRACE_PORT_EVENT (value is 24 bits) */
+#define TRACE_EV_CLK      1u   /* core clock now, kHz */
+#define TRACE_EV_POLL     2u   /* card poll done, UID length (0 = none) */
+#define TRACE_EV_UID      3u   /* UID event queued; value = first 3 UID bytes */
+#define TRACE_EV_TXFULL   4u   /* UID event did not fit the BLE ring; queue depth */
+#define TRACE_EV_CMD      5u   /* command line executed, its length */
+#define TRACE_EV_MEMLOW   6u   /* RAM headroom fell to a new low below MEM_WARN_BYTES, bytes */
+
+/* True if the port is enabled (ITM on and port bit set in ITM->TER) */
+bool TRACE_On(uint8_t port);
+
+/* Never blocks longer than TRACE_SPIN polls per word; what does not go out
+   is dropped and counted. Returns bytes sent. Safe from any context.
+   Also works with TRACE_ENABLE 0 when a debugger has set up the ITM. */
+uint16_t TRACE_Write(uint8_t port, const void *data, uint16_t len);
+
+/* One 32-bit word, all or nothing */
+bool TRACE_Word(uint8_t port, uint32_t w);
+
+uint32_t TRACE_Dropped(void);
+
+#if TRACE_ENABLE
+
+/* Program ITM/TPIU and the SWO pin */
+void TRACE_Init(void);
+
+/* Clock changed: new SWO divider, then a TRACE_EV_CLK event */
+void TRACE_Retime(void);
+
+#define TRACE_Event(id, value) \
+    (void)TRACE_Word(TRACE_PORT_EVENT, ((uint32_t)(id) << 24) | ((uint32_t)(value) & 0x00FFFFFFu))
+
+#else
+
+static inline void TRACE_Init(void) { }
+static inline void TRACE_Retime(void) { }
+#define TRACE_Event(id, value)  ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* TRACE_H */
@@ -0,0 +1,340 @@
+#include "ble_cmd.h"
+#include "ble_link.h"
+#include "dbg_out.h"
+#include "clock.h"
+#include "tmr.h"
+#include "msi_cal.h"
+#include "spsc.h"
+#include "prof.h"
+#include "trace.h"
+#include "metrics.h"
+#include "sched.h"
+#include "memmon.h"
+#include "latency.h"
+#include "energy.h"
+#include <string.h>
+
+#define RX_DMA_SIZE   32u    /* circular DMA window; IDLE, HT and TC each drain it */
+
+ReaderConfig_t reader_cfg = {
+    .quiet_ms = 800,
+    .idle_ms  = 300,
+    .brty     = 0x00,
+    .fmt      = BLE_FMT_ASCII,
+    .mtu      = BLE_NOTIFY_SIZE,
+    .hold_ms  = BLE_HOLD_MS,
+    .dbg      = DBG_SINK_DEFAULT,
+    .diag     = 0,
+    .prof     = 0,
+    .i2c      = 0,
+};
+
+/* Settable keys and their limits */
+static const struct {
+    const char *name;
+    uint32_t   *val;
+    uint32_t    min, max;
+} k_keys[] = {
+    { "quiet", &reader_cfg.quiet_ms, 0,  60000 },
+    { "idle",  &reader_cfg.idle_ms,  10, 60000 },
+    { "proto", &reader_cfg.brty,     0,  0     },
+    { "fmt",   &reader_cfg.fmt,      0,  1     },
+    { "mtu",   &reader_cfg.mtu,      1,  BLE_TX_HIWAT },
+    { "hold",  &reader_cfg.hold_ms,  0,  1000  },
+    { "dbg",   &reader_cfg.dbg,      0,  DBG_SINK_SWO },
+    { "diag",  &reader_cfg.diag,     0,  1     },
+    { "prof",  &reader_cfg.prof,     0,  2     },
+    { "i2c",   &reader_cfg.i2c,      0,  1     },
+};
+#define N_KEYS  (sizeof(k_keys) / sizeof(k_keys[0]))
+
+/* ---- ISR side: assemble lines out of the DMA window ---- */
+
+static uint8_t  rx_dma[RX_DMA_SIZE];
+static uint16_t rx_tail;                      /* next unread DMA index */
+static char     rx_line[BLE_CMD_MAX + 1];
+static uint8_t  rx_len;
+static bool     rx_overlong;
+
+/* Finished lines on their way to the main loop, each NUL terminated.
+   The ISR pushes whole lines only, the main loop pops. */
+#if BLE_CMD_QUEUE < BLE_CMD_MAX + 1u
+#error "BLE_CMD_QUEUE must hold one full line"
+#endif
+
+SPSC_DEFINE(cmdq, char, BLE_CMD_QUEUE)
+
+static cmdq_t cmd_q;
+
+static void rx_feed(uint8_t b)
+{
+    if (b == '\r') return;
+    if (b != '\n') {
+        if (rx_len < BLE_CMD_MAX) rx_line[rx_len++] = (char)b;
+        else                      rx_overlong = true;
+        return;
+    }
+    if (rx_len && !rx_overlong) {
+        rx_line[rx_len] = 0;
+        if (cmdq_push_all(&cmd_q, rx_line, (uint16_t)(rx_len + 1u)))
+            BLE_CMD_ReadyCallback();
+        else
+            MET_Inc(MET_CMD_DROPPED);
+    }
+    rx_len = 0;
+    rx_overlong = false;
+}
+
+static void rx_restart(void)
+{
+    rx_tail = 0;
+    (void)HAL_UARTEx_ReceiveToIdle_DMA(&huart2, rx_dma, sizeof(rx_dma));
+}
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+    if (huart != &huart2) return;
+    uint16_t head = (uint16_t)(Size % RX_DMA_SIZE);   /* Size == RX_DMA_SIZE on wrap */
+    while (rx_tail != head) {
+        rx_feed(rx_dma[rx_tail]);
+        rx_tail = (uint16_t)((rx_tail + 1u) % RX_DMA_SIZE);
+    }
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    /* Noise/framing/overrun aborts the reception; pick it up again */
+    if (huart == &huart2) rx_restart();
+}
+
+/* ---- main-loop side ---- */
+
+static void reply(const char *s)
+{
+    (void)BLE_Write(s, (uint16_t)strlen(s));
+}
+
+static char *put_u32(char *p, uint32_t v)
+{
+    char tmp[10];
+    uint8_t n = 0;
+    do { tmp[n++] = (char)('0' + v % 10u); v /= 10u; } while (v);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+static char *put_i32(char *p, int32_t v)
+{
+    if (v < 0) { *p++ = '-'; return put_u32(p, 0u - (uint32_t)v); }
+    return put_u32(p, (uint32_t)v);
+}
+
+static bool parse_u32(const char *s, uint32_t *out)
+{
+    uint32_t v = 0;
+    if (!*s) return false;
+    for (; *s; ++s) {
+        if (*s < '0' || *s > '9' || v > 429496728u) return false;
+        v = v * 10u + (uint32_t)(*s - '0');
+    }
+    *out = v;
+    return true;
+}
+
+static void cmd_get(void)
+{
+    char out[96];
+    char *p = out;
+    for (uint32_t i = 0; i < N_KEYS; ++i) {
+        uint32_t n = (uint32_t)strlen(k_keys[i].name);
+        if (i) *p++ = ' ';
+        memcpy(p, k_keys[i].name, n); p += n;
+        *p++ = '=';
+        p = put_u32(p, *k_keys[i].val);
+    }
+    *p++ = '\r'; *p++ = '\n'; *p = 0;
+    reply(out);
+}
+
+static void cmd_clk(void)
+{
+    char out[112];
+    char *p = out;
+    int32_t found, left;
+    memcpy(p, "burst=", 6); p = put_u32(p + 6, CLK_TimeIn(CLK_BURST));
+    memcpy(p, " idle=", 6); p = put_u32(p + 6, CLK_TimeIn(CLK_IDLE));
+    memcpy(p, " sw=", 4);   p = put_u32(p + 4, CLK_Switches());
+    memcpy(p, " sleep=", 7); p = put_u32(p + 7, TMR_SleepMs());
+    memcpy(p, " duty=", 6); p = put_u32(p + 6, TMR_DutyPermille());
+    if (MSICAL_Error(&found, &left)) {
+        memcpy(p, " msierr=", 8); p = put_i32(p + 8, found);
+        *p++ = '/';               p = put_i32(p, left);
+    }
+    *p++ = '\r'; *p++ = '\n'; *p = 0;
+    reply(out);
+}
+
+/* Binary metrics snapshot; needs room for the whole frame */
+#if MET_FRAME_SIZE > BLE_TX_SIZE
+#error "metrics snapshot no longer fits the BLE TX ring"
+#endif
+
+static void cmd_met(void)
+{
+    uint8_t frame[MET_FRAME_SIZE];
+
+    MET_Set(MET_DBG_DROPPED, DBG_Dropped());
+    MET_Set(MET_SCHED_DROPPED, SCHED_Dropped());
+    MET_Set(MET_STACK_PEAK, MEM_StackPeak());
+    MET_Set(MET_RAM_HEADROOM, MEM_Headroom());
+    MET_Set(MET_HEAP_PEAK, SYSMEM_HeapPeak());
+    MET_Set(MET_CHARGE_NAH, NRG_ChargeNAh());
+    if (!BLE_Write(frame, MET_Snapshot(frame)))
+        reply("BUSY\r\n");
+}
+
+/* Tap latency: mean of every stage, or one stage's histogram */
+static void cmd_lat(const char *arg)
+{
+    char out[128];
+    char *p = out;
+    LatStats_t st;
+
+    if (strcmp(arg, "RESET") == 0) {
+        LAT_Reset();
+        reply("OK\r\n");
+        return;
+    }
+    if (!*arg) {
+        LAT_Stats(LAT_TOTAL, &st);
+        memcpy(p, "n=", 2);      p = put_u32(p + 2, st.n);
+        memcpy(p, " lost=", 6);  p = put_u32(p + 6, LAT_Lost());
+        for (uint32_t s = 0; s < LAT_N; ++s) {
+            const char *name = LAT_Name((LatStage_t)s);
+            uint32_t n = (uint32_t)strlen(name);
+            LAT_Stats((LatStage_t)s, &st);
+            *p++ = ' ';
+            memcpy(p, name, n); p += n;
+            *p++ = '=';
+            p = put_u32(p, st.n ? (uint32_t)(st.sum / st.n) : 0u);
+        }
+    } else {
+        uint32_t s = 0;
+        const uint16_t *h;
+        while (s < LAT_N && strcmp(arg, LAT_Name((LatStage_t)s)) != 0) s++;
+        if (s == LAT_N) { reply("ERR\r\n"); return; }
+        LAT_Stats((LatStage_t)s, &st);
+        h = LAT_Hist((LatStage_t)s);
+        memcpy(p, "n=", 2);      p = put_u32(p + 2, st.n);
+        memcpy(p, " avg=", 5);   p = put_u32(p + 5, st.n ? (uint32_t)(st.sum / st.n) : 0u);
+        memcpy(p, " max=", 5);   p = put_u32(p + 5, st.max);
+        memcpy(p, " h=", 3);     p += 3;
+        for (uint32_t k = 0; k < LAT_BUCKETS; ++k) {
+            if (k) *p++ = ',';
+            p = put_u32(p, h[k]);
+        }
+    }
+    *p++ = '\r'; *p++ = '\n'; *p = 0;
+    reply(out);
+}
+
+/* Energy: residency per state and the charge estimate, or the current table.
+   Base residency is the uptime, so the residency line leaves it out. */
+static void cmd_nrg(char *arg)
+{
+    char out[120];
+    char *p = out;
+    char *val = strchr(arg, ' ');
+    uint32_t s, v;
+
+    if (strcmp(arg, "RESET") == 0) {
+        NRG_Reset();
+        reply("OK\r\n");
+        return;
+    }
+    if (val) {                                   /* NRG <state> <uA> */
+        *val++ = 0;
+        for (s = 0; s < NRG_N && strcmp(arg, NRG_Name((NrgState_t)s)) != 0; ++s) { }
+        reply(s < NRG_N && parse_u32(val, &v) && NRG_SetUA((NrgState_t)s, v) ? "OK\r\n" : "ERR\r\n");
+        return;
+    }
+    if (*arg && strcmp(arg, "UA") != 0) {
+        reply("ERR\r\n");
+        return;
+    }
+    for (s = 0; s < (*arg ? NRG_N : NRG_BASE); ++s) {
+        const char *name = NRG_Name((NrgState_t)s);
+        uint32_t n = (uint32_t)strlen(name);
+        if (s) *p++ = ' ';
+        memcpy(p, name, n); p += n;
+        *p++ = '=';
+        p = put_u32(p, *arg ? NRG_GetUA((NrgState_t)s) : NRG_ResidencyMs((NrgState_t)s));
+    }
+    if (!*arg) { memcpy(p, " nAh=", 5); p = put_u32(p + 5, NRG_ChargeNAh()); }
+    *p++ = '\r'; *p++ = '\n'; *p = 0;
+    reply(out);
+}
+
+static bool cmd_set(char *args)
+{
+    char *val = strchr(args, ' ');
+    uint32_t v;
+    if (!val) return false;
+    *val++ = 0;
+    if (!parse_u32(val, &v)) return false;
+    for (uint32_t i = 0; i < N_KEYS; ++i) {
+        if (strcmp(args, k_keys[i].name) != 0) continue;
+        if (v < k_keys[i].min || v > k_keys[i].max) return false;
+        *k_keys[i].val = v;
+        return true;
+    }
+    return false;
+}
+
+/* ---------------- Public API ---------------- */
+
+__weak void BLE_CMD_ReadyCallback(void)
+{
+}
+
+void BLE_CMD_Start(void)
+{
+    rx_len = 0;
+    rx_overlong = false;
+    rx_restart();
+}
+
+bool BLE_CMD_Poll(void)
+{
+    char     cmd_buf[BLE_CMD_MAX + 1];
+    uint16_t n = 0;
+
+    /* The ISR only queues complete lines, so a started one ends in a NUL */
+    if (!cmdq_pop(&cmd_q, &cmd_buf[0])) return false;
+    PROF_START(pt);
+    while (cmd_buf[n] && n < BLE_CMD_MAX && cmdq_pop(&cmd_q, &cmd_buf[n + 1u])) n++;
+    cmd_buf[BLE_CMD_MAX] = 0;
+    TRACE_Event(TRACE_EV_CMD, n);
+    MET_Inc(MET_CMDS);
+
+    if (strcmp(cmd_buf, "GET") == 0)
+        cmd_get();
+    else if (strcmp(cmd_buf, "CLK") == 0)
+        cmd_clk();
+    else if (strcmp(cmd_buf, "MET") == 0)
+        cmd_met();
+    else if (strcmp(cmd_buf, "LAT") == 0)
+        cmd_lat("");
+    else if (strncmp(cmd_buf, "LAT ", 4) == 0)
+        cmd_lat(&cmd_buf[4]);
+    else if (strcmp(cmd_buf, "NRG") == 0)
+        cmd_nrg(&cmd_buf[3]);
+    else if (strncmp(cmd_buf, "NRG ", 4) == 0)
+        cmd_nrg(&cmd_buf[4]);
+    else if (strncmp(cmd_buf, "SET ", 4) == 0)
+        reply(cmd_set(&cmd_buf[4]) ? "OK\r\n" : "ERR\r\n");
+    else
+        reply("ERR\r\n");
+    PROF_STOP(PROF_CMD, pt);
+    return true;
+}
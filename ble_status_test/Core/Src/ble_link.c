@@ -0,0 +1,368 @@
+#include "ble_link.h"
+#include "spsc.h"
+#include <string.h>
+
+/* ---- BLE module AT dialect (HM-10 / CC41 style) ----
+   Commands are not line terminated; the module answers "OK" to "AT" and
+   "OK+Set:<n>" to "AT+BAUD<n>". The new rate applies after "AT+RESET". */
+#define BLE_AT_PROBE        "AT"
+#define BLE_AT_PROBE_OK     "OK"
+#define BLE_AT_BAUD         "AT+BAUD"
+#define BLE_AT_BAUD_OK      "OK+Set:"
+#define BLE_AT_RESET        "AT+RESET"
+#define BLE_AT_RESET_OK     "OK+RESET"
+
+#define BLE_AT_TIMEOUT      200   /* ms, reply window per command */
+#define BLE_AT_GAP          30    /* ms, idle time that ends a command */
+#define BLE_RESET_SETTLE    600   /* ms, module reboot after AT+RESET */
+#define BLE_RECOVER_TRIES   5     /* blind "go back" attempts on a bad rate */
+
+/* Rates the module understands, fastest first */
+static const struct { uint32_t baud; char code; } k_rates[] = {
+    { 115200, '4' },
+    {  57600, '3' },
+    {  38400, '2' },
+    {  19200, '1' },
+    {   9600, '0' },
+};
+#define N_RATES  (sizeof(k_rates) / sizeof(k_rates[0]))
+
+static char rate_code(uint32_t baud)
+{
+    for (uint32_t i = 0; i < N_RATES; ++i)
+        if (k_rates[i].baud == baud) return k_rates[i].code;
+    return 0;
+}
+
+/* ---- persisted rate (data EEPROM) ---- */
+
+static uint32_t baud_load(void)
+{
+    uint32_t b = *(__IO uint32_t *)(BLE_BAUD_EEPROM_ADDR);
+    uint32_t c = *(__IO uint32_t *)(BLE_BAUD_EEPROM_ADDR + 4u);
+    return (b == ~c && rate_code(b)) ? b : 0;
+}
+
+static void baud_store(uint32_t baud)
+{
+    if (baud_load() == baud) return;   /* spare the EEPROM */
+    if (HAL_FLASHEx_DATAEEPROM_Unlock() != HAL_OK) return;
+    (void)HAL_FLASHEx_DATAEEPROM_Program(FLASH_TYPEPROGRAMDATA_WORD, BLE_BAUD_EEPROM_ADDR, baud);
+    (void)HAL_FLASHEx_DATAEEPROM_Program(FLASH_TYPEPROGRAMDATA_WORD, BLE_BAUD_EEPROM_ADDR + 4u, ~baud);
+    (void)HAL_FLASHEx_DATAEEPROM_Lock();
+}
+
+/* ---- AT transport ---- */
+
+static void rx_drain(void)
+{
+    uint8_t b;
+    while (HAL_UART_Receive(&huart2, &b, 1, 0) == HAL_OK) { }
+}
+
+/* Send cmd and wait until 'expect' shows up in the reply stream. */
+static bool at_cmd(const char *cmd, const char *expect, uint32_t timeout_ms)
+{
+    const uint32_t want = (uint32_t)strlen(expect);
+    uint32_t match = 0;
+
+    rx_drain();
+    if (HAL_UART_Transmit(&huart2, (uint8_t*)cmd, (uint16_t)strlen(cmd), BLE_AT_TIMEOUT) != HAL_OK)
+        return false;
+
+    uint32_t t0 = HAL_GetTick();
+    while (match < want && (HAL_GetTick() - t0) < timeout_ms) {
+        uint8_t b;
+        if (HAL_UART_Receive(&huart2, &b, 1, 1) != HAL_OK) continue;
+        if (b == (uint8_t)expect[match])      match++;
+        else if (b == (uint8_t)expect[0])     match = 1;
+        else                                  match = 0;
+    }
+    return match == want;
+}
+
+/* Loopback check: the module must echo OK for every probe. */
+static bool echo_check(uint32_t rounds)
+{
+    for (uint32_t i = 0; i < rounds; ++i)
+        if (!at_cmd(BLE_AT_PROBE, BLE_AT_PROBE_OK, BLE_AT_TIMEOUT)) return false;
+    return true;
+}
+
+/* Tell the module to move to 'baud' (it is listening at the current local rate). */
+static bool module_set_baud(uint32_t baud)
+{
+    char cmd[sizeof(BLE_AT_BAUD) + 1];
+    char ok[sizeof(BLE_AT_BAUD_OK) + 1];
+
+    memcpy(cmd, BLE_AT_BAUD, sizeof(BLE_AT_BAUD) - 1);
+    cmd[sizeof(BLE_AT_BAUD) - 1] = rate_code(baud);
+    cmd[sizeof(BLE_AT_BAUD)]     = 0;
+    memcpy(ok, BLE_AT_BAUD_OK, sizeof(BLE_AT_BAUD_OK) - 1);
+    ok[sizeof(BLE_AT_BAUD_OK) - 1] = rate_code(baud);
+    ok[sizeof(BLE_AT_BAUD_OK)]     = 0;
+
+    if (!at_cmd(cmd, ok, BLE_AT_TIMEOUT)) return false;
+    (void)at_cmd(BLE_AT_RESET, BLE_AT_RESET_OK, BLE_AT_TIMEOUT);
+    HAL_Delay(BLE_RESET_SETTLE);
+    return true;
+}
+
+/* Scan every known rate until the module answers. */
+static bool find_module(void)
+{
+    if (BLE_SetLocalBaud(BLE_BAUD_DEFAULT) && echo_check(1)) return true;
+    for (uint32_t i = 0; i < N_RATES; ++i) {
+        if (k_rates[i].baud == BLE_BAUD_DEFAULT) continue;
+        if (BLE_SetLocalBaud(k_rates[i].baud) && echo_check(1)) return true;
+    }
+    return false;
+}
+
+typedef enum { RATE_OK, RATE_REJECTED, RATE_LOST } rate_result_t;
+
+/* Step from the current rate to 'baud'; on a failed echo check go back. */
+static rate_result_t try_rate(uint32_t baud)
+{
+    const uint32_t cur = BLE_GetBaud();
+
+    if (!module_set_baud(baud)) return RATE_REJECTED;
+    if (BLE_SetLocalBaud(baud) && echo_check(BLE_ECHO_ROUNDS)) return RATE_OK;
+
+    /* The module moved but the link is marginal: ask it back */
+    for (uint32_t i = 0; i < BLE_RECOVER_TRIES; ++i) {
+        (void)BLE_SetLocalBaud(baud);
+        if (module_set_baud(cur) && BLE_SetLocalBaud(cur) && echo_check(1))
+            return RATE_REJECTED;
+    }
+    return find_module() ? RATE_REJECTED : RATE_LOST;
+}
+
+/* ---- TX ring ----
+   The main loop pushes, the DMA completion callback drops what was sent.
+   Starting a transfer happens from both sides (writes, SysTick, DMA done),
+   so tx_kick() runs masked, and so does write() for its mark; the ring
+   itself needs no lock. */
+
+#if BLE_NOTIFY_SIZE > BLE_TX_HIWAT
+#error "BLE_NOTIFY_SIZE must fit under BLE_TX_HIWAT"
+#endif
+
+SPSC_DEFINE(txq, uint8_t, BLE_TX_SIZE)
+
+static txq_t             tx_q;
+static volatile uint16_t tx_inflight;    /* bytes owned by the DMA, 0 = idle */
+static volatile uint32_t tx_stamp;       /* tick when the oldest unsent byte was queued */
+static volatile uint32_t tx_last;        /* tick of the latest write */
+static volatile bool     tx_force;       /* BLE_Flush: ignore the hold timer */
+static volatile bool     tx_paused;      /* BLE_TxPause: start nothing new */
+static uint16_t          tx_chunk   = BLE_NOTIFY_SIZE;
+static uint16_t          tx_hold_ms = BLE_HOLD_MS;
+
+/* BLE_WriteMarked: ring positions of the marked write, free-running like
+   the ring indices */
+static volatile bool     mark_armed;
+static volatile bool     mark_started;
+static volatile uint16_t mark_first;
+static volatile uint16_t mark_end;
+
+static bool              tx_active;      /* last state given to BLE_TxActiveCallback */
+
+static void tx_set_active(bool on)
+{
+    if (on == tx_active) return;
+    tx_active = on;
+    BLE_TxActiveCallback(on);
+}
+
+/* Hand the next notification-sized run to the DMA, or keep holding a
+   partial one until its time is up. Caller excludes the other contexts. */
+static void tx_kick(void)
+{
+    uint8_t *p;
+    uint16_t n;
+
+    if (tx_inflight || tx_paused) return;
+    if (txq_count(&tx_q) < tx_chunk && !tx_force &&
+        (HAL_GetTick() - tx_stamp) < tx_hold_ms) return;
+    n = txq_span(&tx_q, &p);
+    if (n == 0) return;
+    if (n > tx_chunk) n = tx_chunk;
+    tx_inflight = n;
+    if (HAL_UART_Transmit_DMA(&huart2, p, n) != HAL_OK) {
+        tx_inflight = 0;
+        return;
+    }
+    tx_set_active(true);
+    if (mark_armed && !mark_started && (uint16_t)(mark_first - tx_q.tail) < n) {
+        mark_started = true;
+        BLE_TxMarkStartCallback();
+    }
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart != &huart2) return;
+    txq_drop(&tx_q, tx_inflight);
+    tx_inflight = 0;
+    if (mark_armed && mark_started && (int16_t)(tx_q.tail - mark_end) >= 0) {
+        mark_armed = false;
+        BLE_TxMarkSentCallback();
+    }
+    if (txq_count(&tx_q) == 0) tx_force = false;
+    else                       tx_stamp = tx_last;  /* what is left came with the latest writes */
+    tx_kick();
+    if (!tx_inflight) tx_set_active(false);
+}
+
+/* ---------------- Public API ---------------- */
+
+uint32_t BLE_GetBaud(void)
+{
+    return huart2.Init.BaudRate;
+}
+
+bool BLE_SetLocalBaud(uint32_t baud)
+{
+    if (huart2.Init.BaudRate == baud) return true;
+    huart2.Init.BaudRate = baud;
+    return (HAL_UART_Init(&huart2) == HAL_OK);
+}
+
+uint32_t BLE_Begin(void)
+{
+    /* Don't let our first probe run into bytes sent just before a reset */
+    HAL_Delay(BLE_AT_GAP);
+
+    /* Fast path: the module is still where the last boot left it */
+    uint32_t saved = baud_load();
+    if (saved && BLE_SetLocalBaud(saved) && echo_check(1))
+        return saved;
+
+    if (!find_module()) {
+        /* Silent (or already connected and in data mode): stay on default */
+        (void)BLE_SetLocalBaud(BLE_BAUD_DEFAULT);
+        return BLE_BAUD_DEFAULT;
+    }
+
+    for (uint32_t i = 0; i < N_RATES; ++i) {
+        uint32_t b = k_rates[i].baud;
+        if (b > BLE_BAUD_MAX) continue;
+        if (b <= BLE_GetBaud()) break;
+
+        rate_result_t r = try_rate(b);
+        if (r == RATE_OK) break;
+        if (r == RATE_LOST) {
+            (void)BLE_SetLocalBaud(BLE_BAUD_DEFAULT);
+            return BLE_BAUD_DEFAULT;
+        }
+    }
+
+    baud_store(BLE_GetBaud());
+    return BLE_GetBaud();
+}
+
+uint16_t BLE_TxFree(void)
+{
+    return txq_space(&tx_q);
+}
+
+bool BLE_Backpressure(void)
+{
+    return txq_count(&tx_q) > BLE_TX_HIWAT;
+}
+
+/* Masked throughout: a DMA completion between the push and the mark would
+   start a transfer with the marked bytes in it before the mark is armed,
+   and one before the push would leave 'idle' stale */
+static bool write(const void *data, uint16_t len, bool mark)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    bool     idle = (txq_count(&tx_q) == tx_inflight);  /* nothing was waiting */
+    uint16_t head = tx_q.head;
+
+    if (!txq_push_all(&tx_q, (const uint8_t *)data, len)) {
+        __set_PRIMASK(primask);
+        return false;
+    }
+    tx_last = HAL_GetTick();
+    if (idle) tx_stamp = tx_last;
+    if (mark && len) {
+        mark_first   = head;
+        mark_end     = (uint16_t)(head + len);
+        mark_started = false;
+        mark_armed   = true;
+    }
+    tx_kick();
+    __set_PRIMASK(primask);
+    return true;
+}
+
+bool BLE_Write(const void *data, uint16_t len)
+{
+    return write(data, len, false);
+}
+
+bool BLE_WriteMarked(const void *data, uint16_t len)
+{
+    return write(data, len, true);
+}
+
+__weak void BLE_TxMarkStartCallback(void)
+{
+}
+
+__weak void BLE_TxMarkSentCallback(void)
+{
+}
+
+__weak void BLE_TxActiveCallback(bool active)
+{
+    (void)active;
+}
+
+void BLE_Tick(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    tx_kick();
+    __set_PRIMASK(primask);
+}
+
+bool BLE_SetCoalesce(uint16_t chunk, uint16_t hold_ms)
+{
+    bool ok = (chunk != 0 && chunk <= BLE_TX_HIWAT);
+    if (ok) tx_chunk = chunk;
+    tx_hold_ms = hold_ms;
+    BLE_Tick();
+    return ok;
+}
+
+bool BLE_TxPause(uint32_t timeout_ms)
+{
+    uint32_t t0 = HAL_GetTick();
+    tx_paused = true;
+    while (tx_inflight) {
+        if ((HAL_GetTick() - t0) >= timeout_ms) return false;
+    }
+    return true;
+}
+
+void BLE_TxResume(void)
+{
+    tx_paused = false;
+    BLE_Tick();
+}
+
+bool BLE_Flush(uint32_t timeout_ms)
+{
+    uint32_t t0 = HAL_GetTick();
+    tx_force = true;
+    BLE_Tick();
+    while (txq_count(&tx_q)) {
+        if ((HAL_GetTick() - t0) >= timeout_ms) return false;
+    }
+    return true;
+}
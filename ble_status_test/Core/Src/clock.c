@@ -0,0 +1,158 @@
+#include "clock.h"
+#include "ble_link.h"
+#include "trace.h"
+#include "energy.h"
+
+static const uint32_t k_msi_range[] = {
+    RCC_MSIRANGE_0, RCC_MSIRANGE_1, RCC_MSIRANGE_2,
+    RCC_MSIRANGE_3, RCC_MSIRANGE_4, RCC_MSIRANGE_5,
+};
+#define MSI_HZ(r)  (65536u << (r))          /* range 0 = 65.536 kHz, doubling */
+#define MSI_TOP    5u                       /* highest range with 0 WS at voltage range 3 */
+
+static ClkProfile_t clk_cur = CLK_N;        /* CubeMX boot clock, not a profile */
+static uint32_t     clk_since;
+static uint32_t     clk_ms[CLK_N];
+static uint32_t     clk_switches;
+
+static uint8_t idle_range(void)
+{
+    uint8_t r = CLK_IDLE_MSI_MIN;
+    while (r < MSI_TOP && MSI_HZ(r) < 16u * huart2.Init.BaudRate) r++;
+    return r;
+}
+
+static void voltage_scale(uint32_t vos)
+{
+    __HAL_PWR_VOLTAGESCALING_CONFIG(vos);
+    while (__HAL_PWR_GET_FLAG(PWR_FLAG_VOS) != RESET) { }
+}
+
+static bool enter_burst(void)
+{
+    RCC_OscInitTypeDef osc = {0};
+    RCC_ClkInitTypeDef clk = {0};
+
+    voltage_scale(PWR_REGULATOR_VOLTAGE_SCALE1);      /* before the frequency goes up */
+
+    osc.OscillatorType      = RCC_OSCILLATORTYPE_HSI;
+    osc.HSIState            = RCC_HSI_ON;
+    osc.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
+    osc.PLL.PLLState        = RCC_PLL_ON;
+    osc.PLL.PLLSource       = RCC_PLLSOURCE_HSI;
+    osc.PLL.PLLMUL          = RCC_PLL_MUL6;           /* 96 MHz VCO */
+    osc.PLL.PLLDIV          = RCC_PLL_DIV3;           /* 32 MHz */
+    if (HAL_RCC_OscConfig(&osc) != HAL_OK) return false;
+
+    clk.ClockType      = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK|
+                         RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
+    clk.SYSCLKSource   = RCC_SYSCLKSOURCE_PLLCLK;
+    clk.AHBCLKDivider  = RCC_SYSCLK_DIV1;
+    clk.APB1CLKDivider = RCC_HCLK_DIV1;
+    clk.APB2CLKDivider = RCC_HCLK_DIV1;
+    if (HAL_RCC_ClockConfig(&clk, FLASH_LATENCY_1) != HAL_OK) return false;   /* sets ACC64 */
+    __HAL_FLASH_PREFETCH_BUFFER_ENABLE();
+
+    osc.OscillatorType = RCC_OSCILLATORTYPE_MSI;      /* nothing runs on it now */
+    osc.MSIState       = RCC_MSI_OFF;
+    osc.PLL.PLLState   = RCC_PLL_NONE;
+    (void)HAL_RCC_OscConfig(&osc);
+    return true;
+}
+
+static bool enter_idle(void)
+{
+    RCC_OscInitTypeDef osc = {0};
+    RCC_ClkInitTypeDef clk = {0};
+
+    osc.OscillatorType      = RCC_OSCILLATORTYPE_MSI;
+    osc.MSIState            = RCC_MSI_ON;
+    osc.MSICalibrationValue = (RCC->ICSCR & RCC_ICSCR_MSITRIM) >> RCC_ICSCR_MSITRIM_Pos;  /* keep the trim */
+    osc.MSIClockRange       = k_msi_range[idle_range()];
+    osc.PLL.PLLState        = RCC_PLL_NONE;
+    if (HAL_RCC_OscConfig(&osc) != HAL_OK) return false;
+
+    clk.ClockType      = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK|
+                         RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
+    clk.SYSCLKSource   = RCC_SYSCLKSOURCE_MSI;
+    clk.AHBCLKDivider  = RCC_SYSCLK_DIV1;
+    clk.APB1CLKDivider = RCC_HCLK_DIV1;
+    clk.APB2CLKDivider = RCC_HCLK_DIV1;
+    if (HAL_RCC_ClockConfig(&clk, FLASH_LATENCY_0) != HAL_OK) return false;
+    __HAL_FLASH_PREFETCH_BUFFER_DISABLE();
+    __HAL_FLASH_ACC64_DISABLE();                       /* only with 0 WS and no prefetch */
+
+    osc.OscillatorType = RCC_OSCILLATORTYPE_HSI;       /* the PLL and its input */
+    osc.HSIState       = RCC_HSI_OFF;
+    osc.PLL.PLLState   = RCC_PLL_OFF;
+    (void)HAL_RCC_OscConfig(&osc);
+
+    voltage_scale(PWR_REGULATOR_VOLTAGE_SCALE3);       /* after the frequency came down */
+    return true;
+}
+
+/* PCLK1 changed: recompute the USART2 divider, the I2C timing and the SWO
+   divider from the clock we actually ended up on */
+static void retime(void)
+{
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+
+    huart2.Instance->BRR = UART_BRR_SAMPLING16(pclk1, huart2.Init.BaudRate);
+
+    if (pclk1 >= 4000000u)      hi2c1.Init.ClockSpeed = CLK_I2C_HZ;   /* fast mode needs 4 MHz */
+    else if (pclk1 >= 2000000u) hi2c1.Init.ClockSpeed = 100000u;
+    else                        hi2c1.Init.ClockSpeed = 0;
+    if (!hi2c1.Init.ClockSpeed || HAL_I2C_Init(&hi2c1) != HAL_OK)
+        __HAL_I2C_DISABLE(&hi2c1);
+    TRACE_Retime();
+}
+
+/* ---------------- Public API ---------------- */
+
+void CLK_Init(void)
+{
+    clk_since = HAL_GetTick();
+    (void)CLK_Set(CLK_BURST);
+    clk_switches = 0;
+}
+
+bool CLK_Set(ClkProfile_t p)
+{
+    bool ok;
+
+    if (p == clk_cur || p >= CLK_N) return true;
+
+    /* No byte may be on the wire while the baud divider is wrong */
+    if (!BLE_TxPause(CLK_TX_WAIT_MS)) {
+        BLE_TxResume();
+        return false;
+    }
+    ok = (p == CLK_BURST) ? enter_burst() : enter_idle();
+    if (ok) {
+        uint32_t now = HAL_GetTick();
+        if (clk_cur < CLK_N) clk_ms[clk_cur] += now - clk_since;
+        clk_since = now;
+        clk_cur = p;
+        clk_switches++;
+        NRG_Clock(p == CLK_BURST);
+    }
+    retime();
+    BLE_TxResume();
+    return ok;
+}
+
+ClkProfile_t CLK_Get(void)
+{
+    return clk_cur;
+}
+
+uint32_t CLK_TimeIn(ClkProfile_t p)
+{
+    if (p >= CLK_N) return 0;
+    return clk_ms[p] + ((p == clk_cur) ? HAL_GetTick() - clk_since : 0u);
+}
+
+uint32_t CLK_Switches(void)
+{
+    return clk_switches;
+}
@@ -0,0 +1,153 @@
+#include "dbg_out.h"
+#include "ble_link.h"
+#include "trace.h"
+#include <stdio.h>
+
+static uint8_t           dbg_sink = DBG_SINK_DEFAULT;
+static volatile uint32_t dbg_dropped;
+
+/* ---- sinks ---- */
+
+static uint16_t swo_write(const uint8_t *p, uint16_t len)
+{
+    return TRACE_Write(TRACE_PORT_TEXT, p, len);
+}
+
+static uint16_t ble_write(const uint8_t *p, uint16_t len)
+{
+    /* The ring has one producer, the main loop; and diagnostics must not
+       eat the headroom reserved for UID events. */
+    if (__get_IPSR() != 0u) return 0;
+    if (BLE_TxFree() < len + (BLE_TX_SIZE - BLE_TX_HIWAT)) return 0;
+    return BLE_Write(p, len) ? len : 0;
+}
+
+/* ---- formatter ---- */
+
+typedef struct {
+    char    *buf;
+    uint16_t size;
+    uint16_t len;
+} out_t;
+
+static void out_c(out_t *o, char c)
+{
+    if (o->len + 1u < o->size) o->buf[o->len] = c;
+    o->len++;
+}
+
+static void out_num(out_t *o, uint32_t v, uint8_t base, bool upper, bool neg, uint8_t width, char pad)
+{
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char tmp[10];
+    uint8_t n = 0;
+
+    do { tmp[n++] = digits[v % base]; v /= base; } while (v);
+    if (neg && pad == '0') { out_c(o, '-'); neg = false; if (width) width--; }
+    for (uint8_t w = (uint8_t)(n + (neg ? 1u : 0u)); w < width; ++w) out_c(o, pad);
+    if (neg) out_c(o, '-');
+    while (n) out_c(o, tmp[--n]);
+}
+
+int DBG_Format(char *buf, uint16_t size, const char *fmt, va_list ap)
+{
+    out_t o = { buf, size, 0 };
+
+    for (; *fmt; ++fmt) {
+        if (*fmt != '%') { out_c(&o, *fmt); continue; }
+
+        char    pad   = ' ';
+        uint8_t width = 0;
+        if (*++fmt == '0') { pad = '0'; ++fmt; }
+        while (*fmt >= '0' && *fmt <= '9') width = (uint8_t)(width * 10u + (uint8_t)(*fmt++ - '0'));
+        /* Read what the caller passed (long is 64 bits on the host builds);
+           the value is printed as 32 bits */
+        bool lng = (*fmt == 'l');
+        if (lng) ++fmt;
+
+        switch (*fmt) {
+        case 'c': out_c(&o, (char)va_arg(ap, int)); break;
+        case 's': {
+            const char *s = va_arg(ap, const char *);
+            for (s = s ? s : "(null)"; *s; ++s) out_c(&o, *s);
+            break;
+        }
+        case 'd': case 'i': {
+            int32_t v = lng ? (int32_t)va_arg(ap, long) : (int32_t)va_arg(ap, int);
+            out_num(&o, v < 0 ? 0u - (uint32_t)v : (uint32_t)v, 10, false, v < 0, width, pad);
+            break;
+        }
+        case 'u': case 'x': case 'X': {
+            uint32_t v = lng ? (uint32_t)va_arg(ap, unsigned long) : (uint32_t)va_arg(ap, unsigned);
+            out_num(&o, v, (*fmt == 'u') ? 10 : 16, *fmt == 'X', false, width, pad);
+            break;
+        }
+        case '%': out_c(&o, '%'); break;
+        case 0:   --fmt; break;                       /* lone '%' at the end */
+        default:  out_c(&o, '%'); out_c(&o, *fmt); break;
+        }
+    }
+    if (size) buf[o.len < size ? o.len : size - 1u] = 0;
+    return (int)(o.len < size ? o.len : (size ? size - 1u : 0u));
+}
+
+/* ---------------- Public API ---------------- */
+
+void DBG_Init(void)
+{
+#if DBG_STDIO
+    setvbuf(stdout, NULL, _IONBF, 0);
+    setvbuf(stderr, NULL, _IONBF, 0);
+#endif
+}
+
+void DBG_SetSink(uint8_t sink)
+{
+    if (sink <= DBG_SINK_SWO) dbg_sink = sink;
+}
+
+uint8_t DBG_GetSink(void)
+{
+    return dbg_sink;
+}
+
+uint16_t DBG_Write(const void *data, uint16_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint16_t done;
+
+    switch (dbg_sink) {
+    case DBG_SINK_BLE: done = ble_write(p, len); break;
+    case DBG_SINK_SWO: done = swo_write(p, len); break;
+    default:           done = 0; break;
+    }
+    dbg_dropped += (uint32_t)(len - done);
+    return done;
+}
+
+int DBG_Printf(const char *fmt, ...)
+{
+    char line[DBG_LINE_MAX];
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = DBG_Format(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    return (int)DBG_Write(line, (uint16_t)n);
+}
+
+uint32_t DBG_Dropped(void)
+{
+    return dbg_dropped;
+}
+
+/* Overrides the weak stub in syscalls.c. Reports everything as written:
+   a diagnostic that was dropped is not worth a retry from stdio. */
+int _write(int file, char *ptr, int len)
+{
+    if (file != 1 && file != 2) return -1;
+    for (int off = 0; off < len; off += DBG_LINE_MAX)
+        (void)DBG_Write(ptr + off, (uint16_t)((len - off) < (int)DBG_LINE_MAX ? (len - off) : (int)DBG_LINE_MAX));
+    return len;
+}
@@ -0,0 +1,158 @@
+#include "energy.h"
+#include "tmr.h"
+#include <string.h>
+
+static const char *const k_names[NRG_N] = {
+    [NRG_RUN_BURST]   = "run_b",
+    [NRG_RUN_IDLE]    = "run_i",
+    [NRG_SLEEP_BURST] = "slp_b",
+    [NRG_SLEEP_IDLE]  = "slp_i",
+    [NRG_RF]          = "rf",
+    [NRG_UART_TX]     = "tx",
+    [NRG_BASE]        = "base",
+};
+
+static uint32_t nrg_ua[NRG_N] = {
+    [NRG_RUN_BURST]   = NRG_UA_RUN_BURST,
+    [NRG_RUN_IDLE]    = NRG_UA_RUN_IDLE,
+    [NRG_SLEEP_BURST] = NRG_UA_SLEEP_BURST,
+    [NRG_SLEEP_IDLE]  = NRG_UA_SLEEP_IDLE,
+    [NRG_RF]          = NRG_UA_RF,
+    [NRG_UART_TX]     = NRG_UA_UART_TX,
+    [NRG_BASE]        = NRG_UA_BASE,
+};
+
+static uint64_t nrg_us[NRG_N];      /* closed residency */
+static uint32_t nrg_since[NRG_N];   /* start of the open stay */
+static bool     nrg_on[NRG_N];
+static bool     mcu_burst = true;
+static bool     mcu_asleep;
+
+/* Close every open stay at now, so nothing spans a TMR_Micros() wrap */
+static void fold(uint32_t now)
+{
+    for (uint32_t s = 0; s < NRG_N; ++s) {
+        if (!nrg_on[s]) continue;
+        nrg_us[s]   += now - nrg_since[s];
+        nrg_since[s] = now;
+    }
+}
+
+static void set(NrgState_t s, bool on, uint32_t now)
+{
+    if (nrg_on[s] == on) return;
+    if (on) nrg_since[s] = now;
+    else    nrg_us[s] += now - nrg_since[s];
+    nrg_on[s] = on;
+}
+
+static NrgState_t mcu_state(void)
+{
+    if (mcu_asleep) return mcu_burst ? NRG_SLEEP_BURST : NRG_SLEEP_IDLE;
+    return mcu_burst ? NRG_RUN_BURST : NRG_RUN_IDLE;
+}
+
+/* Move the MCU between its four states; interrupts masked by the caller */
+static void mcu_move(bool burst, bool asleep)
+{
+    uint32_t now = TMR_Micros();
+
+    fold(now);
+    set(mcu_state(), false, now);
+    mcu_burst  = burst;
+    mcu_asleep = asleep;
+    set(mcu_state(), true, now);
+}
+
+/* ---------------- Public API ---------------- */
+
+void NRG_Init(void)
+{
+    uint32_t now = TMR_Micros();
+
+    set(NRG_BASE, true, now);
+    set(mcu_state(), true, now);
+}
+
+void NRG_Sleep(bool asleep)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    mcu_move(mcu_burst, asleep);
+    __set_PRIMASK(primask);
+}
+
+void NRG_Clock(bool burst)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    mcu_move(burst, mcu_asleep);
+    __set_PRIMASK(primask);
+}
+
+void NRG_Set(NrgState_t s, bool on)
+{
+    uint32_t primask;
+
+    if (s != NRG_RF && s != NRG_UART_TX) return;
+    primask = __get_PRIMASK();
+    __disable_irq();
+    set(s, on, TMR_Micros());
+    __set_PRIMASK(primask);
+}
+
+uint32_t NRG_ResidencyMs(NrgState_t s)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint64_t us;
+
+    if ((uint32_t)s >= NRG_N) return 0;
+    __disable_irq();
+    fold(TMR_Micros());
+    us = nrg_us[s];
+    __set_PRIMASK(primask);
+    return (uint32_t)(us / 1000u);
+}
+
+uint32_t NRG_ChargeNAh(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint64_t q = 0;                      /* uA * us; 3.6e6 of them make a nAh */
+
+    __disable_irq();
+    fold(TMR_Micros());
+    for (uint32_t s = 0; s < NRG_N; ++s) q += nrg_us[s] * nrg_ua[s];
+    __set_PRIMASK(primask);
+    return (uint32_t)(q / 3600000u);
+}
+
+const char *NRG_Name(NrgState_t s)
+{
+    return ((uint32_t)s < NRG_N) ? k_names[s] : "";
+}
+
+uint32_t NRG_GetUA(NrgState_t s)
+{
+    return ((uint32_t)s < NRG_N) ? nrg_ua[s] : 0u;
+}
+
+bool NRG_SetUA(NrgState_t s, uint32_t ua)
+{
+    if ((uint32_t)s >= NRG_N) return false;
+    nrg_ua[s] = ua;
+    return true;
+}
+
+void NRG_Reset(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t now;
+
+    __disable_irq();
+    now = TMR_Micros();
+    memset(nrg_us, 0, sizeof(nrg_us));
+    for (uint32_t s = 0; s < NRG_N; ++s) nrg_since[s] = now;
+    __set_PRIMASK(primask);
+}
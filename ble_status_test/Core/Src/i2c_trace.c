@@ -0,0 +1,146 @@
+#include "i2c_trace.h"
+#include "dbg_out.h"
+#include "tmr.h"
+#include "trace.h"
+#include <stdarg.h>
+#include <string.h>
+
+#if (I2CT_DEPTH & (I2CT_DEPTH - 1u)) || I2CT_DEPTH > 128u
+#error "I2CT_DEPTH must be a power of two up to 128"
+#endif
+
+#define F_RX        0x80u
+#define F_REP_POS   2u
+#define F_REP_MAX   31u          /* repeats - 1 */
+#define F_ST_MASK   0x03u
+
+typedef struct {
+    uint32_t t_us;               /* start; of the first one when folded */
+    uint16_t dur_us;             /* of the last one, saturating */
+    uint8_t  len;                /* saturating */
+    uint8_t  flags;              /* F_RX | (repeats - 1) << F_REP_POS | HAL status */
+    uint8_t  data[I2CT_BYTES];
+} entry_t;
+
+static const char k_hex[] = "0123456789ABCDEF";
+
+static entry_t  ring[I2CT_DEPTH];
+static uint16_t ring_head;       /* entries recorded, free running */
+static bool     frozen;
+static uint16_t skipped;         /* transactions missed while frozen */
+static uint8_t  streak;
+static uint16_t dump_first;
+static uint8_t  dump_n;
+
+static int fmt(char *buf, uint16_t size, const char *f, ...)
+{
+    va_list ap;
+    int n;
+    va_start(ap, f);
+    n = DBG_Format(buf, size, f, ap);
+    va_end(ap);
+    return n;
+}
+
+static uint16_t clip(int n, uint16_t size)
+{
+    if (n < 0) return 0;
+    return (uint16_t)((uint32_t)n < size ? (uint32_t)n : size - 1u);
+}
+
+/* ---------------- Public API ---------------- */
+
+void I2CT_Record(bool rx, const uint8_t *data, uint16_t len, HAL_StatusTypeDef st, uint32_t t0_us)
+{
+    uint32_t dur = TMR_Micros() - t0_us;
+    uint8_t  flags = (uint8_t)((rx ? F_RX : 0u) | ((uint8_t)st & F_ST_MASK));
+    entry_t *e;
+
+    if (TRACE_On(TRACE_PORT_I2C)) {
+        uint16_t n = len > 255u ? 255u : len;
+        if (TRACE_Word(TRACE_PORT_I2C, I2CT_REC_HDR(rx, st, dur > 0x1FFFu ? 0x1FFFu : dur, n)) &&
+            TRACE_Word(TRACE_PORT_I2C, t0_us))
+            (void)TRACE_Write(TRACE_PORT_I2C, data, n);
+    }
+
+    if (frozen) {
+        if (skipped != UINT16_MAX) skipped++;
+        return;
+    }
+    if (dur > UINT16_MAX) dur = UINT16_MAX;
+
+    /* Same status byte read again: fold into the last entry */
+    if (ring_head && rx && len == 1u) {
+        e = &ring[(uint16_t)(ring_head - 1u) & (I2CT_DEPTH - 1u)];
+        if (e->len == 1u && (e->flags & (F_RX | F_ST_MASK)) == flags &&
+            e->data[0] == data[0] && (e->flags >> F_REP_POS & F_REP_MAX) < F_REP_MAX) {
+            e->flags = (uint8_t)(e->flags + (1u << F_REP_POS));
+            e->dur_us = (uint16_t)dur;
+            return;
+        }
+    }
+
+    e = &ring[ring_head & (I2CT_DEPTH - 1u)];
+    ring_head++;
+    e->t_us   = t0_us;
+    e->dur_us = (uint16_t)dur;
+    e->len    = (uint8_t)(len > 255u ? 255u : len);
+    e->flags  = flags;
+    memcpy(e->data, data, len < I2CT_BYTES ? len : I2CT_BYTES);
+}
+
+bool I2CT_Fault(void)
+{
+    if (streak == UINT8_MAX) return false;
+    return ++streak == I2CT_STREAK;
+}
+
+void I2CT_Clean(void)
+{
+    streak = 0;
+}
+
+uint8_t I2CT_Freeze(void)
+{
+    uint16_t n = ring_head < I2CT_DEPTH ? ring_head : I2CT_DEPTH;
+
+    frozen     = true;
+    dump_first = (uint16_t)(ring_head - n);
+    dump_n     = (uint8_t)n;
+    return (uint8_t)(n + 2u);
+}
+
+uint16_t I2CT_Line(uint8_t i, char *buf, uint16_t size)
+{
+    const entry_t *e;
+    uint16_t w;
+    uint8_t n;
+
+    if (i == 0u)
+        return clip(fmt(buf, size, "I2C BEGIN n=%u skipped=%u faults=%u t=%lu\r\n",
+                        dump_n, skipped, streak, (unsigned long)TMR_Micros()), size);
+    if (i > dump_n)
+        return (i == dump_n + 1u) ? clip(fmt(buf, size, "I2C END\r\n"), size) : 0u;
+
+    e = &ring[(uint16_t)(dump_first + i - 1u) & (I2CT_DEPTH - 1u)];
+    w = clip(fmt(buf, size, "I2C %lu %c %u %u %u %u ", (unsigned long)e->t_us,
+                 (e->flags & F_RX) ? 'R' : 'W', e->len, e->flags & F_ST_MASK,
+                 e->dur_us, (e->flags >> F_REP_POS & F_REP_MAX) + 1u), size);
+    n = e->len < I2CT_BYTES ? e->len : I2CT_BYTES;
+    for (uint8_t k = 0; k < n && w + 5u <= size; ++k) {
+        buf[w++] = k_hex[e->data[k] >> 4];
+        buf[w++] = k_hex[e->data[k] & 0x0Fu];
+    }
+    if (w + 3u <= size) {
+        buf[w++] = '\r';
+        buf[w++] = '\n';
+        buf[w] = 0;
+    }
+    return w;
+}
+
+void I2CT_Resume(void)
+{
+    frozen  = false;
+    skipped = 0;
+}
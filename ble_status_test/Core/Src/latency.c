@@ -0,0 +1,123 @@
+#include "latency.h"
+#include "tmr.h"
+#include <string.h>
+
+typedef struct {
+    LatStats_t st;
+    uint16_t   hist[LAT_BUCKETS];
+} stage_t;
+
+static const char *const k_names[LAT_N] = {
+    [LAT_RF]     = "rf",
+    [LAT_I2C]    = "i2c",
+    [LAT_FORMAT] = "fmt",
+    [LAT_QUEUE]  = "queue",
+    [LAT_WIRE]   = "wire",
+    [LAT_TOTAL]  = "total",
+};
+
+static stage_t       stages[LAT_N];
+static uint32_t      lat_t[LAT_T_N];
+static volatile bool lat_open;
+static uint32_t      lat_lost;
+
+static void observe(LatStage_t s, uint32_t us)
+{
+    stage_t *g = &stages[s];
+    uint32_t q = us / LAT_BASE_US;
+    uint32_t k = q ? 32u - __CLZ(q) : 0u;
+
+    if (k >= LAT_BUCKETS) k = LAT_BUCKETS - 1u;
+    if (g->hist[k] != UINT16_MAX) g->hist[k]++;
+    if (us > g->st.max) g->st.max = us;
+    g->st.sum += us;
+    g->st.n++;
+}
+
+/* ---------------- Public API ---------------- */
+
+bool LAT_Begin(uint32_t poll_us, uint32_t ready_us, uint32_t read_us)
+{
+    uint32_t primask = __get_PRIMASK();
+    bool ok = true;
+
+    __disable_irq();
+    if (lat_open) {
+        if (read_us - lat_t[LAT_T_POLL] < LAT_STALE_US) ok = false;
+        else lat_lost++;
+    }
+    if (ok) {
+        memset(lat_t, 0, sizeof(lat_t));
+        lat_t[LAT_T_POLL]  = poll_us;
+        lat_t[LAT_T_READY] = ready_us;
+        lat_t[LAT_T_READ]  = read_us;
+        lat_open = true;
+    }
+    __set_PRIMASK(primask);
+    return ok;
+}
+
+void LAT_Cancel(void)
+{
+    lat_open = false;
+}
+
+void LAT_Stamp(LatPoint_t p)
+{
+    if (lat_open && (uint32_t)p < LAT_T_N) lat_t[p] = TMR_Micros();
+}
+
+void LAT_Done(void)
+{
+    uint32_t now = TMR_Micros();
+    const uint32_t *t = lat_t;
+
+    if (!lat_open) return;
+    lat_open = false;
+    observe(LAT_RF,     t[LAT_T_READY] - t[LAT_T_POLL]);
+    observe(LAT_I2C,    t[LAT_T_READ] - t[LAT_T_READY]);
+    observe(LAT_FORMAT, t[LAT_T_FMT1] - t[LAT_T_FMT0]);
+    observe(LAT_QUEUE,  (t[LAT_T_FMT0] - t[LAT_T_READ]) + (t[LAT_T_TXSTART] - t[LAT_T_FMT1]));
+    observe(LAT_WIRE,   now - t[LAT_T_TXSTART]);
+    observe(LAT_TOTAL,  now - t[LAT_T_POLL]);
+}
+
+bool LAT_Busy(void)
+{
+    return lat_open;
+}
+
+void LAT_Stats(LatStage_t s, LatStats_t *out)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    if ((uint32_t)s >= LAT_N) { memset(out, 0, sizeof(*out)); return; }
+    __disable_irq();
+    *out = stages[s].st;
+    __set_PRIMASK(primask);
+}
+
+const uint16_t *LAT_Hist(LatStage_t s)
+{
+    return ((uint32_t)s < LAT_N) ? stages[s].hist : NULL;
+}
+
+const char *LAT_Name(LatStage_t s)
+{
+    return ((uint32_t)s < LAT_N) ? k_names[s] : "";
+}
+
+uint32_t LAT_Lost(void)
+{
+    return lat_lost;
+}
+
+void LAT_Reset(void)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    memset(stages, 0, sizeof(stages));
+    lat_lost = 0;
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,72 @@
+#include "memmon.h"
+#include "dbg_out.h"
+#include "trace.h"
+
+#define PAINT  0xC5C5C5C5u
+
+extern uint8_t _end;      /* heap start, linker script */
+extern uint8_t _estack;   /* RAM end */
+
+static uint32_t *scan_at;      /* next word of the pass in progress, NULL = none */
+static uint32_t *stack_low;    /* lowest stack word found written */
+static uint32_t  warned_at;    /* headroom at the last warning, 0 = none yet */
+
+/* First word above everything the heap has ever handed out */
+static uint32_t *heap_top(void)
+{
+    return (uint32_t *)(((uintptr_t)&_end + SYSMEM_HeapPeak() + 3u) & ~(uintptr_t)3u);
+}
+
+static void check_headroom(void)
+{
+    uint32_t room = MEM_Headroom();
+
+    if (room >= MEM_WARN_BYTES) return;
+    if (warned_at && room >= warned_at) return;
+    warned_at = room ? room : 1u;
+    TRACE_Event(TRACE_EV_MEMLOW, room);
+    DBG_Printf("MEM LOW: %lu B free, stack %lu B, heap %lu B\r\n", (unsigned long)room,
+               (unsigned long)MEM_StackPeak(), (unsigned long)SYSMEM_HeapPeak());
+}
+
+/* ---------------- Public API ---------------- */
+
+void MEM_Paint(void)
+{
+    uint32_t *p   = heap_top();
+    uint32_t *end = (uint32_t *)(uintptr_t)((__get_MSP() - MEM_PAINT_GUARD) & ~3u);
+
+    while (p < end) *p++ = PAINT;
+    stack_low = end;                     /* the guard and above count as used */
+}
+
+bool MEM_Scan(uint16_t words)
+{
+    if (!stack_low) return false;        /* never painted */
+    if (!scan_at) scan_at = heap_top();
+
+    /* Bottom-up: the first written word is the deepest the stack has been.
+       Locals that were never written leave paint behind, so scanning down
+       from the last peak would stop too early. */
+    for (; words && scan_at < stack_low; --words, ++scan_at) {
+        if (*scan_at != PAINT) {
+            stack_low = scan_at;
+            break;
+        }
+    }
+    if (scan_at < stack_low) return false;    /* out of words this time */
+    scan_at = NULL;
+    check_headroom();
+    return true;
+}
+
+uint32_t MEM_StackPeak(void)
+{
+    return stack_low ? (uint32_t)(&_estack - (uint8_t *)stack_low) : 0u;
+}
+
+uint32_t MEM_Headroom(void)
+{
+    uint32_t *top = heap_top();
+    return (stack_low && stack_low > top) ? (uint32_t)((uint8_t *)stack_low - (uint8_t *)top) : 0u;
+}
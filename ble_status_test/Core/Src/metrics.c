@@ -0,0 +1,55 @@
+#include "metrics.h"
+
+uint32_t        met_count[MET_N];
+static uint16_t met_hist[MET_H_N][MET_BUCKETS];
+
+#if MET_FRAME_SIZE - 2u > 255u
+#error "metrics snapshot no longer fits a one-byte LEN"
+#endif
+
+static uint8_t *put16(uint8_t *p, uint16_t v)
+{
+    *p++ = (uint8_t)v;
+    *p++ = (uint8_t)(v >> 8);
+    return p;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    p = put16(p, (uint16_t)v);
+    return put16(p, (uint16_t)(v >> 16));
+}
+
+/* ---------------- Public API ---------------- */
+
+void MET_Observe(MetricHist_t h, uint32_t value)
+{
+    uint32_t k = value ? 32u - __CLZ(value) : 0u;
+    uint16_t *b;
+
+    if ((uint32_t)h >= MET_H_N) return;
+    if (k >= MET_BUCKETS) k = MET_BUCKETS - 1u;
+    b = &met_hist[h][k];
+    if (*b != UINT16_MAX) (*b)++;
+}
+
+uint16_t MET_Snapshot(uint8_t *buf)
+{
+    uint8_t *p = buf;
+    uint8_t  sum = 0;
+
+    *p++ = MET_FRAME_MAGIC;
+    *p++ = (uint8_t)(MET_FRAME_SIZE - 2u);
+    *p++ = MET_FRAME_VERSION;
+    *p++ = MET_N;
+    *p++ = MET_H_N;
+    *p++ = MET_BUCKETS;
+    p = put32(p, HAL_GetTick() / 1000u);
+    for (uint32_t i = 0; i < MET_N; ++i) p = put32(p, met_count[i]);
+    for (uint32_t h = 0; h < MET_H_N; ++h)
+        for (uint32_t k = 0; k < MET_BUCKETS; ++k) p = put16(p, met_hist[h][k]);
+
+    for (uint8_t *q = &buf[1]; q < p; ++q) sum = (uint8_t)(sum + *q);
+    *p++ = (uint8_t)(~sum + 1u);
+    return (uint16_t)(p - buf);
+}
@@ -0,0 +1,144 @@
+#include "msi_cal.h"
+
+#define CAP_TIMEOUT_MS  5u      /* one capture is 244 us; the LSE has stopped */
+
+static bool    cal_valid;
+static int32_t cal_found_ppm;
+static int32_t cal_left_ppm;
+
+/* Run in progress: the best trim so far and its error, the trim under test */
+static bool    cal_trying;
+static int8_t  cal_trim;
+static int8_t  cal_step;
+static int32_t cal_err;
+static uint32_t cal_steps;
+
+static int8_t trim_get(void)
+{
+    return (int8_t)((RCC->ICSCR & RCC_ICSCR_MSITRIM) >> RCC_ICSCR_MSITRIM_Pos);
+}
+
+static void trim_set(int8_t t)
+{
+    __HAL_RCC_MSI_CALIBRATIONVALUE_ADJUST((uint8_t)t);
+}
+
+/* Wait for the next capture; false on timeout or a missed one */
+static bool capture(uint16_t *ccr)
+{
+    uint32_t t0 = HAL_GetTick();
+    while (!(TIM10->SR & TIM_SR_CC1IF)) {
+        if ((HAL_GetTick() - t0) > CAP_TIMEOUT_MS) return false;
+    }
+    if (TIM10->SR & TIM_SR_CC1OF) return false;
+    *ccr = (uint16_t)TIM10->CCR1;                 /* clears CC1IF */
+    return true;
+}
+
+/* SYSCLK in Hz, counted over MSICAL_CAPTURES x 8 LSE periods */
+static bool measure(uint32_t *hz)
+{
+    uint16_t prev, cur;
+    uint32_t cycles = 0;
+    bool ok;
+
+    __HAL_RCC_TIM10_CLK_ENABLE();
+    TIM10->CR1   = 0;
+    TIM10->PSC   = 0;
+    TIM10->ARR   = 0xFFFFu;
+    TIM10->OR    = TIM_OR_TI1RMP_1;                    /* TI1 = LSE (RMP_0 is the LSI) */
+    TIM10->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_IC1PSC;  /* IC1 on TI1, every 8th edge */
+    TIM10->CCER  = TIM_CCER_CC1E;
+    TIM10->EGR   = TIM_EGR_UG;
+    TIM10->SR    = 0;
+    TIM10->CR1   = TIM_CR1_CEN;
+
+    ok = capture(&prev);
+    for (uint32_t i = 0; ok && i < MSICAL_CAPTURES; ++i) {
+        ok = capture(&cur);
+        cycles += (uint16_t)(cur - prev);
+        prev = cur;
+    }
+
+    TIM10->CR1 = 0;
+    __HAL_RCC_TIM10_CLK_DISABLE();
+    if (!ok) return false;
+    *hz = (uint32_t)(((uint64_t)cycles * MSICAL_LSE_HZ) / (8u * MSICAL_CAPTURES));
+    return true;
+}
+
+static bool error_ppm(int32_t *ppm)
+{
+    uint32_t hz, nominal = HAL_RCC_GetSysClockFreq();
+    if (!measure(&hz)) return false;
+    *ppm = (int32_t)((((int64_t)hz - (int64_t)nominal) * 1000000) / (int64_t)nominal);
+    return true;
+}
+
+static int32_t iabs(int32_t v) { return v < 0 ? -v : v; }
+
+/* Keep the best trim; the result stands */
+static bool finish(void)
+{
+    trim_set(cal_trim);
+    cal_trying   = false;
+    cal_left_ppm = cal_err;
+    cal_valid    = true;
+    return true;
+}
+
+/* MSI runs fast -> lower the trim, and the other way round */
+static bool try_next(void)
+{
+    cal_step = (cal_err > 0) ? -1 : 1;
+    if (cal_steps == MSICAL_STEPS || cal_err == 0 ||
+        (cal_trim == INT8_MIN && cal_step < 0) || (cal_trim == INT8_MAX && cal_step > 0))
+        return finish();
+    trim_set((int8_t)(cal_trim + cal_step));
+    cal_trying = true;
+    return false;
+}
+
+/* ---------------- Public API ---------------- */
+
+void MSICAL_Init(void)
+{
+    HAL_PWR_EnableBkUpAccess();
+    __HAL_RCC_LSE_CONFIG(RCC_LSE_ON);
+}
+
+bool MSICAL_Step(void)
+{
+    int32_t err;
+    bool ok = __HAL_RCC_GET_FLAG(RCC_FLAG_LSERDY) != RESET &&
+              __HAL_RCC_GET_SYSCLK_SOURCE() == RCC_SYSCLKSOURCE_STATUS_MSI &&
+              error_ppm(&err);
+
+    if (!cal_trying) {
+        if (!ok) return true;                 /* nothing touched */
+        cal_found_ppm = err;
+        cal_err   = err;
+        cal_trim  = trim_get();
+        cal_steps = 0;
+        return try_next();
+    }
+    /* Stop when a step no longer improves, or can't be measured */
+    if (!ok || iabs(err) >= iabs(cal_err)) return finish();
+    cal_trim += cal_step;
+    cal_err   = err;
+    cal_steps++;
+    return try_next();
+}
+
+bool MSICAL_Error(int32_t *found_ppm, int32_t *left_ppm)
+{
+    if (!cal_valid) return false;
+    if (found_ppm) *found_ppm = cal_found_ppm;
+    if (left_ppm)  *left_ppm  = cal_left_ppm;
+    return true;
+}
+
+int8_t MSICAL_Trim(void)
+{
+    return trim_get();
+}
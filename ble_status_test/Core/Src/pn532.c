@@ -30,6 +30,7 @@ static bool wait_ready(uint32_t timeout_ms)
     uint8_t  b  = 0;
     do {
         if (i2c_read(&b, 1) == HAL_OK && b == 0x01) return true;
+        HAL_Delay(1);                   /* sleeps (tmr.c) instead of hammering the bus */
     } while ((HAL_GetTick() - t0) < timeout_ms);
     return false;
 }
@@ -84,51 +85,44 @@ static bool read_ack(uint32_t timeout_ms)
             buf[5] == 0xFF && buf[6] == 0x00);
 }
 
-/* Read a whole response frame into 'out'. Returns payload length (TFI+PD length),
-   or 0 on error. Expects a ready status first. */
+/* Read a whole response frame and copy its TFI + PD bytes to 'out'. Returns
+   their count (LEN), or 0 on error. Every I2C read starts over with the
+   status byte and the frame from its first byte, so the header is read once
+   for LEN and then the frame again in full, in one transfer. */
 static uint16_t read_response(uint8_t *out, uint16_t out_max, uint32_t timeout_ms)
 {
     if (!wait_ready(timeout_ms)) return 0;
 
-    /* Read header first: status + 5 bytes */
-    uint8_t hdr[7] = {0};
-    if (i2c_read(hdr, sizeof(hdr)) != HAL_OK) return 0;
-    if (hdr[0] != 0x01) return 0; /* not ready */
-    if (!(hdr[1]==0x00 && hdr[2]==0x00 && hdr[3]==0xFF)) return 0;
+    /* Header first: status + 00 00 FF LEN LCS */
+    uint8_t buf[1 + 5 + 64 + 2] = {0};
+    if (i2c_read(buf, 6) != HAL_OK) return 0;
+    if (buf[0] != 0x01) return 0; /* not ready */
+    if (!(buf[1]==0x00 && buf[2]==0x00 && buf[3]==0xFF)) return 0;
 
-    uint8_t LEN = hdr[4];
-    uint8_t LCS = hdr[5];
+    uint8_t LEN = buf[4];
+    uint8_t LCS = buf[5];
     if ((uint8_t)(LEN + LCS) != 0x00) return 0;
+    if (LEN < 2 || LEN > out_max || LEN > 64) return 0; /* need at least TFI + RSP */
 
-    /* Read payload (LEN bytes) + postamble (1) */
-    uint16_t to_read = (uint16_t)LEN + 1; /* + postamble */
-    if (to_read > out_max) return 0;
-    if (i2c_read(out, to_read) != HAL_OK) return 0;
+    /* Whole frame: status, header, [TFI][PD0..PDn-1], DCS, postamble */
+    if (i2c_read(buf, (uint16_t)(6 + LEN + 2)) != HAL_OK) return 0;
+    if (buf[0] != 0x01 || buf[4] != LEN) return 0;
 
-    /* out[LEN] should be 0x00 (postamble). Checksum is inside the LEN area:
-       [TFI][PD0..PDn-1][DCS] */
-    if (out[LEN] != 0x00) return 0;
-
-    /* Verify TFI/DCS */
-    if (LEN < 3) return 0; /* need at least TFI + RSP + DCS */
     uint8_t sum = 0;
-    for (uint8_t i=0; i<LEN-1; ++i) sum += out[i];        /* exclude DCS */
-    uint8_t DCS = out[LEN-1];
-    if ((uint8_t)(sum + DCS) != 0x00) return 0;
+    for (uint8_t i=0; i<=LEN; ++i) sum += buf[6 + i];    /* TFI..PD + DCS */
+    if (sum != 0x00) return 0;
 
-    return LEN; /* includes TFI + PD bytes + DCS (we keep all for parsing) */
+    memcpy(out, &buf[6], LEN);
+    return LEN;
 }
 
 /* ---------------- Public API ---------------- */
 
 bool PN532_Begin(void)
 {
-    /* A tiny wake delay helps after power-up */
-    HAL_Delay(10);
-    /* A no-op command (GetFirmware) also wakes the chip */
-    uint8_t dummy;
-    (void)PN532_GetFirmwareVersion((uint32_t*)&dummy);
-    return PN532_SAMConfiguration();
+    /* Any command frame wakes the chip, so SAMConfiguration is the wake-up;
+       if the chip was still asleep the first one goes unanswered. */
+    return PN532_SAMConfiguration() || PN532_SAMConfiguration();
 }
 
 bool PN532_GetFirmwareVersion(uint32_t *out)
@@ -189,10 +183,10 @@ bool PN532_ReadPassiveTargetA(uint8_t *uid, uint8_t *uid_len, uint16_t timeout_m
     off += 1;                        /* skip Tg */
     off += 2;                        /* skip ATQA */
     off += 1;                        /* skip SAK */
-    if (off >= (len-1)) return false;
+    if (off >= len) return false;
 
     uint8_t ulen = resp[off++];
-    if (ulen == 0 || (off + ulen) > (len-1)) return false;
+    if (ulen == 0 || ulen > 10 || (off + ulen) > len) return false; /* NFCID1 is 4, 7 or 10 */
 
     memcpy(uid, &resp[off], ulen);
     *uid_len = ulen;
@@ -0,0 +1,114 @@
+#include "prof.h"
+#include "dbg_out.h"
+#include "trace.h"
+#include <stdarg.h>
+#include <string.h>
+
+#if PROF_ENABLE
+
+typedef struct {
+    uint32_t n;
+    uint32_t min;        /* 0.1 us */
+    uint32_t max;
+    uint64_t sum;
+} scope_t;
+
+static const char *const k_names[PROF_N] = {
+    [PROF_PN532_TX]    = "pn_tx",
+    [PROF_PN532_READY] = "pn_ready",
+    [PROF_PN532_ACK]   = "pn_ack",
+    [PROF_PN532_RX]    = "pn_rx",
+    [PROF_PN532_PARSE] = "pn_parse",
+    [PROF_POLL]        = "poll",
+    [PROF_BLE_PRINT]   = "ble_print",
+    [PROF_CMD]         = "cmd",
+};
+
+static scope_t  scopes[PROF_N];
+static uint32_t prof_skew;       /* sleep cycles CYCCNT did not count */
+
+static int fmt(char *buf, uint16_t size, const char *f, ...)
+{
+    va_list ap;
+    int n;
+    va_start(ap, f);
+    n = DBG_Format(buf, size, f, ap);
+    va_end(ap);
+    return n;
+}
+
+/* ---------------- Public API ---------------- */
+
+void PROF_Init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0u;
+    DWT->CTRL  |= DWT_CTRL_CYCCNTENA_Msk;
+    PROF_Reset();
+}
+
+uint32_t PROF_Now(void)
+{
+    return DWT->CYCCNT + prof_skew;
+}
+
+void PROF_Add(ProfId_t id, uint32_t cycles)
+{
+    uint32_t mhz = SystemCoreClock / 1000000u;
+    uint32_t t;
+    scope_t *s;
+
+    if ((uint32_t)id >= PROF_N) return;
+    if (mhz == 0u) mhz = 1u;
+    t = (cycles < UINT32_MAX / 10u) ? (cycles * 10u) / mhz : (cycles / mhz) * 10u;
+
+    s = &scopes[id];
+    if (s->n == 0u || t < s->min) s->min = t;
+    if (t > s->max) s->max = t;
+    s->sum += t;
+    s->n++;
+    (void)TRACE_Word(TRACE_PORT_PROF, ((uint32_t)id << 24) | (t < 0x00FFFFFFu ? t : 0x00FFFFFFu));
+}
+
+void PROF_Slept(uint32_t c0, uint32_t counts)
+{
+    uint32_t seen = PROF_Now() - c0;
+    if (counts > seen) prof_skew += counts - seen;
+}
+
+uint16_t PROF_Line(uint8_t i, char *buf, uint16_t size)
+{
+    const scope_t *s;
+    uint32_t avg;
+    int n;
+
+    if (i >= PROF_N || scopes[i].n == 0u) return 0;
+    s   = &scopes[i];
+    avg = (uint32_t)(s->sum / s->n);
+    n = fmt(buf, size, "%s n=%lu min=%lu.%lu avg=%lu.%lu max=%lu.%lu us\r\n", k_names[i],
+            (unsigned long)s->n,
+            (unsigned long)(s->min / 10u), (unsigned long)(s->min % 10u),
+            (unsigned long)(avg / 10u),    (unsigned long)(avg % 10u),
+            (unsigned long)(s->max / 10u), (unsigned long)(s->max % 10u));
+    if (n < 0) return 0;
+    return (uint16_t)((uint32_t)n < size ? (uint32_t)n : size - 1u);
+}
+
+void PROF_Reset(void)
+{
+    memset(scopes, 0, sizeof(scopes));
+}
+
+#else
+
+uint16_t PROF_Line(uint8_t i, char *buf, uint16_t size)
+{
+    (void)i; (void)buf; (void)size;
+    return 0;
+}
+
+void PROF_Reset(void)
+{
+}
+
+#endif
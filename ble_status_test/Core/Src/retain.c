@@ -0,0 +1,54 @@
+#include "retain.h"
+#include <stddef.h>
+#include <string.h>
+
+#define RET_MAGIC  0x52455431u      /* "RET1" */
+
+RetState_t ret_state __attribute__((section(".noinit")));
+
+/* FNV-1a over everything before the checksum */
+static uint32_t checksum(const RetState_t *r)
+{
+    const uint8_t *p = (const uint8_t *)r;
+    uint32_t h = 2166136261u;
+
+    for (uint32_t i = 0; i < offsetof(RetState_t, sum); ++i) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* ---------------- Public API ---------------- */
+
+bool RET_Boot(void)
+{
+    uint32_t csr = RCC->CSR;
+    bool warm = !(csr & RCC_CSR_PORRSTF) && ret_state.magic == RET_MAGIC &&
+                ret_state.size == sizeof(RetState_t) && ret_state.sum == checksum(&ret_state);
+
+    RCC->CSR |= RCC_CSR_RMVF;
+    if (warm) {
+        ret_state.warm_boots++;
+        memcpy(met_count, ret_state.met, sizeof(met_count));
+    } else {
+        memset(&ret_state, 0, sizeof(ret_state));
+        ret_state.magic = RET_MAGIC;
+        ret_state.size  = sizeof(RetState_t);
+    }
+    ret_state.reset_flags = (uint8_t)(csr >> 24);
+    RET_Commit();
+    return warm;
+}
+
+void RET_Commit(void)
+{
+    memcpy(ret_state.met, met_count, sizeof(ret_state.met));
+    ret_state.sum = checksum(&ret_state);
+}
+
+void RET_Fault(uint8_t cause)
+{
+    ret_state.fault = cause;
+    RET_Commit();
+}
@@ -0,0 +1,89 @@
+#include "sched.h"
+#include "tmr.h"
+
+#define Q_MASK  (SCHED_QUEUE_LEN - 1u)
+
+#if (SCHED_QUEUE_LEN & Q_MASK) != 0 || SCHED_QUEUE_LEN > 128u
+#error "SCHED_QUEUE_LEN must be a power of two up to 128"
+#endif
+
+typedef struct {
+    SchedFn fn;
+    void   *arg;
+} call_t;
+
+typedef struct {
+    call_t           slot[SCHED_QUEUE_LEN];
+    volatile uint8_t head;      /* free-running, written under PRIMASK */
+    volatile uint8_t tail;      /* free-running, written by the loop only */
+    uint8_t          high;
+} queue_t;
+
+static queue_t           q[SCHED_PRIO_N];
+static volatile uint32_t sched_dropped;
+
+/* ---------------- Public API ---------------- */
+
+bool SCHED_Post(SchedFn fn, void *arg, uint8_t prio)
+{
+    queue_t *qu;
+    uint8_t  n;
+    uint32_t primask;
+
+    if (!fn || prio >= SCHED_PRIO_N) return false;
+    qu = &q[prio];
+
+    /* Producers are the loop and any ISR, so the slot claim is masked */
+    primask = __get_PRIMASK();
+    __disable_irq();
+    n = (uint8_t)(qu->head - qu->tail);
+    if (n >= SCHED_QUEUE_LEN) {
+        sched_dropped++;
+        __set_PRIMASK(primask);
+        return false;
+    }
+    qu->slot[qu->head & Q_MASK].fn  = fn;
+    qu->slot[qu->head & Q_MASK].arg = arg;
+    __DMB();                          /* slot before index */
+    qu->head = (uint8_t)(qu->head + 1u);
+    if (n + 1u > qu->high) qu->high = (uint8_t)(n + 1u);
+    __set_PRIMASK(primask);
+
+    TMR_Wake();                       /* don't let the loop sleep past it */
+    return true;
+}
+
+bool SCHED_RunOnce(void)
+{
+    for (uint8_t p = 0; p < SCHED_PRIO_N; ++p) {
+        queue_t *qu = &q[p];
+        if (qu->head == qu->tail) continue;
+
+        call_t c = qu->slot[qu->tail & Q_MASK];
+        __DMB();                      /* copy out before the slot is freed */
+        qu->tail = (uint8_t)(qu->tail + 1u);
+        c.fn(c.arg);
+        return true;
+    }
+    return false;
+}
+
+void SCHED_Run(void (*idle)(void))
+{
+    for (;;) {
+        if (SCHED_RunOnce()) continue;
+        if (TMR_Poll()) continue;
+        if (idle) idle();
+        TMR_Sleep(UINT32_MAX);
+    }
+}
+
+uint32_t SCHED_Dropped(void)
+{
+    return sched_dropped;
+}
+
+uint8_t SCHED_HighWater(uint8_t prio)
+{
+    return (prio < SCHED_PRIO_N) ? q[prio].high : 0u;
+}
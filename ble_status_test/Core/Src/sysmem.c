@@ -29,6 +29,12 @@
  */
 static uint8_t *__sbrk_heap_end = NULL;
 
+/**
+ * Largest heap size handed out so far, and requests refused with ENOMEM
+ */
+static uint32_t __sbrk_heap_peak = 0;
+static uint32_t __sbrk_fails = 0;
+
 /**
  * @brief _sbrk() allocates memory to the newlib heap and is used by malloc
  *        and others from the C library
@@ -68,12 +74,38 @@ void *_sbrk(ptrdiff_t incr)
   /* Protect heap from growing into the reserved MSP stack */
   if (__sbrk_heap_end + incr > max_heap)
   {
+    __sbrk_fails++;
     errno = ENOMEM;
     return (void *)-1;
   }
 
   prev_heap_end = __sbrk_heap_end;
   __sbrk_heap_end += incr;
+  if ((uint32_t)(__sbrk_heap_end - &_end) > __sbrk_heap_peak)
+  {
+    __sbrk_heap_peak = (uint32_t)(__sbrk_heap_end - &_end);
+  }
 
   return (void *)prev_heap_end;
 }
+
+/**
+ * @brief Heap bookkeeping for the RAM budget monitor (memmon.h)
+ * @return Bytes currently handed out by _sbrk(), the most ever handed out,
+ *         and the number of refused requests
+ */
+uint32_t SYSMEM_HeapUsed(void)
+{
+  extern uint8_t _end; /* Symbol defined in the linker script */
+  return (NULL == __sbrk_heap_end) ? 0u : (uint32_t)(__sbrk_heap_end - &_end);
+}
+
+uint32_t SYSMEM_HeapPeak(void)
+{
+  return __sbrk_heap_peak;
+}
+
+uint32_t SYSMEM_HeapFails(void)
+{
+  return __sbrk_fails;
+}
@@ -0,0 +1,82 @@
+#include "tmr.h"
+
+static Tmr_t        *tmr_list;
+static volatile bool tmr_wake;
+
+/* ---- timers ---- */
+
+static bool tmr_linked(const Tmr_t *t)
+{
+    for (const Tmr_t *p = tmr_list; p; p = p->next)
+        if (p == t) return true;
+    return false;
+}
+
+void TMR_Start(Tmr_t *t, uint32_t delay_ms, uint32_t period_ms, TmrFn fn, void *arg)
+{
+    t->due    = HAL_GetTick() + delay_ms;
+    t->period = period_ms;
+    t->fn     = fn;
+    t->arg    = arg;
+    t->active = true;
+    if (!tmr_linked(t)) {
+        t->next  = tmr_list;
+        tmr_list = t;
+    }
+}
+
+void TMR_Stop(Tmr_t *t)
+{
+    for (Tmr_t **pp = &tmr_list; *pp; pp = &(*pp)->next) {
+        if (*pp == t) { *pp = t->next; break; }
+    }
+    t->active = false;
+}
+
+bool TMR_Poll(void)
+{
+    bool ran = false;
+    Tmr_t *t = tmr_list;
+
+    while (t) {
+        Tmr_t   *next = t->next;             /* fn may stop or restart t */
+        uint32_t now  = HAL_GetTick();
+
+        if (t->active && (int32_t)(now - t->due) >= 0) {
+            if (t->period) {
+                t->due += t->period;
+                if ((int32_t)(now - t->due) >= 0) t->due = now + t->period;   /* fell behind: no burst */
+            } else {
+                TMR_Stop(t);
+            }
+            t->fn(t->arg);
+            ran = true;
+        }
+        t = next;
+    }
+    return ran;
+}
+
+uint32_t TMR_NextDue(uint32_t limit)
+{
+    uint32_t now = HAL_GetTick();
+    for (const Tmr_t *t = tmr_list; t; t = t->next) {
+        int32_t d = (int32_t)(t->due - now);
+        if (!t->active) continue;
+        if (d <= 0) return 0;
+        if ((uint32_t)d < limit) limit = (uint32_t)d;
+    }
+    return limit;
+}
+
+void TMR_Wake(void)
+{
+    tmr_wake = true;
+}
+
+bool TMR_WakePending(void)
+{
+    if (!tmr_wake) return false;
+    tmr_wake = false;
+    return true;
+}
@@ -0,0 +1,133 @@
+#include "tmr.h"
+#include "ble_link.h"
+#include "prof.h"
+#include "energy.h"
+
+/* Target side of tmr.h: TMR_Sleep() with a stretched SysTick, and the
+   sleeping HAL_Delay(). */
+
+#define SYSTICK_MAX  0x00FFFFFFu
+
+static uint32_t sleep_ms;       /* whole ticks slept */
+static uint32_t sleep_cnt;      /* SysTick counts slept, below one tick */
+static uint32_t sleep_per;      /* tick length sleep_cnt was counted in */
+
+static void count_sleep(uint32_t counts, uint32_t per)
+{
+    if (per != sleep_per) { sleep_per = per; sleep_cnt = 0; }   /* clock profile changed */
+    sleep_cnt += counts;
+    sleep_ms  += sleep_cnt / per;
+    sleep_cnt %= per;
+}
+
+void TMR_Sleep(uint32_t max_ms)
+{
+    uint32_t n = TMR_NextDue(max_ms);
+    uint32_t per, cur, load, ctrl, c0;
+
+    if (n == 0) return;
+    if (BLE_TxFree() != BLE_TX_SIZE) n = 1;      /* the hold timer runs on SysTick */
+
+    __disable_irq();
+    if (TMR_WakePending() || (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)) {   /* work posted, or a tick waiting */
+        __enable_irq();
+        return;
+    }
+    NRG_Sleep(true);
+
+    /* Stretch the current tick so the next SysTick interrupt lands n ticks on */
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    per = SysTick->LOAD + 1u;
+    cur = SysTick->VAL;
+    if (cur == 0u) cur = per;
+    if (n > (SYSTICK_MAX - cur) / per + 1u) n = (SYSTICK_MAX - cur) / per + 1u;
+    load = cur + per * (n - 1u);
+    SysTick->LOAD = load - 1u;
+    SysTick->VAL  = 0u;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    c0 = PROF_Now();
+    __DSB();
+    __WFI();
+    __ISB();
+
+    ctrl = SysTick->CTRL;                        /* reading clears COUNTFLAG */
+    SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+
+    if (ctrl & SysTick_CTRL_COUNTFLAG_Msk) {
+        /* Slept the whole way; the pending SysTick interrupt adds the last tick */
+        uwTick += (n - 1u) * uwTickFreq;
+        count_sleep(load, per);
+        PROF_Slept(c0, load);
+        SysTick->LOAD = per - 1u;
+        SysTick->VAL  = 0u;
+    } else {
+        /* Woken early: account for the whole ticks that passed, then finish
+           the tick in progress before going back to the normal period */
+        uint32_t done = load - 1u - SysTick->VAL;
+        uint32_t ticks, rem;
+        if (done < cur) {
+            ticks = 0;
+            rem   = cur - done;
+        } else {
+            ticks = 1u + (done - cur) / per;
+            rem   = per - (done - cur) % per;
+        }
+        uwTick += ticks * uwTickFreq;
+        count_sleep(done, per);
+        PROF_Slept(c0, done);
+        SysTick->LOAD = rem - 1u;
+        SysTick->VAL  = 0u;
+    }
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = per - 1u;                    /* used from the next reload on */
+    NRG_Sleep(false);
+    __enable_irq();
+}
+
+/* Overrides the weak busy-wait in the HAL: same "at least Delay ms" meaning,
+   but the core sleeps in between. */
+void HAL_Delay(uint32_t Delay)
+{
+    uint32_t t0   = HAL_GetTick();
+    uint32_t wait = Delay;
+
+    if (wait < HAL_MAX_DELAY) wait += uwTickFreq;
+    for (uint32_t spent; (spent = HAL_GetTick() - t0) < wait; )
+        TMR_Sleep(wait - spent);
+}
+
+/* Outside TMR_Sleep() (which keeps interrupts masked while the tick is
+   stretched) LOAD always holds the normal period; after an early wake the
+   shortened tick still ends on the normal grid, so per - 1 - VAL is the
+   time into the current tick either way. */
+uint32_t TMR_Micros(void)
+{
+    uint32_t ms, val, per;
+
+    do {
+        ms  = uwTick;
+        val = SysTick->VAL;
+    } while (ms != uwTick);
+    per = SysTick->LOAD + 1u;
+
+    /* Reload happened but the interrupt has not run yet (masked caller) */
+    if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && val > per / 2u) ms += uwTickFreq;
+    if (val >= per) val = per - 1u;
+    return ms * 1000u + ((per - 1u - val) * 1000u) / per;
+}
+
+uint32_t TMR_SleepMs(void)
+{
+    return sleep_ms;
+}
+
+uint16_t TMR_DutyPermille(void)
+{
+    uint32_t up = HAL_GetTick();
+    uint32_t asleep = sleep_ms;
+
+    if (up == 0u) return 1000u;
+    if (asleep > up) asleep = up;
+    return (uint16_t)(((uint64_t)(up - asleep) * 1000u) / up);
+}
@@ -0,0 +1,109 @@
+#include "trace.h"
+
+static volatile uint32_t trace_dropped;
+
+/* Wait for room in the port's FIFO, TRACE_SPIN polls at most */
+static bool port_ready(uint8_t port)
+{
+    uint32_t spin = TRACE_SPIN;
+    while (ITM->PORT[port].u32 == 0u) {
+        if (--spin == 0u) return false;
+    }
+    return true;
+}
+
+/* ---------------- Public API ---------------- */
+
+bool TRACE_On(uint8_t port)
+{
+    return port < 32u && (ITM->TCR & ITM_TCR_ITMENA_Msk) && (ITM->TER & (1u << port));
+}
+
+uint16_t TRACE_Write(uint8_t port, const void *data, uint16_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint16_t i = 0;
+
+    if (!TRACE_On(port)) return 0;
+
+    /* Whole words go out as 4-byte packets: 5 bytes on the wire per 4 */
+    while (i < len) {
+        if (!port_ready(port)) {
+            trace_dropped += (uint32_t)(len - i);
+            break;
+        }
+        if ((uint16_t)(len - i) >= 4u) {
+            ITM->PORT[port].u32 = (uint32_t)p[i] | ((uint32_t)p[i + 1u] << 8) |
+                                  ((uint32_t)p[i + 2u] << 16) | ((uint32_t)p[i + 3u] << 24);
+            i = (uint16_t)(i + 4u);
+        } else {
+            ITM->PORT[port].u8 = p[i++];
+        }
+    }
+    return i;
+}
+
+bool TRACE_Word(uint8_t port, uint32_t w)
+{
+    if (!TRACE_On(port)) return false;
+    if (!port_ready(port)) {
+        trace_dropped += 4u;
+        return false;
+    }
+    ITM->PORT[port].u32 = w;
+    return true;
+}
+
+uint32_t TRACE_Dropped(void)
+{
+    return trace_dropped;
+}
+
+#if TRACE_ENABLE
+
+void TRACE_Init(void)
+{
+    GPIO_InitTypeDef gi = {0};
+
+    /* PB3 comes out of reset as JTDO/TRACESWO already; make it explicit */
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    gi.Pin       = GPIO_PIN_3;
+    gi.Mode      = GPIO_MODE_AF_PP;
+    gi.Pull      = GPIO_NOPULL;
+    gi.Speed     = GPIO_SPEED_FREQ_VERY_HIGH;
+    gi.Alternate = GPIO_AF0_SWJ;
+    HAL_GPIO_Init(GPIOB, &gi);
+
+    DBGMCU->CR = (DBGMCU->CR & ~DBGMCU_CR_TRACE_MODE) | DBGMCU_CR_TRACE_IOEN;   /* asynchronous SWO */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+
+    TPI->SPPR = 2u;                       /* NRZ (UART framing) */
+    TPI->FFCR = 0x100u;                   /* formatter off, ITM bytes go straight out */
+
+    ITM->LAR = 0xC5ACCE55u;
+    ITM->TCR = 0u;
+    ITM->TPR = 0u;
+    DWT->CTRL = (DWT->CTRL & ~DWT_CTRL_SYNCTAP_Msk) |
+                (1u << DWT_CTRL_SYNCTAP_Pos) |          /* sync packet every 2^24 cycles */
+                DWT_CTRL_CYCCNTENA_Msk;
+    ITM->TCR = (1u << ITM_TCR_TraceBusID_Pos) |
+               (3u << ITM_TCR_TSPrescale_Pos) |         /* timestamps in 64-cycle units */
+               ITM_TCR_SWOENA_Msk | ITM_TCR_SYNCENA_Msk |
+               ITM_TCR_TSENA_Msk | ITM_TCR_ITMENA_Msk;
+    ITM->TER = (1u << TRACE_PORT_TEXT) | (1u << TRACE_PORT_EVENT) | (1u << TRACE_PORT_PROF) |
+               (TRACE_I2C ? (1u << TRACE_PORT_I2C) : 0u);
+
+    TRACE_Retime();
+}
+
+void TRACE_Retime(void)
+{
+    uint32_t hclk = SystemCoreClock;
+    uint32_t div  = (hclk + TRACE_SWO_HZ / 2u) / TRACE_SWO_HZ;
+
+    if (div == 0u) div = 1u;
+    TPI->ACPR = div - 1u;
+    TRACE_Event(TRACE_EV_CLK, hclk / 1000u);
+}
+
+#endif
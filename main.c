@@ -1,8 +1,25 @@
 /* PN532 (I2C) -> BLE UART (USART2) */
 #include "main.h"
 #include "gpio.h"
+#include "dma.h"
 #include "usart.h"
 #include "i2c.h"
+#include "ble_link.h"
+#include "ble_cmd.h"
+#include "dbg_out.h"
+#include "clock.h"
+#include "tmr.h"
+#include "msi_cal.h"
+#include "sched.h"
+#include "spsc.h"
+#include "prof.h"
+#include "trace.h"
+#include "metrics.h"
+#include "memmon.h"
+#include "latency.h"
+#include "i2c_trace.h"
+#include "energy.h"
+#include "retain.h"
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -13,49 +30,186 @@ void Error_Handler(void);
 extern I2C_HandleTypeDef hi2c1;
 extern UART_HandleTypeDef huart2;
 
-static void ble_print(const char *s)
+static uint32_t put_hex(char *out, const uint8_t *buf, uint32_t n)
 {
-  if (!s) return;
-  (void)HAL_UART_Transmit(&huart2, (uint8_t*)s, (uint16_t)strlen(s), 200);
-}
-
-static void ble_print_hex(const uint8_t *buf, uint32_t n)
-{
-  char out[3*16 + 4];              
   const char *hex = "0123456789ABCDEF";
   uint32_t i=0, w=0;
   for (; i<n && i<16; ++i) {
     out[w++] = hex[(buf[i]>>4) & 0xF];
     out[w++] = hex[buf[i] & 0xF];
   }
-  out[w++] = '\r'; out[w++] = '\n'; out[w] = 0;
-  (void)HAL_UART_Transmit(&huart2, (uint8_t*)out, (uint16_t)w, 200);
+  out[w++] = '\r'; out[w++] = '\n';
+  return w;
+}
+
+/* One UID event as a single write, so it is queued whole or not at all.
+   A timed event is followed out by the latency stats. */
+static bool ble_write_uid(const void *out, uint16_t len, bool timed)
+{
+  if (!timed) return BLE_Write(out, len);
+  LAT_Stamp(LAT_T_FMT1);
+  return BLE_WriteMarked(out, len);
+}
+
+static bool ble_print_uid(const uint8_t *uid, uint8_t n, bool timed)
+{
+  if (reader_cfg.fmt == BLE_FMT_BINARY) {
+    uint8_t out[2 + 10 + 1];
+    uint8_t w = 0, sum = n;
+    out[w++] = 0xA5;
+    out[w++] = n;
+    for (uint8_t i = 0; i < n && i < 10; ++i) { out[w++] = uid[i]; sum += uid[i]; }
+    out[w++] = (uint8_t)(~sum + 1);
+    return ble_write_uid(out, w, timed);
+  }
+  char out[4 + 2*10 + 2];
+  memcpy(out, "UID:", 4);
+  return ble_write_uid(out, (uint16_t)(4 + put_hex(&out[4], uid, n)), timed);
+}
+
+/* UID events the link could not take yet, oldest first. The reader pushes,
+   the output task pops; when the queue is full new events are dropped
+   (MET_UID_DROPPED). */
+typedef struct {
+  uint8_t len;
+  uint8_t uid[10];
+  bool    timed;       /* the one event the latency stats follow */
+} UidEvent_t;
+
+#define UID_QUEUE_LEN  4u
+
+SPSC_DEFINE(uidq, UidEvent_t, UID_QUEUE_LEN)
+
+static uidq_t uid_q;
+
+#define OUTPUT_RETRY_MS  2u
+
+static Tmr_t output_tmr;
+static void  output_task(void *arg);
+
+static void output_due(void *arg)
+{
+  (void)arg;
+  (void)SCHED_Post(output_task, NULL, SCHED_PRIO_HIGH);
+}
+
+/* Send queued events; while the ring is full, look again shortly */
+static void output_task(void *arg)
+{
+  UidEvent_t *ev;
+  (void)arg;
+  while (uidq_span(&uid_q, &ev)) {
+    if (ev->timed) LAT_Stamp(LAT_T_FMT0);
+    PROF_START(pt);
+    bool sent = ble_print_uid(ev->uid, ev->len, ev->timed);
+    PROF_STOP(PROF_BLE_PRINT, pt);
+    if (!sent) {
+      TRACE_Event(TRACE_EV_TXFULL, uidq_count(&uid_q));
+      MET_Inc(MET_BLE_FULL);
+      TMR_Start(&output_tmr, OUTPUT_RETRY_MS, 0, output_due, NULL);
+      return;
+    }
+    uidq_drop(&uid_q, 1);
+  }
+}
+
+/* poll_us/ready_us: when the poll that found the card started, and when
+   the PN532 had its answer (for the latency stats) */
+static void emit_uid(const uint8_t *uid, uint8_t n, uint32_t poll_us, uint32_t ready_us)
+{
+  UidEvent_t ev;
+  ev.len = n;
+  memcpy(ev.uid, uid, n);
+  ev.timed = LAT_Begin(poll_us, ready_us, TMR_Micros());
+  TRACE_Event(TRACE_EV_UID, ((uint32_t)uid[0] << 16) | ((uint32_t)uid[1] << 8) | uid[2]);
+  MET_Inc(MET_UIDS);
+  if (!uidq_push(&uid_q, &ev)) {
+    MET_Inc(MET_UID_DROPPED);
+    if (ev.timed) LAT_Cancel();
+  }
+  output_task(NULL);
+}
+
+void BLE_TxMarkStartCallback(void)
+{
+  LAT_Stamp(LAT_T_TXSTART);
+}
+
+void BLE_TxMarkSentCallback(void)
+{
+  LAT_Done();
+}
+
+void BLE_TxActiveCallback(bool active)
+{
+  NRG_Set(NRG_UART_TX, active);
+}
+
+/* Push settings changed over the command channel to the modules */
+static void apply_config(void)
+{
+  (void)BLE_SetCoalesce((uint16_t)reader_cfg.mtu, (uint16_t)reader_cfg.hold_ms);   /* range checked by SET */
+  DBG_SetSink((uint8_t)reader_cfg.dbg);
 }
 
 #define PN532_I2C_ADDR      (0x24u << 1)   
 #define PN532_READY_TIMEOUT 50            
 #define PN532_XFER_TIMEOUT  100       
 
+static void i2c_dump_start(void);
+static bool pn532_abort(void);
+
+/* Every PN532 transfer goes through here, into the I2C trace */
+static HAL_StatusTypeDef pn532_xfer(bool rx, uint8_t *buf, uint16_t len)
+{
+  uint32_t t0 = TMR_Micros();
+  HAL_StatusTypeDef st = rx ? HAL_I2C_Master_Receive(&hi2c1, PN532_I2C_ADDR, buf, len, PN532_XFER_TIMEOUT)
+                            : HAL_I2C_Master_Transmit(&hi2c1, PN532_I2C_ADDR, buf, len, PN532_XFER_TIMEOUT);
+  I2CT_Record(rx, buf, len, st, t0);
+  return st;
+}
+
+/* Count a failed exchange; a streak of them dumps the I2C trace */
+static void pn532_fault(MetricId_t id)
+{
+  MET_Inc(id);
+  if (I2CT_Fault()) {
+    ret_state.pn532_ready = 0;          /* next boot runs the full set-up */
+    RET_Commit();
+    i2c_dump_start();
+  }
+}
+
 static HAL_StatusTypeDef i2c_read_status(uint8_t *status)
 {
-  return HAL_I2C_Master_Receive(&hi2c1, PN532_I2C_ADDR, status, 1, PN532_XFER_TIMEOUT);
+  return pn532_xfer(true, status, 1);
 }
 
+/* False on timeout; whether that is a fault is the caller's call */
 static bool pn532_wait_ready(uint32_t ms)
 {
   uint32_t t0 = HAL_GetTick();
+  bool ready;
+  PROF_START(pt);
   for (;;)
   {
     uint8_t st = 0;
-    if (i2c_read_status(&st) == HAL_OK && st == 0x01)
-      return true;
-    if ((HAL_GetTick() - t0) >= ms)
-      return false;
+    if (i2c_read_status(&st) == HAL_OK && st == 0x01) {
+      ready = true;
+      break;
+    }
+    if ((HAL_GetTick() - t0) >= ms) {
+      ready = false;
+      break;
+    }
     HAL_Delay(2);
   }
+  PROF_STOP(PROF_PN532_READY, pt);
+  return ready;
 }
 
-static bool pn532_write_cmd(const uint8_t *payload, uint8_t plen)
+/* Write one command frame; the PN532 ACK is collected by pn532_wait_ack() */
+static bool pn532_send(const uint8_t *payload, uint8_t plen)
 {
   uint8_t frame[8 + 64]; 
   if (plen > 60) return false;
@@ -74,38 +228,56 @@ static bool pn532_write_cmd(const uint8_t *payload, uint8_t plen)
   frame[w++] = dcs;
   frame[w++] = 0x00;
 
-  if (HAL_I2C_Master_Transmit(&hi2c1, PN532_I2C_ADDR, frame, w, PN532_XFER_TIMEOUT) != HAL_OK)
-    return false;
-
-  if (!pn532_wait_ready(PN532_READY_TIMEOUT)) return false;
-  uint8_t ack[6];
-  if (HAL_I2C_Master_Receive(&hi2c1, PN532_I2C_ADDR, ack, sizeof(ack), PN532_XFER_TIMEOUT) != HAL_OK)
-    return false;
-  static const uint8_t expect[6] = {0x00,0x00,0xFF,0x00,0xFF,0x00};
-  return (memcmp(ack, expect, 6) == 0);
+  PROF_START(pt);
+  bool ok = pn532_xfer(false, frame, w) == HAL_OK;
+  PROF_STOP(PROF_PN532_TX, pt);
+  if (!ok) pn532_fault(MET_I2C_ERR);
+  return ok;
 }
 
-static uint8_t pn532_read_resp(uint8_t *buf, uint8_t max)
+static bool pn532_wait_ack(void)
 {
-  if (!pn532_wait_ready(100)) return 0;
+  static const uint8_t expect[6] = {0x00,0x00,0xFF,0x00,0xFF,0x00};
+  uint8_t ack[7];                       /* status byte, then the frame */
 
-  uint8_t head[8];
-  if (HAL_I2C_Master_Receive(&hi2c1, PN532_I2C_ADDR, head, 6, PN532_XFER_TIMEOUT) != HAL_OK)
-    return 0;
+  /* One fault per failed exchange; MET_ACK_FAIL counts them all */
+  if (!pn532_wait_ready(PN532_READY_TIMEOUT)) {
+    MET_Inc(MET_ACK_FAIL);
+    pn532_fault(MET_READY_TIMEOUT);
+    return false;
+  }
+  PROF_START(pt);
+  HAL_StatusTypeDef st = pn532_xfer(true, ack, sizeof(ack));
+  PROF_STOP(PROF_PN532_ACK, pt);
+  if (st != HAL_OK) {
+    MET_Inc(MET_ACK_FAIL);
+    pn532_fault(MET_I2C_ERR);
+    return false;
+  }
+  if (memcmp(&ack[1], expect, 6) != 0) {
+    pn532_fault(MET_ACK_FAIL);
+    return false;
+  }
+  return true;
+}
 
-  uint8_t frame[72];
-  if (HAL_I2C_Master_Receive(&hi2c1, PN532_I2C_ADDR, frame, sizeof(frame), PN532_XFER_TIMEOUT) != HAL_OK)
-    return 0;
+static bool pn532_write_cmd(const uint8_t *payload, uint8_t plen)
+{
+  return pn532_send(payload, plen) && pn532_wait_ack();
+}
 
+/* Find and check the information frame in what was read; copy its data */
+static uint8_t pn532_parse_frame(const uint8_t *frame, uint32_t size, uint8_t *buf, uint8_t max)
+{
   uint32_t i=0;
-  while (i + 3 < sizeof(frame) && !(frame[i]==0x00 && frame[i+1]==0x00 && frame[i+2]==0xFF)) i++;
-  if (i + 6 >= sizeof(frame)) return 0;
+  while (i + 3 < size && !(frame[i]==0x00 && frame[i+1]==0x00 && frame[i+2]==0xFF)) i++;
+  if (i + 6 >= size) return 0;
 
   uint8_t len = frame[i+3];
   uint8_t lcs = frame[i+4];
   if ((uint8_t)(len + lcs) != 0x00) return 0;
 
-  if (i + 5 + len + 2 > sizeof(frame)) return 0;  
+  if (i + 5 + len + 2 > size) return 0;  
 
   const uint8_t *p = &frame[i+5];
   uint8_t dcs = 0;
@@ -119,106 +291,387 @@ static uint8_t pn532_read_resp(uint8_t *buf, uint8_t max)
   return len;
 }
 
-static bool pn532_wakeup(void)
+static uint32_t pn532_ready_us;   /* TMR_Micros() when the last response was ready */
+
+/* 'card_wait': the command was InListPassiveTarget, which the PN532 does
+   not answer until a card shows up (MxRtyPassiveActivation 0xFF), so a
+   timeout is an empty field and the exchange so far was clean. The chip
+   would go on searching with the field up; abort it. */
+static uint8_t pn532_read_resp(uint8_t *buf, uint8_t max, bool card_wait)
 {
-  const uint8_t wake[] = { 0xD4, 0x02 }; 
-  return pn532_write_cmd(wake, sizeof(wake)); 
+  if (!pn532_wait_ready(100)) {
+    if (card_wait) {
+      I2CT_Clean();
+      (void)pn532_abort();
+    } else {
+      pn532_fault(MET_READY_TIMEOUT);
+    }
+    return 0;
+  }
+  pn532_ready_us = TMR_Micros();
+
+  uint8_t head[8];
+  uint8_t frame[72];
+  PROF_START(pt);
+  bool ok = pn532_xfer(true, head, 6) == HAL_OK &&
+            pn532_xfer(true, frame, sizeof(frame)) == HAL_OK;
+  PROF_STOP(PROF_PN532_RX, pt);
+  if (!ok) {
+    pn532_fault(MET_I2C_ERR);
+    return 0;
+  }
+
+  PROF_START(pp);
+  uint8_t n = pn532_parse_frame(frame, sizeof(frame), buf, max);
+  PROF_STOP(PROF_PN532_PARSE, pp);
+  if (!n) pn532_fault(MET_FRAME_ERR);
+  else    I2CT_Clean();
+  return n;
 }
 
-static bool pn532_get_firmware(uint8_t *out, uint8_t *outlen)
+static const uint8_t k_cmd_getfw[] = { 0xD4, 0x02 };
+static const uint8_t k_cmd_sam[]   = { 0xD4, 0x14, 0x01, 0x14, 0x01 };
+
+/* Response half of GetFirmwareVersion: IC, Ver, Rev, Support */
+static bool pn532_firmware_resp(uint32_t *fw)
 {
-  const uint8_t cmd[] = { 0xD4, 0x02 };
-  if (!pn532_write_cmd(cmd, sizeof(cmd))) return false;
-  uint8_t resp[32]; uint8_t n = pn532_read_resp(resp, sizeof(resp));
-  if (n < 2 || resp[0] != 0xD5 || resp[1] != (0x02 + 1)) return false;
-  if (out && outlen) {
-    uint8_t cpy = (n-2 > *outlen) ? *outlen : (n-2);
-    memcpy(out, &resp[2], cpy); *outlen = cpy;
-  }
+  uint8_t resp[32]; uint8_t n = pn532_read_resp(resp, sizeof(resp), false);
+  if (n < 6 || resp[0] != 0xD5 || resp[1] != (0x02 + 1)) return false;
+  *fw = ((uint32_t)resp[2] << 24) | ((uint32_t)resp[3] << 16) | ((uint32_t)resp[4] << 8) | resp[5];
   return true;
 }
 
-static bool pn532_sam_config(void)
+static bool pn532_get_firmware(uint32_t *fw)
 {
-  const uint8_t cmd[] = { 0xD4, 0x14, 0x01, 0x14, 0x01 };
-  if (!pn532_write_cmd(cmd, sizeof(cmd))) return false;
-  uint8_t resp[8]; uint8_t n = pn532_read_resp(resp, sizeof(resp));
+  return pn532_write_cmd(k_cmd_getfw, sizeof(k_cmd_getfw)) && pn532_firmware_resp(fw);
+}
+
+static bool pn532_sam_resp(void)
+{
+  uint8_t resp[8]; uint8_t n = pn532_read_resp(resp, sizeof(resp), false);
   return (n>=2 && resp[0]==0xD5 && resp[1]==(0x14+1));
 }
 
-static uint8_t pn532_read_uid_iso14443a(uint8_t *uid, uint8_t max_uid)
+static bool pn532_sam_config(void)
+{
+  return pn532_write_cmd(k_cmd_sam, sizeof(k_cmd_sam)) && pn532_sam_resp();
+}
+
+/* An ACK frame from the host aborts whatever command the PN532 is still
+   running, e.g. one we were waiting on when the MCU reset */
+static bool pn532_abort(void)
+{
+  uint8_t ack[] = { 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00 };
+  bool ok = pn532_xfer(false, ack, sizeof(ack)) == HAL_OK;
+  if (!ok) MET_Inc(MET_I2C_ERR);
+  return ok;
+}
+
+/* Firmware identity of the PN532 last seen, kept in data EEPROM next to
+   the BLE baud rate (word + inverted copy). Once known, boot skips the
+   GetFirmwareVersion round trip. */
+#define PN532_FW_EEPROM_ADDR  (FLASH_EEPROM_BASE + 0x08u)
+
+static uint32_t fw_load(void)
+{
+  uint32_t v = *(__IO uint32_t *)(PN532_FW_EEPROM_ADDR);
+  uint32_t c = *(__IO uint32_t *)(PN532_FW_EEPROM_ADDR + 4u);
+  return (v == ~c) ? v : 0;
+}
+
+static void fw_store(uint32_t fw)
+{
+  if (fw_load() == fw) return;
+  if (HAL_FLASHEx_DATAEEPROM_Unlock() != HAL_OK) return;
+  (void)HAL_FLASHEx_DATAEEPROM_Program(FLASH_TYPEPROGRAMDATA_WORD, PN532_FW_EEPROM_ADDR, fw);
+  (void)HAL_FLASHEx_DATAEEPROM_Program(FLASH_TYPEPROGRAMDATA_WORD, PN532_FW_EEPROM_ADDR + 4u, ~fw);
+  (void)HAL_FLASHEx_DATAEEPROM_Lock();
+}
+
+static uint8_t pn532_read_uid(uint8_t brty, uint8_t *uid, uint8_t max_uid)
 {
-  const uint8_t cmd[] = { 0xD4, 0x4A, 0x01, 0x00 };
-  if (!pn532_write_cmd(cmd, sizeof(cmd))) return 0;
-  uint8_t resp[40]; uint8_t n = pn532_read_resp(resp, sizeof(resp));
+  const uint8_t cmd[] = { 0xD4, 0x4A, 0x01, brty };
+  uint8_t resp[40], n = 0;
+  NRG_Set(NRG_RF, true);                  /* field up until the answer is in, or the abort */
+  if (pn532_write_cmd(cmd, sizeof(cmd))) n = pn532_read_resp(resp, sizeof(resp), true);
+  NRG_Set(NRG_RF, false);
   if (n < 3 || resp[0] != 0xD5 || resp[1] != 0x4B || resp[2] == 0x00) return 0;
 
-  uint8_t uidlen = 0;
-  for (uint8_t i = 7; i + 1 < n; ++i) {
-    uint8_t L = resp[i];
-    if (L <= 10 && i + 1 + L <= n) { 
-      uidlen = L;
-      if (uid && max_uid) {
-        uint8_t cpy = (L > max_uid) ? max_uid : L;
-        memcpy(uid, &resp[i+1], cpy);
-      }
-      break;
-    }
+  /* D5 4B NbTg Tg SENS_RES(2) SEL_RES NFCIDLength NFCID1... : the length
+     is at [7] and nowhere else */
+  uint8_t L = (n > 7) ? resp[7] : 0;
+  if (L == 0 || L > 10 || 8u + L > n) return 0;
+  if (uid && max_uid) memcpy(uid, &resp[8], (L > max_uid) ? max_uid : L);
+  return L;
+}
+
+/* Boot-time diagnostics are off unless built with BOOT_DIAG=1; "SET diag 1"
+   asks for the same report at run time. */
+#ifndef BOOT_DIAG
+#define BOOT_DIAG 0
+#endif
+
+static uint32_t boot_ms;   /* HAL_Init to ready for the first card poll */
+
+static void diag_report(void)
+{
+  uint32_t fw;
+  if (pn532_get_firmware(&fw)) {
+    fw_store(fw);
+    DBG_Printf("PN532 FW: %08lX\r\n", (unsigned long)fw);
+  } else {
+    DBG_Printf("PN532 FW ERR\r\n");
   }
-  return uidlen;
+  DBG_Printf("READY %lu ms, baud %lu\r\n", (unsigned long)boot_ms, (unsigned long)BLE_GetBaud());
+  DBG_Printf("RAM stack %lu B, heap %lu B, free %lu B\r\n", (unsigned long)MEM_StackPeak(),
+             (unsigned long)SYSMEM_HeapPeak(), (unsigned long)MEM_Headroom());
 }
 
-/* ---------------- Main ---------------- */
+/* ---------------- Tasks ---------------- */
 
-int main(void)
+static Tmr_t reader_tmr;
+static Tmr_t msi_cal_tmr;
+static Tmr_t mem_tmr;
+
+static void reader_task(void *arg);
+static void msi_cal_task(void *arg);
+static void mem_task(void *arg);
+
+static void reader_due(void *arg)  { (void)arg; (void)SCHED_Post(reader_task,  NULL, SCHED_PRIO_NORMAL); }
+static void msi_cal_due(void *arg) { (void)arg; (void)SCHED_Post(msi_cal_task, NULL, SCHED_PRIO_LOW); }
+static void mem_due(void *arg)     { (void)arg; (void)SCHED_Post(mem_task,     NULL, SCHED_PRIO_LOW); }
+
+/* The burst clock was refused (TX DMA held back by CTS): I2C1 may be off
+   on the idle clock, so try again shortly rather than poll on it */
+#define READER_CLK_RETRY_MS  10u
+
+/* One card poll; reschedules itself after the quiet or idle period. The
+   card last seen is kept in ret_state, so one still in the field after a
+   warm restart is not reported again. */
+static void reader_task(void *arg)
 {
-  HAL_Init();
-  SystemClock_Config();
-  MX_GPIO_Init();
-  MX_USART2_UART_Init();
-  MX_I2C1_Init();
+  uint8_t *last_uid = ret_state.last_uid;
+  (void)arg;
+
+  /* Congested with an event already waiting: polling now would only
+     produce events we cannot send */
+  if (uidq_count(&uid_q) && BLE_Backpressure()) {
+    TMR_Start(&reader_tmr, reader_cfg.idle_ms, 0, reader_due, NULL);
+    return;
+  }
 
-  ble_print("BOOT\r\n");
+  if (!CLK_Set(CLK_BURST)) {
+    TMR_Start(&reader_tmr, READER_CLK_RETRY_MS, 0, reader_due, NULL);
+    return;
+  }
+  if (reader_cfg.diag) {
+    reader_cfg.diag = 0;
+    diag_report();
+  }
 
-  if (!pn532_wakeup()) {
-    ble_print("PN532 WAKE FAIL\r\n");
-  } else {
-    uint8_t fw[8]; uint8_t fwlen = sizeof(fw);
-    if (pn532_get_firmware(fw, &fwlen)) {
-      ble_print("PN532 FW: ");
-      ble_print_hex(fw, fwlen);   
-    } else {
-      ble_print("PN532 FW ERR\r\n");
+  uint8_t uid[10] = {0};
+  uint32_t t0 = HAL_GetTick();
+  uint32_t t0_us = TMR_Micros();
+  PROF_START(pt);
+  uint8_t ulen = pn532_read_uid((uint8_t)reader_cfg.brty, uid, sizeof(uid));
+  PROF_STOP(PROF_POLL, pt);
+  TRACE_Event(TRACE_EV_POLL, ulen);
+  MET_Inc(MET_POLLS);
+  MET_Observe(MET_H_POLL_MS, HAL_GetTick() - t0);
+
+  if (ulen > 0) {
+    MET_Inc(MET_HITS);
+    if (ulen != ret_state.last_len || memcmp(uid, last_uid, ulen) != 0) {
+      emit_uid(uid, ulen, t0_us, pn532_ready_us);
+      MET_Observe(MET_H_UID_MS, HAL_GetTick() - t0);
+      memcpy(last_uid, uid, ulen);
+      ret_state.last_len = ulen;
     }
+    TMR_Start(&reader_tmr, reader_cfg.quiet_ms, 0, reader_due, NULL);
+  } else {
+    ret_state.last_len = 0;
+    TMR_Start(&reader_tmr, reader_cfg.idle_ms, 0, reader_due, NULL);
+  }
+  RET_Commit();
+}
 
-    if (pn532_sam_config())
-      ble_print("SAM OK\r\n");
-    else
-      ble_print("SAM ERR\r\n");
+/* Line-by-line dumps to the diagnostics sink. One line per attempt, so the
+   BLE sink keeps its headroom; a line that does not fit is tried again a
+   little later. */
+#define DUMP_RETRY_MS  20u
+#define DUMP_TRIES     50u
+
+typedef struct {
+  uint16_t (*line)(uint8_t i, char *buf, uint16_t size);   /* 0 = skip line i */
+  void     (*done)(void);
+  Tmr_t    tmr;
+  uint8_t  n;
+  uint8_t  next;
+  uint8_t  tries;
+  bool     busy;
+} Dump_t;
+
+static void dump_task(void *arg);
+static void dump_due(void *arg) { (void)SCHED_Post(dump_task, arg, SCHED_PRIO_LOW); }
+
+static void dump_task(void *arg)
+{
+  Dump_t *d = (Dump_t *)arg;
+  char line[DBG_LINE_MAX];
+
+  for (; d->next < d->n; ++d->next) {
+    uint16_t n = d->line(d->next, line, sizeof(line));
+    if (n == 0) continue;
+    if (DBG_Write(line, n) == n) { d->tries = 0; continue; }
+    if (DBG_GetSink() == DBG_SINK_NONE || ++d->tries >= DUMP_TRIES) break;
+    TMR_Start(&d->tmr, DUMP_RETRY_MS, 0, dump_due, d);
+    return;
   }
+  d->busy = false;
+  d->done();
+}
 
-  uint8_t last_uid[10] = {0};
-  uint8_t last_len = 0;
-  uint32_t quiet_ms_after_hit = 800;
+static void dump_start(Dump_t *d, uint8_t n)
+{
+  d->n     = n;
+  d->next  = 0;
+  d->tries = 0;
+  d->busy  = SCHED_Post(dump_task, d, SCHED_PRIO_LOW);
+  if (!d->busy) d->done();
+}
 
-  for (;;)
-  {
-    uint8_t uid[10] = {0};
-    uint8_t ulen = pn532_read_uid_iso14443a(uid, sizeof(uid));
-
-    if (ulen > 0) {
-      if (ulen != last_len || memcmp(uid, last_uid, ulen) != 0) {
-        ble_print("UID:");
-        ble_print_hex(uid, ulen);
-        memcpy(last_uid, uid, ulen);
-        last_len = ulen;
-      }
-      HAL_Delay(quiet_ms_after_hit); 
-    } else {
-      last_len = 0;
-      HAL_Delay(300);
+/* "SET prof 1" dumps the scope timings, "SET prof 2" also clears them */
+static void prof_dump_done(void)
+{
+  if (reader_cfg.prof == 2u) PROF_Reset();
+  reader_cfg.prof = 0;
+}
+
+static Dump_t prof_dump = { .line = PROF_Line, .done = prof_dump_done };
+
+/* "SET i2c 1", or I2CT_STREAK PN532 faults in a row, dumps the I2C trace;
+   the ring stays frozen until the dump is out */
+static void i2c_dump_done(void)
+{
+  I2CT_Resume();
+  reader_cfg.i2c = 0;
+}
+
+static Dump_t i2c_dump = { .line = I2CT_Line, .done = i2c_dump_done };
+
+static void i2c_dump_start(void)
+{
+  if (!i2c_dump.busy) dump_start(&i2c_dump, I2CT_Freeze());
+}
+
+/* A command line arrived (called from the USART2 interrupt) */
+static void cmd_task(void *arg)
+{
+  bool ran = false;
+  (void)arg;
+  while (BLE_CMD_Poll()) ran = true;
+  if (!ran) return;
+  apply_config();
+  if (reader_cfg.prof && !prof_dump.busy) dump_start(&prof_dump, PROF_N);
+  if (reader_cfg.i2c) i2c_dump_start();
+}
+
+void BLE_CMD_ReadyCallback(void)
+{
+  (void)SCHED_Post(cmd_task, NULL, SCHED_PRIO_HIGH);
+}
+
+/* MSI drift tracking; only measurable while SYSCLK is the MSI. A
+   measurement per run so nothing else waits on the whole trim. */
+static void msi_cal_task(void *arg)
+{
+  (void)arg;
+  (void)CLK_Set(CLK_IDLE);
+  if (!MSICAL_Step()) (void)SCHED_Post(msi_cal_task, NULL, SCHED_PRIO_LOW);
+}
+
+/* Stack high-water scan, a slice per run so nothing else waits on it */
+#define MEM_SCAN_MS     1000u
+#define MEM_SCAN_WORDS  64u
+
+static void mem_task(void *arg)
+{
+  (void)arg;
+  if (!MEM_Scan(MEM_SCAN_WORDS)) (void)SCHED_Post(mem_task, NULL, SCHED_PRIO_LOW);
+}
+
+/* Nothing queued, no timer due: drop the clock before the core sleeps */
+static void enter_idle(void)
+{
+  (void)CLK_Set(CLK_IDLE);
+}
+
+/* ---------------- Main ---------------- */
+
+int main(void)
+{
+  MEM_Paint();
+  bool warm = RET_Boot();
+  HAL_Init();
+  SystemClock_Config();
+  MX_GPIO_Init();
+  MX_DMA_Init();
+  MX_I2C1_Init();
+  MX_USART2_UART_Init();
+  TRACE_Init();
+  CLK_Init();
+  NRG_Init();
+  MSICAL_Init();
+  PROF_Init();
+
+  /* Warm restart with the PN532 set up and healthy before it: the chip
+     did not reset with us, so only abort a command it may still be on.
+     Otherwise the first PN532 frame doubles as its wake-up; send it now
+     and let the chip come up while the BLE link is negotiated. With the
+     firmware identity known from an earlier boot, that frame is
+     SAMConfiguration itself and GetFirmwareVersion is skipped. */
+  bool resumed = warm && ret_state.pn532_ready && pn532_abort();
+  uint32_t fw = fw_load();
+  const uint8_t *first = fw ? k_cmd_sam : k_cmd_getfw;
+  uint8_t first_len = fw ? sizeof(k_cmd_sam) : sizeof(k_cmd_getfw);
+  bool sent = !resumed && pn532_send(first, first_len);
+
+  (void)BLE_Begin();
+  BLE_CMD_Start();
+  DBG_Init();
+
+  bool ok = resumed;
+  if (!resumed) {
+    if (!sent) sent = pn532_send(first, first_len);    /* was still asleep */
+    ok = sent && pn532_wait_ack();
+    if (ok && !fw) {
+      ok = pn532_firmware_resp(&fw);
+      if (ok) fw_store(fw);
+      ok = ok && pn532_sam_config();
+    } else if (ok) {
+      ok = pn532_sam_resp();
     }
+    if (!ok) ok = pn532_sam_config();                   /* one plain retry */
   }
+  uint8_t fault = ret_state.fault;      /* reported once, below */
+  ret_state.fault = RET_FAULT_NONE;
+  ret_state.pn532_ready = ok;
+  RET_Commit();
+
+  boot_ms = HAL_GetTick();
+  if (warm) DBG_Printf("RESTART %u rst=%02X fault=%u\r\n", ret_state.warm_boots,
+                       ret_state.reset_flags, fault);
+  if (ok) DBG_Printf("READY %lu ms%s\r\n", (unsigned long)boot_ms, resumed ? " (resumed)" : "");
+  else    DBG_Printf("PN532 ERR %lu ms\r\n", (unsigned long)boot_ms);
+#if BOOT_DIAG
+  reader_cfg.diag = 1;
+#endif
+  /* First calibration once the LSE has had time to start */
+  TMR_Start(&msi_cal_tmr, 2000u, MSICAL_PERIOD_MS, msi_cal_due, NULL);
+  TMR_Start(&mem_tmr, MEM_SCAN_MS, MEM_SCAN_MS, mem_due, NULL);
+  (void)SCHED_Post(reader_task, NULL, SCHED_PRIO_NORMAL);
+
+  SCHED_Run(enter_idle);
 }
 
 void SystemClock_Config(void)
@@ -247,5 +700,6 @@ void SystemClock_Config(void)
 void Error_Handler(void)
 {
   __disable_irq();
-  while (1) { }
+  RET_Fault(RET_FAULT_ERROR);
+  NVIC_SystemReset();
 }
\ No newline at end of file
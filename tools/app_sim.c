@@ -0,0 +1,534 @@
+/* Whole-application simulation on virtual time.
+
+   Builds the top-level main.c with the scheduler, timers, BLE link,
+   command channel and the rest of the portable Core modules, unmodified,
+   against tools/host: the PN532 is the emulator of tools/host/pn532_emu.h
+   on I2C, the BLE module is modelled here behind USART2, and time is the
+   shim's virtual clock, so a ten-minute scenario runs in well under a
+   second and gives the same numbers every time. Clock switching, MSI
+   calibration, the stack monitor and SWO are the stand-ins of
+   tools/host/app_host.c; the tickless SysTick is modelled below.
+
+   BLE module model: answers the AT subset (AT, AT+BAUD<n>, AT+RESET)
+   while no central is connected; while one is, bytes at the module's rate
+   go out in notifications at the next connection event, and while the link
+   is down they are lost. Bytes sent at a different rate than the module's
+   are garbage and dropped.
+
+   Scenario file, times in ms:
+     card <from> <to> <uid>            PN532 lines, see pn532_emu_line():
+     nack|corrupt|sleep|timing ...     card windows, bus faults, chip delays
+     cards <n> <first> <every> <dwell> <uid>   n windows of one card
+     run <ms>                          length of the run (default 60000)
+     khz <100|400>                     I2C clock in CLK_BURST (default 400)
+     set <key> <value>                 reader_cfg before boot: quiet, idle,
+                                       proto, fmt, mtu, hold, dbg
+     ble connect <ms>                  central connects (default 2000)
+     ble down <from> <to>              link lost for a while
+     ble interval <ms>                 connection interval (default 15)
+     ble baud <n>                      module rate at power-up (default 9600)
+     cmd <at> <line>                   command line from the central
+
+     fw <hex>                          PN532 firmware word already cached in
+                                       data EEPROM, as after an earlier boot
+
+   With --replay, the PN532 is a recorded bus transcript instead of the
+   emulator (tools/host/i2c_replay.h): main.c must make the recorded
+   transfers and report the recorded UIDs, and the host time it takes per
+   frame read is measured. The scenario is optional then; card lines in it
+   are ignored for the bus but still used for the latency figures. The run
+   ends a second after the transcript does, with exit status 1 if the
+   firmware went another way. --swo writes what the firmware sends on
+   TRACE_PORT_I2C as an SWO capture: a recording of the simulated run.
+
+   Report: per card window, detection latency (card in the field to its
+   UID line at the central), duplicates (more than one report for one stay
+   in the field), missed stays, UID lines lost on the link; bytes the
+   firmware sent; CPU duty (time not in TMR_Sleep, where the core would be
+   in WFI: blocking I2C and AT exchanges count as awake, code run time is
+   not modelled) and the energy model's average current.
+
+   Build: cc -O2 -Wall -Itools/host -Ible_status_test/Core/Inc -Dmain=app_main -o app_sim \
+             tools/app_sim.c main.c ble_status_test/Core/Src/{sched,tmr,ble_link,ble_cmd,dbg_out}.c \
+             ble_status_test/Core/Src/{metrics,latency,i2c_trace,energy,retain,prof}.c \
+             tools/host/pn532_emu.c tools/host/i2c_replay.c tools/host/app_host.c tools/host/hal_host.c
+   Run:   ./app_sim scenario.txt [-v]
+          ./app_sim scenario.txt --swo run.bin && ./swo_decode run.bin > recording.txt
+          ./app_sim [scenario.txt] --replay recording.txt [-v] */
+#undef main             /* -Dmain=app_main is for main.c */
+#include "main.h"
+#include "ble_link.h"
+#include "ble_cmd.h"
+#include "dbg_out.h"
+#include "tmr.h"
+#include "energy.h"
+#include "metrics.h"
+#include "pn532_emu.h"
+#include "i2c_replay.h"
+#include "app_host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static Pn532Emu_t    emu;
+static I2cReplay_t   replay;
+static bool          replaying;
+
+static uint64_t run_us = 60000000u;
+static int      verbose;
+
+/* ---------------- Sleep: tmr_tickless.c on the virtual clock ---------------- */
+
+static uint64_t slept_us;
+static void report(void);
+
+static void end_check(void)
+{
+  if (replaying && i2c_replay_over(&replay) && host_time_us() >= replay.end_us + 1000000u) {
+    report();
+    exit(i2c_replay_report(&replay, stdout));
+  }
+  if (host_time_us() < run_us) return;
+  report();
+  exit(replaying ? i2c_replay_report(&replay, stdout) : 0);
+}
+
+/* As TMR_Sleep() on the target: up to the next timer, or the next tick
+   while BLE bytes wait for their hold time; any event wakes early. The
+   SysTick interrupt at the end of a tick runs BLE_Tick(). */
+void TMR_Sleep(uint32_t max_ms)
+{
+  uint32_t n = TMR_NextDue(max_ms);
+  uint64_t t0, until, wake;
+
+  end_check();
+  if (replaying) i2c_replay_idle(&replay);
+  if (n == 0) return;
+  if (BLE_TxFree() != BLE_TX_SIZE) n = 1;
+
+  __disable_irq();
+  if (TMR_WakePending()) {
+    __enable_irq();
+    return;
+  }
+  NRG_Sleep(true);
+  t0    = host_time_us();
+  until = ((uint64_t)HAL_GetTick() + n) * 1000u;
+  if (until > run_us) until = run_us;
+  wake  = host_next_at() < until ? host_next_at() : until;
+  (void)host_time_sleep(wake);         /* masked: the event runs below */
+  slept_us += host_time_us() - t0;
+  NRG_Sleep(false);
+  __enable_irq();
+  if (wake == until) BLE_Tick();
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+  uint32_t t0   = HAL_GetTick();
+  uint32_t wait = Delay + 1u;
+
+  for (uint32_t spent; (spent = HAL_GetTick() - t0) < wait; ) {
+    uint64_t before = host_time_us();
+    TMR_Sleep(wait - spent);
+    if (host_time_us() == before) {                 /* a timer is due: spin to the tick */
+      (void)host_time_sleep((before / 1000u + 1u) * 1000u);
+      BLE_Tick();
+    }
+  }
+}
+
+uint32_t TMR_Micros(void)
+{
+  return (uint32_t)host_time_us();
+}
+
+uint32_t TMR_SleepMs(void)
+{
+  return (uint32_t)(slept_us / 1000u);
+}
+
+uint16_t TMR_DutyPermille(void)
+{
+  uint64_t up = host_time_us();
+  return up ? (uint16_t)((up - slept_us) * 1000u / up) : 1000u;
+}
+
+/* ---------------- Central: what arrives, and when ---------------- */
+
+typedef struct {
+  uint32_t uids, others;                  /* UID events, other lines */
+  char     line[160];
+  uint16_t len;
+  uint8_t  bin[12], bin_len, bin_need;    /* BLE_FMT_BINARY frame */
+} Decoder_t;
+
+static Decoder_t rx_dec, lost_dec;
+
+typedef struct {
+  uint32_t reports;
+  uint64_t first_us;
+} Stay_t;
+
+static Stay_t   stays[PN532_EMU_CARDS];
+static uint32_t strays, dups, lost_uids;
+static uint64_t bytes_tx, bytes_lost, bytes_garbled, notifies;
+
+/* A UID arrived at the central at t: match it to a stay in the field */
+static void on_uid(const uint8_t *uid, uint8_t len, uint64_t t)
+{
+  int best = -1;
+
+  for (int i = 0; i < emu.ncards; ++i) {
+    const Pn532Card_t *c = &emu.cards[i];
+    if (c->len != len || memcmp(c->uid, uid, len) || c->from_us > t) continue;
+    if (best < 0 || c->from_us > emu.cards[best].from_us) best = i;
+  }
+  if (best < 0) { strays++; return; }
+  if (stays[best].reports++ == 0) stays[best].first_us = t;
+  else dups++;
+}
+
+static int hexval(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+static void decode(Decoder_t *d, uint8_t b, uint64_t t, bool live)
+{
+  if (d->bin_need) {
+    d->bin[d->bin_len++] = b;
+    if (d->bin_len == 2) d->bin_need = (uint8_t)(d->bin[1] + 3u);
+    if (d->bin_len < d->bin_need && d->bin_len < sizeof(d->bin)) return;
+    uint8_t sum = 0;
+    for (uint8_t i = 1; i < d->bin_len; ++i) sum += d->bin[i];
+    if (sum == 0 && d->bin[1] <= 10) {
+      d->uids++;
+      if (replaying) i2c_replay_uid(&replay, &d->bin[2], d->bin[1]);
+      if (live) on_uid(&d->bin[2], d->bin[1], t);
+    }
+    d->bin_need = 0;
+    return;
+  }
+  if (d->len == 0 && b == 0xA5) {
+    d->bin[0]   = b;
+    d->bin_len  = 1;
+    d->bin_need = 2;
+    return;
+  }
+  if (b == '\r') return;
+  if (b != '\n') {
+    if (d->len + 1u < sizeof(d->line)) d->line[d->len++] = (char)b;
+    return;
+  }
+  d->line[d->len] = 0;
+  if (!strncmp(d->line, "UID:", 4)) {
+    uint8_t uid[10], n = 0;
+    for (const char *p = d->line + 4; hexval(p[0]) >= 0 && hexval(p[1]) >= 0 && n < 10; p += 2)
+      uid[n++] = (uint8_t)(hexval(p[0]) << 4 | hexval(p[1]));
+    d->uids++;
+    if (replaying) i2c_replay_uid(&replay, uid, n);
+    if (live && n) on_uid(uid, n, t);
+  } else {
+    d->others++;
+    if (live && verbose) printf("%10.3f  %s\n", (double)t / 1000.0, d->line);
+  }
+  d->len = 0;
+}
+
+/* ---------------- BLE module ---------------- */
+
+#define MOD_NOTIFY_BYTES  20u          /* ATT payload at the default MTU */
+
+static uint32_t mod_baud = 9600, mod_pending;
+static uint64_t conn_us  = 2000000u;
+static uint64_t interval_us = 15000u;
+static bool     connected;
+static char     at_reply[24];
+
+static uint32_t rate_of(char code)
+{
+  static const uint32_t k[] = { 9600, 19200, 38400, 57600, 115200 };
+  return (code >= '0' && code <= '4') ? k[code - '0'] : 0;
+}
+
+static void at_reply_due(void *arg)
+{
+  (void)arg;
+  host_uart_rx(&huart2, (const uint8_t *)at_reply, (uint16_t)strlen(at_reply));
+  if (!strcmp(at_reply, "OK+RESET") && mod_pending) {
+    mod_baud    = mod_pending;
+    mod_pending = 0;
+  }
+}
+
+static void module_rx(void *ctx, const uint8_t *data, uint16_t len, uint32_t baud)
+{
+  uint64_t t0 = host_time_us(), per = 10000000u / baud;
+  (void)ctx;
+
+  if (replaying) i2c_replay_idle(&replay);        /* done with the frame: output starts */
+  bytes_tx += len;
+  if (baud != mod_baud) { bytes_garbled += len; return; }
+  if (!connected) {
+    char cmd[16];
+    if (len < 2 || len >= sizeof(cmd) || memcmp(data, "AT", 2)) {
+      bytes_lost += len;
+      for (uint16_t i = 0; i < len; ++i) decode(&lost_dec, data[i], t0, false);
+      return;
+    }
+    memcpy(cmd, data, len);
+    cmd[len] = 0;
+    if (!strcmp(cmd, "AT")) snprintf(at_reply, sizeof(at_reply), "OK");
+    else if (!strcmp(cmd, "AT+RESET")) snprintf(at_reply, sizeof(at_reply), "OK+RESET");
+    else if (!strncmp(cmd, "AT+BAUD", 7) && len == 8 && rate_of(cmd[7])) {
+      mod_pending = rate_of(cmd[7]);
+      snprintf(at_reply, sizeof(at_reply), "OK+Set:%c", cmd[7]);
+    } else return;
+    host_at(t0 + per * len + 2000u, at_reply_due, NULL);      /* module answers in ~2 ms */
+    return;
+  }
+  for (uint16_t i = 0; i < len; ++i) {
+    static uint64_t last_out;
+    static uint32_t in_event;               /* bytes already in this connection event */
+    uint64_t at  = t0 + per * (i + 1u);
+    uint64_t out = (at + interval_us - 1u) / interval_us * interval_us;
+
+    if (out != last_out) { in_event = 0; last_out = out; }
+    if (in_event++ % MOD_NOTIFY_BYTES == 0) notifies++;
+    decode(&rx_dec, data[i], out, true);
+  }
+}
+
+/* ---------------- Scenario ---------------- */
+
+enum { EV_UP, EV_DOWN, EV_CMD };
+
+typedef struct {
+  uint64_t at;
+  uint8_t  kind;
+  char     text[48];
+} SimEvent_t;
+
+#define SIM_EVENTS 256
+static SimEvent_t events[SIM_EVENTS];
+static int        n_events, next_event;
+
+static bool add_event(uint64_t at, uint8_t kind, const char *text)
+{
+  int i = n_events;
+  if (n_events == SIM_EVENTS) return false;
+  while (i > 0 && events[i - 1].at > at) { events[i] = events[i - 1]; i--; }
+  events[i].at   = at;
+  events[i].kind = kind;
+  snprintf(events[i].text, sizeof(events[i].text), "%s", text ? text : "");
+  n_events++;
+  return true;
+}
+
+static void cmd_rx(void *arg)
+{
+  const char *s = arg;
+  host_uart_rx(&huart2, (const uint8_t *)s, (uint16_t)strlen(s));
+}
+
+static void sim_event(void *arg)
+{
+  SimEvent_t *e = &events[next_event++];
+  (void)arg;
+
+  if (e->kind == EV_UP) connected = true;
+  else if (e->kind == EV_DOWN) connected = false;
+  else if (connected && huart2.Init.BaudRate == mod_baud) {
+    size_t n = strlen(e->text);
+    if (n + 1 < sizeof(e->text)) { e->text[n] = '\n'; e->text[n + 1] = 0; }
+    host_at(e->at + (uint64_t)(n + 1) * 10000000u / mod_baud, cmd_rx, e->text);
+  }
+  if (next_event < n_events) host_at(events[next_event].at, sim_event, NULL);
+}
+
+static bool set_cfg(const char *key, uint32_t v)
+{
+  static const struct { const char *name; uint32_t *val; } k[] = {
+    { "quiet", &reader_cfg.quiet_ms }, { "idle", &reader_cfg.idle_ms },
+    { "proto", &reader_cfg.brty },     { "fmt",  &reader_cfg.fmt },
+    { "mtu",   &reader_cfg.mtu },      { "hold", &reader_cfg.hold_ms },
+    { "dbg",   &reader_cfg.dbg },
+  };
+  for (size_t i = 0; i < sizeof(k) / sizeof(k[0]); ++i)
+    if (!strcmp(key, k[i].name)) { *k[i].val = v; return true; }
+  return false;
+}
+
+/* main.c's PN532_FW_EEPROM_ADDR: word, then its complement */
+static bool fw_cache(uint32_t fw)
+{
+  uint32_t a = (uint32_t)FLASH_EEPROM_BASE + 0x08u;
+  return HAL_FLASHEx_DATAEEPROM_Program(FLASH_TYPEPROGRAMDATA_WORD, a, fw) == HAL_OK &&
+         HAL_FLASHEx_DATAEEPROM_Program(FLASH_TYPEPROGRAMDATA_WORD, a + 4u, ~fw) == HAL_OK;
+}
+
+static int sim_line(const char *line)
+{
+  char w1[16], w2[16], uid[32];
+  double a, b, c, d;
+  unsigned n;
+  int off = 0;
+
+  if (sscanf(line, "%15s %n", w1, &off) != 1) return 0;
+  line += off;
+  if (!strcmp(w1, "run"))  return sscanf(line, "%lf", &a) == 1 && (run_us = (uint64_t)(a * 1000.0), 1);
+  if (!strcmp(w1, "khz"))  return sscanf(line, "%u", &host_app_khz) == 1 && (host_app_khz == 100 || host_app_khz == 400);
+  if (!strcmp(w1, "set"))  return sscanf(line, "%15s %u", w2, &n) == 2 && set_cfg(w2, n);
+  if (!strcmp(w1, "fw"))   return sscanf(line, "%x", &n) == 1 && fw_cache(n);
+  if (!strcmp(w1, "cards")) {
+    char card[64];
+    if (sscanf(line, "%u %lf %lf %lf %31s", &n, &a, &b, &c, uid) != 5) return 0;
+    for (unsigned i = 0; i < n; ++i) {
+      snprintf(card, sizeof(card), "card %.3f %.3f %s", a + b * i, a + b * i + c, uid);
+      if (pn532_emu_line(&emu, card) != 1) return 0;
+    }
+    return 1;
+  }
+  if (!strcmp(w1, "cmd")) {
+    if (sscanf(line, "%lf %n", &a, &off) != 1) return 0;
+    line += off;
+    char text[48];
+    snprintf(text, sizeof(text), "%s", line);
+    text[strcspn(text, "\r\n")] = 0;
+    return add_event((uint64_t)(a * 1000.0), EV_CMD, text);
+  }
+  if (!strcmp(w1, "ble") && sscanf(line, "%15s %n", w2, &off) == 1) {
+    line += off;
+    if (!strcmp(w2, "connect"))  return sscanf(line, "%lf", &a) == 1 && (conn_us = (uint64_t)(a * 1000.0), 1);
+    if (!strcmp(w2, "interval")) return sscanf(line, "%lf", &a) == 1 && a > 0 && (interval_us = (uint64_t)(a * 1000.0), 1);
+    if (!strcmp(w2, "baud"))     return sscanf(line, "%u", &mod_baud) == 1;
+    if (!strcmp(w2, "down") && sscanf(line, "%lf %lf", &c, &d) == 2)
+      return add_event((uint64_t)(c * 1000.0), EV_DOWN, NULL) && add_event((uint64_t)(d * 1000.0), EV_UP, NULL);
+  }
+  return 0;
+}
+
+static int load(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  char line[160];
+  int no = 0;
+
+  if (!f) { perror(path); return -1; }
+  while (fgets(line, sizeof(line), f)) {
+    int r = pn532_emu_line(&emu, line);
+    no++;
+    if (r == 0) r = sim_line(line) ? 1 : -1;
+    if (r < 0) {
+      fprintf(stderr, "%s:%d: bad line: %s", path, no, line);
+      fclose(f);
+      return -1;
+    }
+  }
+  fclose(f);
+  return 0;
+}
+
+/* ---------------- Report ---------------- */
+
+static int cmp_u64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void report(void)
+{
+  static uint64_t lat[PN532_EMU_CARDS];
+  uint32_t n = 0, missed = 0;
+  uint64_t sum = 0;
+  double secs = (double)host_time_us() / 1e6;
+
+  for (int i = 0; i < emu.ncards; ++i) {
+    const Pn532Card_t *c = &emu.cards[i];
+    if (c->from_us >= host_time_us()) continue;
+    if (stays[i].reports) {
+      lat[n] = stays[i].first_us - c->from_us;
+      sum += lat[n++];
+    } else {
+      missed++;
+    }
+    if (verbose) {
+      printf("stay %3d  %10.3f .. %-10.3f  reports %u", i, (double)c->from_us / 1000.0,
+             c->to_us == UINT64_MAX ? -1.0 : (double)c->to_us / 1000.0, stays[i].reports);
+      if (stays[i].reports) printf("  latency %.1f ms", (double)(stays[i].first_us - c->from_us) / 1000.0);
+      printf("\n");
+    }
+  }
+  qsort(lat, n, sizeof(lat[0]), cmp_u64);
+  lost_uids = lost_dec.uids;
+
+  printf("run %.1f s, I2C %u kHz, quiet %lu ms, idle %lu ms, BLE %lu baud, interval %.1f ms\n", secs, host_app_khz,
+         (unsigned long)reader_cfg.quiet_ms, (unsigned long)reader_cfg.idle_ms, (unsigned long)BLE_GetBaud(),
+         (double)interval_us / 1000.0);
+  printf("stays: %u reported, %u missed; duplicates %u, strays %u, UID lines lost on the link %u\n",
+         n, missed, dups, strays, lost_uids);
+  if (n)
+    printf("detection latency ms: min %.1f  avg %.1f  p50 %.1f  p95 %.1f  max %.1f\n", lat[0] / 1000.0,
+           (double)sum / n / 1000.0, lat[n / 2] / 1000.0, lat[(n * 95u) / 100u] / 1000.0, lat[n - 1] / 1000.0);
+  printf("bytes sent %llu (%u UID events, %u other lines), %llu notifications, lost %llu, garbled %llu\n",
+         (unsigned long long)bytes_tx, rx_dec.uids, rx_dec.others, (unsigned long long)notifies,
+         (unsigned long long)bytes_lost, (unsigned long long)bytes_garbled);
+  printf("CPU awake %.2f%% (%.1f ms), charge %lu nAh = %.1f uA average\n",
+         100.0 * (double)(host_time_us() - slept_us) / (double)host_time_us(),
+         (double)(host_time_us() - slept_us) / 1000.0, (unsigned long)NRG_ChargeNAh(),
+         secs > 0 ? (double)NRG_ChargeNAh() * 3.6 / secs : 0.0);
+  printf("firmware: polls %lu, uids %lu, dropped %lu, ble full %lu, i2c err %lu, ack fail %lu, "
+         "frame err %lu, ready timeout %lu\n", (unsigned long)met_count[MET_POLLS],
+         (unsigned long)met_count[MET_UIDS], (unsigned long)met_count[MET_UID_DROPPED],
+         (unsigned long)met_count[MET_BLE_FULL], (unsigned long)met_count[MET_I2C_ERR],
+         (unsigned long)met_count[MET_ACK_FAIL], (unsigned long)met_count[MET_FRAME_ERR],
+         (unsigned long)met_count[MET_READY_TIMEOUT]);
+  if (!replaying)
+    printf("PN532: %u cmds, %u lists, %u status polls (%u busy), %u NACKs, bus %.1f ms\n", emu.st.cmds,
+           emu.st.lists, emu.st.status_polls, emu.st.busy_polls, emu.st.nacks,
+           (double)host_i2c_busy_us() / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = NULL, *rec = NULL;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-v")) verbose = 1;
+    else if (!strcmp(argv[i], "--replay") && i + 1 < argc) rec = argv[++i];
+    else if (!strcmp(argv[i], "--swo") && i + 1 < argc) {
+      if (!(host_swo = fopen(argv[++i], "wb"))) { perror(argv[i]); return 1; }
+    }
+    else if (argv[i][0] != '-') path = argv[i];
+    else { fprintf(stderr, "usage: %s [scenario.txt] [--replay recording.txt] [--swo out.bin] [-v]\n", argv[0]); return 2; }
+  }
+  if (!path && !rec) { fprintf(stderr, "usage: %s [scenario.txt] [--replay recording.txt] [--swo out.bin] [-v]\n", argv[0]); return 2; }
+
+  host_time_virtual();
+  pn532_emu_init(&emu);
+  if (path && load(path) < 0) return 1;
+  if (rec && i2c_replay_load(&replay, rec) < 0) return 1;
+  if (!add_event(conn_us, EV_UP, NULL)) return 1;
+
+  if (rec) {
+    replaying = true;
+    i2c_replay_attach(&replay);
+  } else {
+    pn532_emu_attach(&emu);
+  }
+  huart2.Instance = &host_ble_port;
+  host_uart_peer(&huart2, module_rx, NULL);
+  host_at(events[0].at, sim_event, NULL);
+  if (!BLE_SetCoalesce((uint16_t)reader_cfg.mtu, (uint16_t)reader_cfg.hold_ms))
+    fprintf(stderr, "set mtu %lu refused (1..%u)\n", (unsigned long)reader_cfg.mtu, (unsigned)BLE_TX_HIWAT);
+  DBG_SetSink((uint8_t)reader_cfg.dbg);
+
+  return app_main();
+}
@@ -0,0 +1,219 @@
+/* BLE link throughput benchmark.
+
+   Runs the firmware's ble_link.c on the host (via tools/host) against a
+   module emulator on a pty, then streams UID events through the firmware's
+   output path and reports negotiation time, events/s and loss.
+   The data EEPROM is kept in a file so the second run shows the fast path.
+
+   Events are what main.c's ble_print_uid() writes: "UID:<hex>\r\n", or the
+   0xA5 frame with --binary, one BLE_Write per event. The UID counts up from
+   1 in its last four bytes, which the emulator reads back as a sequence
+   number. Like main.c, events wait in a --queue deep queue while the TX ring
+   is full, are retried every 2 ms, and are dropped when the queue is full
+   too. --rate offers events at that many per second (0 = as fast as the ring
+   takes them); --gap-ms spaces them out instead. SIGALRM at 1 kHz plays
+   SysTick (BLE_Tick) and the USART2 TX DMA (host_uart_poll), so transfers
+   run on while the loop sleeps. --rtscts turns on hardware flow control,
+   which the emulator needs too. --mtu/--hold set the output coalescing,
+   whose effect shows up as notifications per event in the emulator's burst
+   summary; so do the module's drops and the events lost on the air.
+
+   Build: cc -O2 -Wall -Itools/host -Ible_status_test/Core/Inc -o ble_bench \
+             tools/ble_bench.c ble_status_test/Core/Src/ble_link.c tools/host/hal_host.c
+   Run:   ./ble_emu --max-baud 57600 &      (prints /dev/pts/N)
+          ./ble_bench /dev/pts/N [--events 200] [--rate 0] [--gap-ms 0] [--mtu 20] [--hold 10]
+                      [--queue 4] [--uid-len 4] [--binary] [--rtscts] [--eeprom ble.eep] */
+#include "ble_link.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RETRY_MS   2u         /* main.c OUTPUT_RETRY_MS */
+#define QUEUE_MAX  64u
+
+UART_HandleTypeDef huart2;
+static USART_TypeDef ble_port;
+
+void Error_Handler(void)
+{
+  fprintf(stderr, "Error_Handler\n");
+  exit(1);
+}
+
+static void eeprom_io(const char *path, int save)
+{
+  FILE *f;
+  if (!path || !(f = fopen(path, save ? "wb" : "rb"))) return;
+  if (save) fwrite(host_eeprom, sizeof(host_eeprom), 1, f);
+  else if (fread(host_eeprom, sizeof(host_eeprom), 1, f) != 1) memset(host_eeprom, 0xFF, sizeof(host_eeprom));
+  fclose(f);
+}
+
+/* SysTick and the TX DMA */
+static void on_tick(int sig)
+{
+  (void)sig;
+  BLE_Tick();
+  host_uart_poll(&huart2);
+}
+
+/* main.c ble_print_uid(), less the latency marks */
+static uint16_t format_uid(uint8_t *out, const uint8_t *uid, uint8_t n, int binary)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  uint16_t w = 0;
+
+  if (binary) {
+    uint8_t sum = n;
+    out[w++] = 0xA5;
+    out[w++] = n;
+    for (uint8_t i = 0; i < n; ++i) { out[w++] = uid[i]; sum += uid[i]; }
+    out[w++] = (uint8_t)(~sum + 1);
+    return w;
+  }
+  memcpy(out, "UID:", 4);
+  w = 4;
+  for (uint8_t i = 0; i < n; ++i) {
+    out[w++] = (uint8_t)hex[uid[i] >> 4];
+    out[w++] = (uint8_t)hex[uid[i] & 0xF];
+  }
+  out[w++] = '\r';
+  out[w++] = '\n';
+  return w;
+}
+
+int main(int argc, char **argv)
+{
+  const char *dev = NULL, *eep = NULL;
+  unsigned events = 200, rate = 0, gap_ms = 0, mtu = BLE_NOTIFY_SIZE, hold = BLE_HOLD_MS;
+  unsigned queue = 4, uid_len = 4;
+  int binary = 0, rtscts = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--events") && i + 1 < argc)       events = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--rate") && i + 1 < argc)    rate = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--gap-ms") && i + 1 < argc)  gap_ms = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--mtu") && i + 1 < argc)     mtu = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--hold") && i + 1 < argc)    hold = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--queue") && i + 1 < argc)   queue = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--uid-len") && i + 1 < argc) uid_len = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--eeprom") && i + 1 < argc)  eep = argv[++i];
+    else if (!strcmp(argv[i], "--binary"))                  binary = 1;
+    else if (!strcmp(argv[i], "--rtscts"))                  rtscts = 1;
+    else if (!dev)                                           dev = argv[i];
+  }
+  if (!dev) {
+    fprintf(stderr, "usage: %s /dev/pts/N [--events N] [--rate N] [--gap-ms N] [--mtu N] [--hold N] [--queue N]\n"
+                    "          [--uid-len 4|7|10] [--binary] [--rtscts] [--eeprom file]\n", argv[0]);
+    return 2;
+  }
+  if (uid_len < 4) uid_len = 4;
+  if (uid_len > 10) uid_len = 10;
+  if (!queue) queue = 1;
+  if (queue > QUEUE_MAX) queue = QUEUE_MAX;
+
+  memset(host_eeprom, 0xFF, sizeof(host_eeprom));   /* erased EEPROM */
+  eeprom_io(eep, 0);
+
+  ble_port.fd = open(dev, O_RDWR | O_NOCTTY);
+  if (ble_port.fd < 0) { perror(dev); return 1; }
+
+  HAL_Init();
+  huart2.Instance = &ble_port;
+  huart2.Init.BaudRate = 9600;
+  huart2.Init.WordLength = UART_WORDLENGTH_8B;
+  huart2.Init.StopBits = UART_STOPBITS_1;
+  huart2.Init.Parity = UART_PARITY_NONE;
+  huart2.Init.Mode = UART_MODE_TX_RX;
+  huart2.Init.HwFlowCtl = rtscts ? UART_HWCONTROL_RTS_CTS : UART_HWCONTROL_NONE;
+  huart2.Init.OverSampling = UART_OVERSAMPLING_16;
+  if (HAL_UART_Init(&huart2) != HAL_OK) Error_Handler();
+
+  uint32_t t0 = HAL_GetTick();
+  uint32_t baud = BLE_Begin();
+  uint32_t t_neg = HAL_GetTick() - t0;
+
+  if (!BLE_SetCoalesce((uint16_t)mtu, (uint16_t)hold))
+    fprintf(stderr, "--mtu %u refused (1..%u), using %u\n", mtu, (unsigned)BLE_TX_HIWAT, (unsigned)BLE_NOTIFY_SIZE);
+  HAL_Delay(50);                       /* let the module close the last AT command */
+
+  /* From here on the ring drains in the background */
+  struct itimerval it = { { 0, 1000 }, { 0, 1000 } };
+  signal(SIGALRM, on_tick);
+  setitimer(ITIMER_REAL, &it, NULL);
+
+  static uint8_t q[QUEUE_MAX][2 + 2 * 10 + 2];
+  static uint16_t qlen[QUEUE_MAX];
+  unsigned q_head = 0, q_count = 0, offered = 0, sent = 0, dropped = 0, full = 0;
+  uint64_t t_us0 = 0;
+  uint32_t retry_at = 0;
+  int      waiting = 0;
+
+  t0 = HAL_GetTick();
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    t_us0 = (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+  }
+  while (sent + dropped < events) {
+    struct timespec ts;
+    uint64_t now;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u - t_us0;
+
+    /* The reader: the next event when it is due */
+    if (offered < events) {
+      uint64_t due = rate ? (uint64_t)offered * 1000000u / rate : (uint64_t)offered * gap_ms * 1000u;
+      int take = (rate || gap_ms) ? now >= due : q_count < queue;
+      if (take) {
+        uint8_t uid[10] = { 0x04, 0xA1, 0xB2, 0xC3, 0xD4, 0xE5 };
+        uint32_t seq = ++offered;
+        uid[uid_len - 4] = (uint8_t)(seq >> 24);
+        uid[uid_len - 3] = (uint8_t)(seq >> 16);
+        uid[uid_len - 2] = (uint8_t)(seq >> 8);
+        uid[uid_len - 1] = (uint8_t)seq;
+        if (q_count == queue) {
+          dropped++;                     /* MET_UID_DROPPED */
+        } else {
+          unsigned k = (q_head + q_count++) % queue;
+          qlen[k] = format_uid(q[k], uid, (uint8_t)uid_len, binary);
+          waiting = 0;                   /* emit_uid() runs the output task at once */
+        }
+      }
+    }
+
+    /* The output task */
+    if (q_count && (!waiting || (int32_t)(HAL_GetTick() - retry_at) >= 0)) {
+      while (q_count && BLE_Write(q[q_head], qlen[q_head])) {
+        q_head = (q_head + 1u) % queue;
+        q_count--;
+        sent++;
+      }
+      if (q_count) {
+        full++;                          /* MET_BLE_FULL */
+        waiting  = 1;
+        retry_at = HAL_GetTick() + RETRY_MS;
+      }
+    }
+    usleep(100);
+  }
+  BLE_Flush(5000);
+  uint32_t t_stream = HAL_GetTick() - t0;
+
+  it.it_value.tv_usec = it.it_interval.tv_usec = 0;
+  setitimer(ITIMER_REAL, &it, NULL);
+
+  eeprom_io(eep, 1);
+  printf("baud %u, negotiation %u ms, %u events in %u ms (%.1f ev/s)\n",
+         baud, t_neg, sent, t_stream, t_stream ? sent * 1000.0 / t_stream : 0.0);
+  printf("offered %u, dropped %u (queue of %u full), ring full %u times, CTS held %llu ms\n",
+         offered, dropped, queue, full, (unsigned long long)(ble_port.tx_held_us / 1000u));
+  return 0;
+}
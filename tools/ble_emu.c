@@ -0,0 +1,450 @@
+/* BLE UART module emulator on a pseudo-terminal.
+
+   Models the HM-10 style module behind USART2 closely enough to exercise
+   the firmware's link code on a PC:
+     - AT subset: AT, AT+BAUD<n>, AT+BAUD?, AT+RESET (commands end on an
+       idle gap, like the real module)
+     - the module's own baud rate; bytes sent while the pty is configured
+       for a different rate are corrupted, as on a real wire
+     - rates above --max-baud are accepted by AT+BAUD but corrupt about one
+       byte in sixteen, which is what a marginal divider error looks like
+   Anything that is not an AT command is notification payload. It goes into
+   the module's --buf byte buffer (0 = unlimited); bytes that find it full
+   are dropped, unless --rtscts, where the module deasserts CTS at
+   --buf - 2 * --mtu and asserts it again at half full. A pty has no modem
+   lines, so CTS travels as XOFF/XON (the host HAL stops on them, see
+   tools/host/stm32l1xx_hal.h).
+   Every --ci-ms (0 = continuously) a connection event sends up to --per-ci
+   notifications (0 = any number) of --mtu bytes from the buffer; a shorter
+   one only once the line has been idle for --gap-ms. Idle time is
+   measured from when the bytes would have finished arriving on a real
+   wire, not from when the pty delivered them.
+   What the notifications carry is decoded as the phone would: "UID:<hex>"
+   lines and 0xA5 binary frames. The last four UID bytes are read as a
+   sequence number (tools/ble_bench.c counts up from 1 in each burst), so
+   lost, out of order and garbled events can be told apart; events lost
+   after the last one delivered show only against the bench's count. Text
+   lines carry no check: when the module drops the middle of one, its head
+   and the next line's tail can make a UID that parses (and shows as a
+   jump), which the binary frame's checksum catches. An AT command
+   starts the count over, so line noise while the rate is negotiated does
+   not end up in it. A summary is printed after each burst.
+
+   Build: cc -O2 -Wall -o ble_emu tools/ble_emu.c
+   Run:   ./ble_emu [--baud 9600] [--max-baud 115200] [--mtu 20] [--gap-ms 5]
+                    [--buf 0] [--ci-ms 0] [--per-ci 0] [--rtscts] [-v]
+          (prints the slave path, e.g. /dev/pts/3, on stdout) */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BURST_GAP_MS  1000
+#define BUF_MAX       65536u
+
+static const struct { uint32_t baud; speed_t sp; char code; } k_rates[] = {
+  {   9600, B9600,   '0' },
+  {  19200, B19200,  '1' },
+  {  38400, B38400,  '2' },
+  {  57600, B57600,  '3' },
+  { 115200, B115200, '4' },
+};
+#define N_RATES (sizeof(k_rates) / sizeof(k_rates[0]))
+
+static int      master_fd, slave_fd;
+static uint32_t mod_baud = 9600, pending_baud, max_baud = 115200;
+static uint32_t mtu = 20, gap_ms = 5;
+static uint32_t buf_size, ci_ms, per_ci;
+static int      rtscts, verbose;
+
+static uint64_t now_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static char code_of(uint32_t baud)
+{
+  for (size_t i = 0; i < N_RATES; ++i)
+    if (k_rates[i].baud == baud) return k_rates[i].code;
+  return '?';
+}
+
+/* Is the host side of the wire at our rate? */
+static int wire_ok(void)
+{
+  struct termios t;
+  speed_t want = B0;
+
+  for (size_t i = 0; i < N_RATES; ++i)
+    if (k_rates[i].baud == mod_baud) want = k_rates[i].sp;
+  if (tcgetattr(slave_fd, &t) != 0) return 0;
+  return cfgetospeed(&t) == want;
+}
+
+/* Corrupt bytes crossing the wire: all of them on a rate mismatch, a
+   pseudo-random sixteenth of them on a rate we cannot hold. Returns count. */
+static size_t garble(uint8_t *p, size_t n)
+{
+  static uint32_t lfsr = 0xACE1u;
+  size_t bad = 0;
+  int    ok  = wire_ok();
+
+  if (ok && mod_baud <= max_baud) return 0;
+  for (size_t i = 0; i < n; ++i) {
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+    if (!ok || (lfsr & 15u) == 0) { p[i] ^= 0x5A; bad++; }
+  }
+  return bad;
+}
+
+static void reply(const char *s)
+{
+  uint8_t buf[32];
+  size_t n = strlen(s);
+
+  if (n > sizeof(buf)) n = sizeof(buf);
+  memcpy(buf, s, n);
+  size_t bad = garble(buf, n);
+  if (write(master_fd, buf, n) < 0) perror("write");
+  if (verbose) fprintf(stderr, "emu: -> %s%s\n", s, bad ? " (corrupted)" : "");
+}
+
+static void at_command(const char *c)
+{
+  if (verbose) fprintf(stderr, "emu: <- %s\n", c);
+
+  if (strcmp(c, "AT") == 0) {
+    reply("OK");
+  } else if (strcmp(c, "AT+BAUD?") == 0) {
+    char r[16];
+    snprintf(r, sizeof(r), "OK+Get:%c", code_of(mod_baud));
+    reply(r);
+  } else if (strncmp(c, "AT+BAUD", 7) == 0 && c[7] && !c[8]) {
+    for (size_t i = 0; i < N_RATES; ++i) {
+      if (k_rates[i].code != c[7]) continue;
+      char r[16];
+      snprintf(r, sizeof(r), "OK+Set:%c", c[7]);
+      reply(r);
+      pending_baud = k_rates[i].baud;
+    }
+  } else if (strcmp(c, "AT+RESET") == 0) {
+    reply("OK+RESET");
+    tcdrain(master_fd);
+    if (pending_baud) mod_baud = pending_baud;
+    pending_baud = 0;
+    if (verbose) fprintf(stderr, "emu: reset, now %u baud\n", mod_baud);
+  }
+}
+
+/* ---------------- Module buffer and flow control ---------------- */
+
+static uint8_t  mbuf[BUF_MAX];
+static uint32_t m_head, m_count;
+static int      cts_off;                 /* we sent XOFF */
+
+/* One burst's numbers */
+static struct {
+  uint64_t t0, bytes, bad, pkts, dropped, cis, full_cis;
+  uint64_t held_us, held_since;
+  uint32_t peak;
+} bs;
+
+static uint32_t buf_cap(void) { return buf_size ? buf_size : BUF_MAX; }
+
+static void set_cts(int off)
+{
+  uint8_t c = off ? 0x13 : 0x11;         /* XOFF / XON */
+
+  if (!rtscts || off == cts_off) return;
+  cts_off = off;
+  if (write(master_fd, &c, 1) < 0) perror("write");
+  if (off) bs.held_since = now_us();
+  else if (bs.held_since) {
+    bs.held_us += now_us() - bs.held_since;
+    bs.held_since = 0;
+  }
+  if (verbose) fprintf(stderr, "emu: CTS %s at %u bytes\n", off ? "off" : "on", m_count);
+}
+
+static void flow_check(void)
+{
+  uint32_t hi = buf_cap() > 4u * mtu ? buf_cap() - 2u * mtu : buf_cap() / 2u;
+
+  if (m_count >= hi) set_cts(1);
+  else if (m_count <= buf_cap() / 2u) set_cts(0);
+}
+
+static void buf_put(const uint8_t *p, size_t n)
+{
+  if (!bs.t0 && n) bs.t0 = now_us();
+  for (size_t i = 0; i < n; ++i) {
+    if (m_count == buf_cap()) {
+      bs.dropped++;
+      continue;
+    }
+    mbuf[(m_head + m_count++) % BUF_MAX] = p[i];
+  }
+  if (m_count > bs.peak) bs.peak = m_count;
+  flow_check();
+}
+
+/* ---------------- Events ---------------- */
+
+/* "UID:" lines and A5 LEN UID.. CS frames (LEN + UID + CS sums to 0), as
+   the firmware sends them and as the phone receives them */
+typedef struct {
+  uint8_t  b[64];
+  uint32_t n;
+  int      bin;                          /* in a 0xA5 frame */
+  uint64_t ok, lost, ooo, garbled;
+  uint32_t first, last;
+  int      any;
+} Dec_t;
+
+static Dec_t d_in, d_air;                /* from the UART, over the air */
+
+static void got_uid(Dec_t *d, const uint8_t *uid, uint32_t n)
+{
+  uint32_t seq = 0;
+
+  for (uint32_t i = n > 4u ? n - 4u : 0; i < n; ++i) seq = (seq << 8) | uid[i];
+  d->ok++;
+  if (!d->any) {                         /* the bench starts at 1 */
+    d->any   = 1;
+    d->first = d->last = seq;
+    d->lost  = seq ? seq - 1u : 0;
+    return;
+  }
+  if (seq == d->last + 1u) d->last = seq;
+  else if ((int32_t)(seq - d->last) > 0) {
+    d->lost += seq - d->last - 1u;
+    d->last  = seq;
+  } else {
+    d->ooo++;
+  }
+}
+
+static int hexval(uint8_t c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static void text_line(Dec_t *d)
+{
+  uint8_t uid[10];
+  uint32_t n = d->n;
+
+  while (n && (d->b[n - 1] == '\r' || d->b[n - 1] == '\n')) n--;
+  if (n < 4 || memcmp(d->b, "UID:", 4) != 0) return;      /* not an event */
+  if ((n - 4u) % 2u || n - 4u < 2u || n - 4u > 20u) {
+    d->garbled++;
+    return;
+  }
+  for (uint32_t i = 0; i < (n - 4u) / 2u; ++i) {
+    int hi = hexval(d->b[4 + 2 * i]), lo = hexval(d->b[5 + 2 * i]);
+    if (hi < 0 || lo < 0) {
+      d->garbled++;
+      return;
+    }
+    uid[i] = (uint8_t)(hi << 4 | lo);
+  }
+  got_uid(d, uid, (n - 4u) / 2u);
+}
+
+static void decode(Dec_t *d, const uint8_t *p, size_t n)
+{
+  for (size_t i = 0; i < n; ++i) {
+    uint8_t c = p[i];
+
+    if (!d->n) d->bin = (c == 0xA5);
+    if (d->n < sizeof(d->b)) d->b[d->n] = c;
+    d->n++;
+    if (d->bin) {
+      if (d->n == 2 && (c == 0 || c > 10)) {
+        d->garbled++;
+        d->n = 0;
+      } else if (d->n > 2 && d->n == 3u + d->b[1]) {
+        uint8_t sum = 0;
+        for (uint32_t k = 1; k < d->n; ++k) sum += d->b[k];
+        if (sum) d->garbled++;
+        else     got_uid(d, &d->b[2], d->b[1]);
+        d->n = 0;
+      }
+    } else if (c == '\n') {
+      if (d->n > sizeof(d->b)) d->garbled++;
+      else                     text_line(d);
+      d->n = 0;
+    }
+  }
+}
+
+/* One connection event: full notifications, and a short one once the
+   line has gone idle */
+static void conn_event(int idle)
+{
+  uint32_t sent = 0;
+
+  bs.cis++;
+  while (m_count && (!per_ci || sent < per_ci)) {
+    uint8_t  pkt[512];
+    uint32_t n = m_count < mtu ? m_count : mtu;
+
+    if (n < mtu && !idle) break;
+    for (uint32_t i = 0; i < n; ++i) pkt[i] = mbuf[(m_head + i) % BUF_MAX];
+    m_head   = (m_head + n) % BUF_MAX;
+    m_count -= n;
+    decode(&d_air, pkt, n);
+    bs.pkts++;
+    sent++;
+  }
+  if (per_ci && sent == per_ci) bs.full_cis++;
+  flow_check();
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--baud") && i + 1 < argc)          mod_baud = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--max-baud") && i + 1 < argc) max_baud = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--mtu") && i + 1 < argc)      mtu = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--gap-ms") && i + 1 < argc)   gap_ms = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--buf") && i + 1 < argc)      buf_size = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--ci-ms") && i + 1 < argc)    ci_ms = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--per-ci") && i + 1 < argc)   per_ci = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--rtscts"))                   rtscts = 1;
+    else if (!strcmp(argv[i], "-v"))                         verbose = 1;
+    else {
+      fprintf(stderr, "usage: %s [--baud N] [--max-baud N] [--mtu N] [--gap-ms N] [--buf N] [--ci-ms N] "
+                      "[--per-ci N] [--rtscts] [-v]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (!mtu) mtu = 1;
+  if (mtu > 512) mtu = 512;
+  if (buf_size > BUF_MAX) buf_size = BUF_MAX;
+  if (buf_size && buf_size < mtu) buf_size = mtu;
+
+  master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master_fd < 0 || grantpt(master_fd) || unlockpt(master_fd)) { perror("pty"); return 1; }
+  slave_fd = open(ptsname(master_fd), O_RDWR | O_NOCTTY);   /* keeps the pty alive between clients */
+  if (slave_fd < 0) { perror("slave"); return 1; }
+  {
+    struct termios t;
+    tcgetattr(slave_fd, &t);
+    cfmakeraw(&t);
+    cfsetspeed(&t, B9600);
+    tcsetattr(slave_fd, TCSANOW, &t);
+  }
+  printf("%s\n", ptsname(master_fd));
+  fflush(stdout);
+
+  char     cmd[64];
+  size_t   cmd_len = 0, seg_len = 0;       /* bytes since the last idle gap */
+  int      seg_at = 0;                     /* the segment may still be an AT command */
+  uint64_t wire_end = 0;                   /* when the last byte read would have finished arriving */
+  uint64_t next_ci = 0;
+
+  for (;;) {
+    uint64_t t    = now_us();
+    uint64_t idle = wire_end + (uint64_t)gap_ms * 1000u;
+    uint64_t due  = t + (uint64_t)gap_ms * 1000u;
+
+    if ((seg_len || m_count) && idle < due) due = idle;
+    if (m_count && !ci_ms && m_count >= mtu) due = t;
+    if (m_count && ci_ms && next_ci < due)   due = next_ci;
+
+    /* Bytes already on their way when CTS went off still arrive */
+    struct pollfd p = { master_fd, POLLIN, 0 };
+    int r = poll(&p, 1, due > t ? (int)((due - t + 999u) / 1000u) : 0);
+
+    if (r > 0 && (p.revents & POLLIN)) {
+      uint8_t buf[512];
+      ssize_t n = read(master_fd, buf, sizeof(buf));
+      if (n <= 0) continue;
+      bs.bad += garble(buf, (size_t)n);
+
+      t = now_us();
+      if (wire_end < t) wire_end = t;
+      wire_end += (uint64_t)n * 10u * 1000000u / mod_baud;     /* 8N1 */
+      if (!seg_len) seg_at = 1;
+      seg_len  += (size_t)n;
+      bs.bytes += (uint64_t)n;
+      decode(&d_in, buf, (size_t)n);
+      for (ssize_t i = 0; i < n; ++i) {
+        if (seg_at && cmd_len < sizeof(cmd) - 1) cmd[cmd_len++] = (char)buf[i];
+      }
+      if (!seg_at) {
+        buf_put(buf, (size_t)n);
+      } else if (cmd_len < seg_len || cmd[0] != 'A' || (cmd_len >= 2 && cmd[1] != 'T')) {
+        size_t extra = seg_len - cmd_len;    /* payload after all: release what was held back */
+        buf_put((const uint8_t *)cmd, cmd_len);
+        buf_put(buf + n - extra, extra);
+        cmd_len = 0;
+        seg_at  = 0;
+      }
+    }
+
+    t = now_us();
+    int line_idle = (t >= wire_end + (uint64_t)gap_ms * 1000u);
+
+    /* idle gap: the module closes a pending AT command */
+    if (seg_len && line_idle) {
+      cmd[cmd_len] = 0;
+      if (seg_at && cmd_len >= 2) {
+        at_command(cmd);
+        if (!m_count && !cts_off) {          /* what came before was not a burst */
+          memset(&bs, 0, sizeof(bs));
+          memset(&d_in, 0, sizeof(d_in));
+          memset(&d_air, 0, sizeof(d_air));
+        } else {
+          bs.bytes -= cmd_len;
+        }
+      } else if (seg_at) {
+        buf_put((const uint8_t *)cmd, cmd_len);
+      }
+      cmd_len = seg_len = 0;
+      seg_at  = 0;
+    }
+
+    if (!ci_ms) {
+      if (m_count) conn_event(line_idle);
+    } else if (t >= next_ci) {
+      if (m_count) conn_event(line_idle);
+      next_ci += (uint64_t)ci_ms * 1000u;
+      if (next_ci <= t) next_ci = t + (uint64_t)ci_ms * 1000u;
+    }
+
+    if (bs.t0 && !seg_len && !m_count && t >= wire_end + BURST_GAP_MS * 1000u) {
+      uint64_t dt = (wire_end - bs.t0) / 1000u;
+      uint64_t ev = d_in.ok + d_in.garbled;
+      if (bs.bytes)
+        fprintf(stderr, "emu: burst %llu bytes, %llu events in %llu ms (%.1f ev/s, %.0f B/s, %llu corrupted) @%u, "
+                        "%llu notifications (%.2f per event, mtu %u)\n",
+                (unsigned long long)bs.bytes, (unsigned long long)ev,
+                (unsigned long long)dt, dt ? ev * 1000.0 / dt : 0.0,
+                dt ? bs.bytes * 1000.0 / dt : 0.0, (unsigned long long)bs.bad, mod_baud,
+                (unsigned long long)bs.pkts, ev ? (double)bs.pkts / ev : 0.0, mtu);
+      if (d_air.ok || d_air.garbled)
+        fprintf(stderr, "emu: delivered %llu events (seq %u..%u), lost %llu, out of order %llu, garbled %llu; "
+                        "buffer peak %u/%u, %llu bytes dropped, CTS held %llu ms; "
+                        "%llu connection events with data, %llu of them full\n",
+                (unsigned long long)d_air.ok, d_air.first, d_air.last, (unsigned long long)d_air.lost,
+                (unsigned long long)d_air.ooo, (unsigned long long)d_air.garbled, bs.peak, buf_cap(),
+                (unsigned long long)bs.dropped, (unsigned long long)(bs.held_us / 1000u),
+                (unsigned long long)bs.cis, (unsigned long long)bs.full_cis);
+      memset(&bs, 0, sizeof(bs));
+      memset(&d_in, 0, sizeof(d_in));
+      memset(&d_air, 0, sizeof(d_air));
+    }
+  }
+}
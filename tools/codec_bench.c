@@ -0,0 +1,438 @@
+/* PN532 frame codec benchmark and fuzzer.
+
+   Runs the frame builders and parsers of main.c (pn532_send,
+   pn532_parse_frame, pn532_read_resp, pn532_read_uid) and pn532.c
+   (write_command, read_response, PN532_ReadPassiveTargetA) unmodified on
+   the host, through tools/host/codecs.h, against an I2C device that is
+   always ready: an ACK after every command, then the response frame.
+
+   Benchmark: host TSC cycles (ns where there is no TSC) per call, best of
+   --rounds rounds of --calls calls, for encode, parse and the whole
+   exchange; parse of a 2-byte and a 62-byte payload gives the cost per
+   byte of the checksum and copy. "bus" is one empty transfer through the
+   HAL shim, part of every exchange and not of the firmware's cost.
+
+   Fuzzer: --iters responses made from valid seeds (firmware version, SAM,
+   InListPassiveTarget with 4-, 7- and 10-byte UIDs, no target, syntax
+   error) by bit flips, interesting bytes, insertions, deletions and
+   truncation, half of them with LEN, LCS and DCS made right again so the
+   mutation reaches the payload checks. Every driver is held to a strict
+   reference parser: a frame it accepts must be a valid frame, with the
+   same payload; a UID it reports must be the NFCID1 at its place in a
+   valid InListPassiveTarget response, and no byte may be written past the
+   caller's 10-byte UID buffer. Past the end of a response the device
+   serves zeros, and the reference reads them too. Deterministic for a
+   --seed; the first failures are printed as hex. Exit status 1 if any
+   check failed.
+
+   Build: S=ble_status_test/Core/Src
+          cc -O2 -Wall -Itools/host -Ible_status_test/Core/Inc -Dmain=app_main -o codec_bench \
+             tools/codec_bench.c tools/host/codec_main.c tools/host/codec_pn532.c \
+             $S/{sched,tmr,ble_link,ble_cmd,dbg_out,metrics,latency,i2c_trace,energy,retain,prof}.c \
+             tools/host/app_host.c tools/host/hal_host.c
+          The same with -O1 -g -fsanitize=address,undefined -fno-omit-frame-pointer
+          for the sanitizer build (-o codec_fuzz); benchmark numbers from it mean nothing.
+   Run:   ./codec_bench [--calls 20000] [--rounds 5] [--iters 200000] [--seed 1]
+                        [--bench-only] [--fuzz-only] */
+#undef main             /* -Dmain=app_main is for main.c */
+#include "codecs.h"
+#include "pn532.h"
+#include "tmr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CLOCK_UNIT  "cycles"
+static uint64_t clock_now(void) { return __rdtsc(); }
+#else
+#define CLOCK_UNIT  "ns"
+static uint64_t clock_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+/* ---------------- Time: the codecs only poll and stamp ---------------- */
+
+void     TMR_Sleep(uint32_t max_ms) { (void)max_ms; }
+uint32_t TMR_Micros(void)           { return (uint32_t)host_time_us(); }
+uint32_t TMR_SleepMs(void)          { return 0; }
+uint16_t TMR_DutyPermille(void)     { return 1000u; }
+
+/* ---------------- The device ---------------- */
+
+static const uint8_t k_ack[6] = { 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00 };
+
+static struct {
+  uint8_t  resp[300];          /* frame served after the ACK, from its start */
+  uint16_t resp_len;
+  bool     acked;
+} dev;
+
+static HAL_StatusTypeDef dev_xfer(void *ctx, uint16_t addr, bool rx, uint8_t *data, uint16_t len)
+{
+  (void)ctx;
+  (void)addr;
+  if (!rx) {
+    dev.acked = false;
+    return HAL_OK;
+  }
+  if (!len) return HAL_OK;
+  data[0] = 0x01;
+  if (len == 1) return HAL_OK;
+  memset(&data[1], 0, len - 1u);
+  if (!dev.acked) {
+    memcpy(&data[1], k_ack, len - 1u < sizeof(k_ack) ? len - 1u : sizeof(k_ack));
+    if (len - 1u >= sizeof(k_ack)) dev.acked = true;
+  } else {
+    memcpy(&data[1], dev.resp, len - 1u < dev.resp_len ? len - 1u : dev.resp_len);
+  }
+  return HAL_OK;
+}
+
+/* 00 00 FF LEN LCS payload DCS 00 */
+static uint16_t make_frame(uint8_t *out, const uint8_t *p, uint8_t n)
+{
+  uint8_t dcs = 0;
+  uint16_t w = 0;
+
+  out[w++] = 0x00;
+  out[w++] = 0x00;
+  out[w++] = 0xFF;
+  out[w++] = n;
+  out[w++] = (uint8_t)(~n + 1);
+  for (uint8_t i = 0; i < n; ++i) {
+    out[w++] = p[i];
+    dcs += p[i];
+  }
+  out[w++] = (uint8_t)(~dcs + 1);
+  out[w++] = 0x00;
+  return w;
+}
+
+static void serve(const uint8_t *frame, uint16_t len)
+{
+  memcpy(dev.resp, frame, len);
+  dev.resp_len = len;
+  dev.acked    = true;
+}
+
+/* ---------------- Seeds ---------------- */
+
+typedef struct {
+  const char *name;
+  uint8_t     p[64];
+  uint8_t     n;
+} Seed_t;
+
+static const Seed_t k_seeds[] = {
+  { "fw",     { 0xD5, 0x03, 0x32, 0x01, 0x06, 0x07 }, 6 },
+  { "sam",    { 0xD5, 0x15 }, 2 },
+  { "uid4",   { 0xD5, 0x4B, 0x01, 0x01, 0x00, 0x04, 0x08, 0x04, 0x04, 0xA1, 0xB2, 0xC3 }, 12 },
+  { "uid7",   { 0xD5, 0x4B, 0x01, 0x01, 0x00, 0x44, 0x00, 0x07, 0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 }, 15 },
+  { "uid10",  { 0xD5, 0x4B, 0x01, 0x01, 0x00, 0x44, 0x00, 0x0A,
+                0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99 }, 18 },
+  { "uid4ats", { 0xD5, 0x4B, 0x01, 0x01, 0x00, 0x04, 0x20, 0x04, 0xDE, 0xAD, 0xBE, 0xEF,
+                 0x05, 0x78, 0x80, 0x70, 0x02 }, 17 },
+  { "none",   { 0xD5, 0x4B, 0x00 }, 3 },
+  { "error",  { 0x7F }, 1 },
+};
+#define N_SEEDS  (sizeof(k_seeds) / sizeof(k_seeds[0]))
+
+/* ---------------- Reference ---------------- */
+
+/* Strict parse of what follows the status byte: payload length or -1 */
+static int ref_frame(const uint8_t *d, uint16_t n, const uint8_t **payload)
+{
+  uint16_t i = 0;
+  uint8_t len, sum = 0;
+
+  while (i + 2u < n && !(d[i] == 0x00 && d[i + 1] == 0x00 && d[i + 2] == 0xFF)) i++;
+  if (i + 5u > n) return -1;
+  len = d[i + 3];
+  if ((uint8_t)(len + d[i + 4]) != 0 || len == 0 || i + 5u + len + 1u > n) return -1;
+  for (uint16_t k = 0; k <= len; ++k) sum += d[i + 5 + k];
+  if (sum != 0) return -1;
+  *payload = &d[i + 5];
+  return len;
+}
+
+/* NFCID1 of a valid InListPassiveTarget response with one ISO14443A target */
+static int ref_uid(const uint8_t *p, int n, const uint8_t **uid)
+{
+  if (n < 8 || p[0] != 0xD5 || p[1] != 0x4B || p[2] == 0x00) return -1;
+  if (p[7] == 0 || p[7] > 10 || 8 + p[7] > n) return -1;
+  *uid = &p[8];
+  return p[7];
+}
+
+/* ---------------- Benchmark ---------------- */
+
+static unsigned calls = 20000, rounds = 5;
+
+typedef struct {
+  const char *name;
+  double      best;
+} Row_t;
+
+#define BENCH(row, setup, call)                                             \
+  do {                                                                      \
+    (row)->best = 1e30;                                                     \
+    for (unsigned r_ = 0; r_ < rounds; ++r_) {                              \
+      uint64_t t0_ = clock_now();                                           \
+      for (unsigned i_ = 0; i_ < calls; ++i_) { setup; (void)(call); }      \
+      double per_ = (double)(clock_now() - t0_) / calls;                    \
+      if (per_ < (row)->best) (row)->best = per_;                           \
+    }                                                                       \
+  } while (0)
+
+static void bench(void)
+{
+  static const uint8_t list[] = { 0xD4, 0x4A, 0x01, 0x00 };
+  static const uint8_t body[] = { 0x01, 0x00 };
+  uint8_t uid4[300], uid7[300], big[300], small[300], buf[80], uid[10], n;
+  uint16_t l4, l7, lbig, lsmall;
+  uint8_t p[62] = { 0xD5, 0x4B };
+  Row_t rows[12];
+  int k = 0;
+
+  l4 = make_frame(uid4, k_seeds[2].p, k_seeds[2].n);
+  l7 = make_frame(uid7, k_seeds[3].p, k_seeds[3].n);
+  for (unsigned i = 2; i < sizeof(p); ++i) p[i] = (uint8_t)(i * 7u);
+  lbig   = make_frame(big, p, sizeof(p));
+  lsmall = make_frame(small, p, 2);
+
+  rows[k].name = "bus: one empty transfer";
+  BENCH(&rows[k], (void)0, HAL_I2C_Master_Transmit(&hi2c1, 0x48, buf, 0, 10)); k++;
+
+  rows[k].name = "main.c pn532_send (InList)";
+  BENCH(&rows[k], (void)0, codec_main_send(list, sizeof(list))); k++;
+  rows[k].name = "main.c pn532_parse_frame uid4";
+  BENCH(&rows[k], (void)0, codec_main_parse(uid4, l4, buf, 40)); k++;
+  rows[k].name = "main.c pn532_parse_frame uid7";
+  BENCH(&rows[k], (void)0, codec_main_parse(uid7, l7, buf, 40)); k++;
+  rows[k].name = "main.c pn532_parse_frame LEN 2";
+  BENCH(&rows[k], (void)0, codec_main_parse(small, lsmall, buf, 64)); k++;
+  rows[k].name = "main.c pn532_parse_frame LEN 62";
+  BENCH(&rows[k], (void)0, codec_main_parse(big, lbig, buf, 64)); k++;
+  rows[k].name = "main.c pn532_read_resp uid4";
+  BENCH(&rows[k], serve(uid4, l4), codec_main_read_resp(buf, 40)); k++;
+  rows[k].name = "main.c pn532_read_uid uid7";
+  BENCH(&rows[k], serve(uid7, l7), codec_main_read_uid(0, uid, sizeof(uid))); k++;
+
+  rows[k].name = "pn532.c write_command (InList)";
+  BENCH(&rows[k], (void)0, codec_pn532_write(0x4A, body, sizeof(body))); k++;
+  rows[k].name = "pn532.c read_response uid4";
+  BENCH(&rows[k], serve(uid4, l4), codec_pn532_read_resp(buf, 64)); k++;
+  rows[k].name = "pn532.c ReadPassiveTargetA uid7";
+  BENCH(&rows[k], (void)0, PN532_ReadPassiveTargetA(uid, &n, 100)); k++;
+
+  printf("%-34s %10s\n", "best of rounds, per call", CLOCK_UNIT);
+  for (int i = 0; i < k; ++i) printf("%-34s %10.1f\n", rows[i].name, rows[i].best);
+  printf("%-34s %10.2f\n", "checksum + copy, per payload byte", (rows[5].best - rows[4].best) / 60.0);
+}
+
+/* ---------------- Fuzzer ---------------- */
+
+static uint32_t rng = 1;
+
+static uint32_t rnd(void)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static uint16_t mutate(uint8_t *f, uint16_t n, uint16_t cap)
+{
+  static const uint8_t k_vals[] = { 0x00, 0x01, 0x0A, 0x0B, 0x7F, 0x80, 0xD5, 0xFE, 0xFF };
+  unsigned m = 1u + rnd() % 4u;
+
+  while (m--) {
+    uint16_t at = n ? (uint16_t)(rnd() % n) : 0;
+    switch (rnd() % 5u) {
+    case 0: if (n) f[at] ^= (uint8_t)(1u << (rnd() % 8u)); break;
+    case 1: if (n) f[at] = k_vals[rnd() % sizeof(k_vals)]; break;
+    case 2:
+      if (n < cap) {
+        memmove(&f[at + 1], &f[at], n - at);
+        f[at] = (uint8_t)rnd();
+        n++;
+      }
+      break;
+    case 3:
+      if (n) {
+        memmove(&f[at], &f[at + 1], n - at - 1u);
+        n--;
+      }
+      break;
+    default: n = (uint16_t)(rnd() % (n + 1u)); break;
+    }
+  }
+  return n;
+}
+
+/* Make LEN, LCS and DCS right for the bytes that are there */
+static void fix_sums(uint8_t *f, uint16_t n)
+{
+  uint8_t len, dcs = 0;
+
+  if (n < 8 || n > 262 || f[0] || f[1] || f[2] != 0xFF) return;
+  len = (uint8_t)(n - 7u);
+  f[3] = len;
+  f[4] = (uint8_t)(~len + 1);
+  for (uint16_t i = 0; i < len; ++i) dcs += f[5 + i];
+  f[5 + len] = (uint8_t)(~dcs + 1);
+}
+
+typedef struct {
+  const char *what;
+  uint32_t    n;
+} Check_t;
+
+static Check_t fails[] = {
+  { "main.c parse: accepted an invalid frame", 0 },
+  { "main.c parse: payload differs", 0 },
+  { "main.c read_uid: UID from an invalid response", 0 },
+  { "main.c read_uid: wrong UID", 0 },
+  { "main.c read_uid: wrote past the UID buffer", 0 },
+  { "pn532.c read_response: accepted an invalid frame", 0 },
+  { "pn532.c read_response: payload differs", 0 },
+  { "pn532.c ReadPassiveTargetA: UID from an invalid response", 0 },
+  { "pn532.c ReadPassiveTargetA: wrong UID", 0 },
+  { "pn532.c ReadPassiveTargetA: wrote past the UID buffer", 0 },
+};
+enum { F_MP_INV, F_MP_DIFF, F_MU_INV, F_MU_WRONG, F_MU_OVER, F_PR_INV, F_PR_DIFF, F_PU_INV, F_PU_WRONG, F_PU_OVER };
+
+static unsigned shown;
+
+static void fail(int k, uint32_t it, const uint8_t *f, uint16_t n)
+{
+  fails[k].n++;
+  if (shown++ >= 8) return;
+  printf("iter %u: %s:", it, fails[k].what);
+  for (uint16_t i = 0; i < n && i < 40u; ++i) printf(" %02X", f[i]);
+  printf("%s\n", n > 40u ? " .." : "");
+}
+
+/* The UID buffer with guard bytes behind it */
+typedef struct {
+  uint8_t uid[10];
+  uint8_t guard[64];
+} UidBuf_t;
+
+static bool guard_ok(const UidBuf_t *b)
+{
+  for (size_t i = 0; i < sizeof(b->guard); ++i)
+    if (b->guard[i] != 0xA5) return false;
+  return true;
+}
+
+static int fuzz(uint32_t iters)
+{
+  uint32_t acc_mp = 0, acc_mu = 0, acc_pr = 0, acc_pu = 0, bad = 0;
+
+  for (uint32_t it = 0; it < iters; ++it) {
+    const Seed_t *s = &k_seeds[rnd() % N_SEEDS];
+    uint8_t f[300], out[80];
+    const uint8_t *rp, *dp, *ru;
+    UidBuf_t ub;
+    uint16_t n = make_frame(f, s->p, s->n);
+    int rn, dn, rl;
+    uint8_t got;
+    uint16_t got16;
+
+    n = mutate(f, n, 200);
+    if (rnd() & 1u) fix_sums(f, n);
+    memset(&f[n], 0, sizeof(f) - n);
+    rn = ref_frame(f, n, &rp);
+    /* A driver reading past the end gets the device's zero padding */
+    dn = ref_frame(f, sizeof(f), &dp);
+    rl = dn > 0 ? ref_uid(dp, dn, &ru) : -1;
+
+    /* main.c parse on the bytes as they would sit after the status byte */
+    got = codec_main_parse(f, n, out, 64);
+    if (got) {
+      acc_mp++;
+      if (rn < 0) fail(F_MP_INV, it, f, n);
+      else if (got != (rn < 64 ? rn : 64) || memcmp(out, rp, got)) fail(F_MP_DIFF, it, f, n);
+    }
+
+    /* main.c InListPassiveTarget round */
+    memset(&ub, 0xA5, sizeof(ub));
+    serve(f, n);
+    dev.acked = false;
+    got = codec_main_read_uid(0, ub.uid, sizeof(ub.uid));
+    if (!guard_ok(&ub)) fail(F_MU_OVER, it, f, n);
+    if (got) {
+      acc_mu++;
+      if (rl < 0) fail(F_MU_INV, it, f, n);
+      else if (got != rl || memcmp(ub.uid, ru, (size_t)rl)) fail(F_MU_WRONG, it, f, n);
+    }
+
+    /* pn532.c response read */
+    serve(f, n);
+    got16 = codec_pn532_read_resp(out, 64);
+    if (got16) {
+      acc_pr++;
+      if (dn < 0) fail(F_PR_INV, it, f, n);
+      else if (got16 != dn || memcmp(out, dp, got16)) fail(F_PR_DIFF, it, f, n);
+    }
+
+    /* pn532.c InListPassiveTarget round */
+    memset(&ub, 0xA5, sizeof(ub));
+    serve(f, n);
+    dev.acked = false;
+    got = 0;
+    if (PN532_ReadPassiveTargetA(ub.uid, &got, 100) && got) {
+      acc_pu++;
+      if (rl < 0) fail(F_PU_INV, it, f, n);
+      else if (got != rl || memcmp(ub.uid, ru, (size_t)rl)) fail(F_PU_WRONG, it, f, n);
+    }
+    if (!guard_ok(&ub)) fail(F_PU_OVER, it, f, n);
+  }
+
+  printf("fuzz: %u responses; accepted: main.c parse %u, read_uid %u; pn532.c read_response %u, "
+         "ReadPassiveTargetA %u\n", iters, acc_mp, acc_mu, acc_pr, acc_pu);
+  for (size_t i = 0; i < sizeof(fails) / sizeof(fails[0]); ++i) {
+    bad += fails[i].n;
+    if (fails[i].n) printf("FAIL %-55s %u\n", fails[i].what, fails[i].n);
+  }
+  printf("fuzz: %s\n", bad ? "FAIL" : "PASS");
+  return bad ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t iters = 200000;
+  bool do_bench = true, do_fuzz = true;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--calls") && i + 1 < argc) calls = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--rounds") && i + 1 < argc) rounds = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--iters") && i + 1 < argc) iters = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) rng = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if (!strcmp(argv[i], "--bench-only")) do_fuzz = false;
+    else if (!strcmp(argv[i], "--fuzz-only")) do_bench = false;
+    else {
+      fprintf(stderr, "usage: %s [--calls N] [--rounds N] [--iters N] [--seed N] [--bench-only|--fuzz-only]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (!rng) rng = 1;
+  if (!calls) calls = 1;
+
+  host_time_virtual();
+  hi2c1.Init.ClockSpeed = 400000u;
+  host_i2c_device(dev_xfer, NULL);
+
+  if (do_bench) bench();
+  return do_fuzz ? fuzz(iters) : 0;
+}
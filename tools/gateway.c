@@ -0,0 +1,521 @@
+/* Gateway side of the BLE link: event stream decoder and command load.
+
+   Reads what the firmware sends over the link from a serial device or pty
+   (or a capture file, decoded at once): "UID:<hex>" lines and 0xA5 binary
+   UID frames (ble_cmd.h, either format, switched at any time), command
+   replies, 0xA6 metrics frames (metrics.h) and diagnostic text. Reports:
+     - events and events/s, overall and the best one-second window
+     - duplicates: the same UID again within --dup-ms
+     - gaps: silences between events longer than --gap-ms; with --seq, UIDs
+       carry a sequence number in their last four bytes (tools/ble_bench.c
+       style) and missing and out of order numbers are counted as well,
+       from the first one seen
+     - latency: with --seq-rate, events were offered at that many per
+       second from number 1, and each one's arrival is compared with its
+       place in that schedule; the least delay seen is taken as zero, so
+       this is the queueing the link added. The firmware's own tap to wire
+       breakdown is the LAT command (--end LAT).
+   Commands (--cmd, repeatable, or one per line from --cmds) are sent in
+   turn at --cmd-rate per second, with at most --cmd-window unanswered,
+   and each reply is timed. Replies are matched in order: "OK", "ERR",
+   "BUSY", "key=value ..." lines and metrics frames; a reply later than
+   --cmd-timeout counts as lost, and any later one is taken for the next
+   command's. --end commands are sent once the run is over and their
+   replies printed. The last metrics frame is printed with the summary.
+
+   Build: cc -O2 -Wall -Itools/host -Ible_status_test/Core/Inc -o gateway tools/gateway.c
+   Run:   ./gateway /dev/ttyUSB0 [--baud 9600] [--seconds 0] [--dup-ms 1000] [--gap-ms 0]
+                    [--seq] [--seq-rate N] [--cmd LINE].. [--cmds file] [--cmd-rate 1]
+                    [--cmd-window 1] [--cmd-timeout 1000] [--end LINE].. [-v]
+          (--seconds 0 runs until EOF or Ctrl-C) */
+#include "metrics.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* MetricId_t order */
+static const char *const k_met[MET_N] = {
+  "polls", "hits", "uids", "uid_dropped", "ack_fail", "frame_err", "i2c_err", "ready_timeout",
+  "ble_full", "cmds", "cmd_dropped", "dbg_dropped", "sched_dropped", "stack_peak", "ram_headroom",
+  "heap_peak", "charge_nah",
+};
+
+#define LINE_MAX_   200
+#define CMDS_MAX    64
+#define WINDOW_MAX  16
+
+static int      fd, is_tty, verbose;
+static volatile sig_atomic_t stop;
+static uint64_t t_start;
+
+static uint64_t now_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static double rel_ms(uint64_t t) { return (double)(t - t_start) / 1000.0; }
+
+static void on_int(int sig)
+{
+  (void)sig;
+  stop = 1;
+}
+
+/* ---------------- Samples ---------------- */
+
+typedef struct {
+  double  *v;
+  uint32_t n, cap;
+} Samples_t;
+
+static void sample(Samples_t *s, double v)
+{
+  if (s->n == s->cap) {
+    uint32_t cap = s->cap ? s->cap * 2u : 1024u;
+    double *p = realloc(s->v, cap * sizeof(double));
+    if (!p) return;
+    s->v   = p;
+    s->cap = cap;
+  }
+  s->v[s->n++] = v;
+}
+
+static int cmp_d(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* Sorts in place */
+static void print_pct(const char *what, Samples_t *s, double offset)
+{
+  if (!s->n) return;
+  qsort(s->v, s->n, sizeof(double), cmp_d);
+  printf("gateway: %s ms: min %.1f  p50 %.1f  p95 %.1f  p99 %.1f  max %.1f  (%u)\n", what,
+         s->v[0] - offset, s->v[s->n / 2] - offset, s->v[(uint32_t)(s->n * 0.95)] - offset,
+         s->v[(uint32_t)(s->n * 0.99)] - offset, s->v[s->n - 1] - offset, s->n);
+}
+
+/* ---------------- Events ---------------- */
+
+static uint32_t dup_ms = 1000, gap_ms;
+static int      seq_on;
+static double   seq_rate;
+
+static struct {
+  uint64_t n, ascii, binary, garbled, other, dup, gaps;
+  uint64_t first_us, last_us, longest_us;
+  uint8_t  last_uid[10], last_len;
+  uint64_t win_start, win_n, win_best;    /* one-second windows */
+  uint64_t lost, ooo;
+  uint32_t seq_first, seq_last;
+  int      seq_any;
+  Samples_t sched;                        /* arrival - place in schedule, ms */
+} ev;
+
+static void on_event(const uint8_t *uid, uint8_t len, uint64_t t, int binary)
+{
+  if (verbose) {
+    printf("%10.1f  uid ", rel_ms(t));
+    for (uint8_t i = 0; i < len; ++i) printf("%02X", uid[i]);
+    printf("%s\n", binary ? " (bin)" : "");
+  }
+  if (binary) ev.binary++;
+  else        ev.ascii++;
+
+  if (ev.n) {
+    uint64_t dt = t - ev.last_us;
+    if (len == ev.last_len && !memcmp(uid, ev.last_uid, len) && dt < (uint64_t)dup_ms * 1000u) ev.dup++;
+    if (gap_ms && dt > (uint64_t)gap_ms * 1000u) ev.gaps++;
+    if (dt > ev.longest_us) ev.longest_us = dt;
+  } else {
+    ev.first_us  = t;
+    ev.win_start = t;
+  }
+  ev.n++;
+  ev.last_us  = t;
+  ev.last_len = len;
+  memcpy(ev.last_uid, uid, len);
+
+  while (t - ev.win_start >= 1000000u) {
+    if (ev.win_n > ev.win_best) ev.win_best = ev.win_n;
+    ev.win_n = 0;
+    ev.win_start += 1000000u;
+  }
+  ev.win_n++;
+
+  if (!seq_on) return;
+  uint32_t seq = 0;
+  for (uint8_t i = len > 4u ? len - 4u : 0; i < len; ++i) seq = (seq << 8) | uid[i];
+  if (!ev.seq_any) {                      /* we may have joined late */
+    ev.seq_any   = 1;
+    ev.seq_first = ev.seq_last = seq;
+  } else if (seq == ev.seq_last) {
+    /* a duplicate, counted above */
+  } else if (seq == ev.seq_last + 1u) {
+    ev.seq_last = seq;
+  } else if ((int32_t)(seq - ev.seq_last) > 0) {
+    ev.lost    += seq - ev.seq_last - 1u;
+    ev.seq_last = seq;
+  } else {
+    ev.ooo++;
+  }
+  if (seq_rate > 0 && seq)
+    sample(&ev.sched, (double)(t - t_start) / 1000.0 - (double)(seq - 1u) * 1000.0 / seq_rate);
+}
+
+/* ---------------- Commands ---------------- */
+
+static const char *cmds[CMDS_MAX];
+static int      n_cmds, next_cmd;
+static const char *end_cmds[CMDS_MAX];
+static int      n_end;
+static double   cmd_rate = 1.0;
+static uint32_t cmd_window = 1, cmd_timeout = 1000;
+static int      end_phase;
+
+static struct {
+  const char *cmd[WINDOW_MAX];
+  uint64_t    t[WINDOW_MAX];
+  uint32_t    head, n;
+} out;
+
+static struct {
+  uint64_t sent, replies, err, busy, timeouts, unsolicited;
+  Samples_t rtt;
+} cs;
+
+static uint8_t  met_frame[MET_FRAME_SIZE];
+static int      met_have;
+
+static void send_cmd(const char *c, uint64_t t)
+{
+  char line[LINE_MAX_ + 3];
+  int n = snprintf(line, sizeof(line), "%s\r\n", c);
+
+  if (out.n == WINDOW_MAX || n <= 0 || write(fd, line, (size_t)n) != n) return;
+  out.cmd[(out.head + out.n) % WINDOW_MAX] = c;
+  out.t[(out.head + out.n++) % WINDOW_MAX] = t;
+  cs.sent++;
+  if (verbose) printf("%10.1f  >> %s\n", rel_ms(t), c);
+}
+
+/* The oldest unanswered command got its reply (text, or NULL for a frame) */
+static void on_reply(const char *text, uint64_t t)
+{
+  if (!out.n) {
+    cs.unsolicited++;
+    if (verbose || end_phase) printf("%10.1f  << %s (unsolicited)\n", rel_ms(t), text ? text : "metrics frame");
+    return;
+  }
+  const char *c = out.cmd[out.head];
+  double rtt = (double)(t - out.t[out.head]) / 1000.0;
+  out.head = (out.head + 1u) % WINDOW_MAX;
+  out.n--;
+  cs.replies++;
+  sample(&cs.rtt, rtt);
+  if (text && !strcmp(text, "ERR"))  cs.err++;
+  if (text && !strcmp(text, "BUSY")) cs.busy++;
+  if (verbose || end_phase) printf("%10.1f  << %s: %s (%.1f ms)\n", rel_ms(t), c, text ? text : "metrics frame", rtt);
+}
+
+static void expire(uint64_t t)
+{
+  while (out.n && t - out.t[out.head] > (uint64_t)cmd_timeout * 1000u) {
+    if (verbose || end_phase) printf("%10.1f  << %s: no reply\n", rel_ms(t), out.cmd[out.head]);
+    out.head = (out.head + 1u) % WINDOW_MAX;
+    out.n--;
+    cs.timeouts++;
+  }
+}
+
+static int is_reply(const char *s)
+{
+  const char *p = s;
+
+  if (!strcmp(s, "OK") || !strcmp(s, "ERR") || !strcmp(s, "BUSY")) return 1;
+  while ((*p >= 'a' && *p <= 'z') || (*p >= '0' && *p <= '9') || *p == '_') p++;
+  return p != s && *p == '=';
+}
+
+/* ---------------- Stream ---------------- */
+
+static struct {
+  uint8_t  b[LINE_MAX_ + 1];
+  uint32_t n, want;                       /* want: frame length, 0 = text */
+} rx;
+
+static int hexval(uint8_t c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static void on_line(char *s, uint64_t t)
+{
+  uint8_t uid[10];
+  size_t n = strlen(s);
+
+  while (n && (s[n - 1] == '\r' || s[n - 1] == '\n')) s[--n] = 0;
+  if (!n) return;
+  if (!strncmp(s, "UID:", 4)) {
+    size_t h = n - 4u;
+    if (h < 2u || h > 20u || h % 2u) { ev.garbled++; return; }
+    for (size_t i = 0; i < h / 2u; ++i) {
+      int hi = hexval((uint8_t)s[4 + 2 * i]), lo = hexval((uint8_t)s[5 + 2 * i]);
+      if (hi < 0 || lo < 0) { ev.garbled++; return; }
+      uid[i] = (uint8_t)(hi << 4 | lo);
+    }
+    on_event(uid, (uint8_t)(h / 2u), t, 0);
+  } else if (is_reply(s)) {
+    on_reply(s, t);
+  } else {
+    ev.other++;
+    if (verbose) printf("%10.1f  %s\n", rel_ms(t), s);
+  }
+}
+
+/* A5 LEN UID.. CS and A6 LEN VER.. CS: LEN..CS sums to zero */
+static int frame_ok(void)
+{
+  uint8_t sum = 0;
+  for (uint32_t i = 1; i < rx.n; ++i) sum += rx.b[i];
+  return sum == 0;
+}
+
+static void decode(const uint8_t *p, size_t n, uint64_t t)
+{
+  for (size_t i = 0; i < n; ++i) {
+    uint8_t c = p[i];
+
+    if (rx.n == 0 && (c == 0xA5 || c == MET_FRAME_MAGIC)) {
+      rx.b[rx.n++] = c;
+      rx.want = 1;                        /* LEN next */
+      continue;
+    }
+    if (rx.want) {
+      rx.b[rx.n++] = c;
+      if (rx.n == 2) {
+        uint32_t len = (rx.b[0] == 0xA5) ? c + 3u : c + 2u;
+        if ((rx.b[0] == 0xA5 && (c == 0 || c > 10)) || (rx.b[0] != 0xA5 && len != MET_FRAME_SIZE)) {
+          ev.garbled++;
+          rx.n = rx.want = 0;
+          continue;
+        }
+        rx.want = len;
+      }
+      if (rx.n < 2 || rx.n < rx.want) continue;
+      if (!frame_ok()) {
+        ev.garbled++;
+      } else if (rx.b[0] == 0xA5) {
+        on_event(&rx.b[2], rx.b[1], t, 1);
+      } else {
+        memcpy(met_frame, rx.b, MET_FRAME_SIZE);
+        met_have = 1;
+        on_reply(NULL, t);
+      }
+      rx.n = rx.want = 0;
+      continue;
+    }
+    if (c == '\n') {
+      rx.b[rx.n] = 0;
+      on_line((char *)rx.b, t);
+      rx.n = 0;
+    } else if (rx.n < LINE_MAX_) {
+      rx.b[rx.n++] = c;
+    } else {
+      ev.garbled++;                       /* overlong: drop, resync on the next LF */
+      rx.n = 0;
+    }
+  }
+}
+
+static uint32_t le32(const uint8_t *p) { return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24; }
+
+static void print_metrics(void)
+{
+  const uint8_t *p = &met_frame[2];
+
+  if (!met_have) return;
+  if (p[0] != MET_FRAME_VERSION || p[1] != MET_N || p[2] != MET_H_N || p[3] != MET_BUCKETS) {
+    printf("gateway: metrics frame version %u with %u counters, not decoded\n", p[0], p[1]);
+    return;
+  }
+  printf("gateway: device metrics at %lu s:", (unsigned long)le32(&p[4]));
+  for (int i = 0; i < MET_N; ++i) printf(" %s=%lu", k_met[i], (unsigned long)le32(&p[8 + 4 * i]));
+  printf("\n");
+}
+
+/* ---------------- Main ---------------- */
+
+static speed_t to_speed(uint32_t baud)
+{
+  switch (baud) {
+  case 9600:   return B9600;
+  case 19200:  return B19200;
+  case 38400:  return B38400;
+  case 57600:  return B57600;
+  case 115200: return B115200;
+  case 230400: return B230400;
+  default:     return B0;
+  }
+}
+
+static int load_cmds(const char *path)
+{
+  static char lines[CMDS_MAX][LINE_MAX_ + 1];
+  FILE *f = fopen(path, "r");
+
+  if (!f) { perror(path); return -1; }
+  while (n_cmds < CMDS_MAX && fgets(lines[n_cmds], sizeof(lines[0]), f)) {
+    char *s = lines[n_cmds];
+    s[strcspn(s, "\r\n")] = 0;
+    if (*s && *s != '#') cmds[n_cmds++] = s;
+  }
+  fclose(f);
+  return 0;
+}
+
+/* Read for up to ms, or until EOF; returns 0 at EOF */
+static int pump(int ms)
+{
+  struct pollfd p = { fd, POLLIN, 0 };
+  uint8_t buf[512];
+  ssize_t n;
+
+  if (is_tty && poll(&p, 1, ms) <= 0) return 1;
+  n = read(fd, buf, sizeof(buf));
+  if (n == 0 && !is_tty) return 0;
+  if (n > 0) decode(buf, (size_t)n, now_us());
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  const char *dev = NULL;
+  uint32_t baud = 9600, seconds = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--baud") && i + 1 < argc)             baud = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--seconds") && i + 1 < argc)     seconds = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--dup-ms") && i + 1 < argc)      dup_ms = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--gap-ms") && i + 1 < argc)      gap_ms = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--seq"))                         seq_on = 1;
+    else if (!strcmp(argv[i], "--seq-rate") && i + 1 < argc)    { seq_rate = atof(argv[++i]); seq_on = 1; }
+    else if (!strcmp(argv[i], "--cmd") && i + 1 < argc)         { if (n_cmds < CMDS_MAX) cmds[n_cmds++] = argv[++i]; else ++i; }
+    else if (!strcmp(argv[i], "--cmds") && i + 1 < argc)        { if (load_cmds(argv[++i])) return 1; }
+    else if (!strcmp(argv[i], "--cmd-rate") && i + 1 < argc)    cmd_rate = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--cmd-window") && i + 1 < argc)  cmd_window = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--cmd-timeout") && i + 1 < argc) cmd_timeout = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--end") && i + 1 < argc)         { if (n_end < CMDS_MAX) end_cmds[n_end++] = argv[++i]; else ++i; }
+    else if (!strcmp(argv[i], "-v"))                            verbose = 1;
+    else if (!dev && argv[i][0] != '-')                         dev = argv[i];
+    else {
+      fprintf(stderr, "usage: %s DEVICE|FILE [--baud N] [--seconds N] [--dup-ms N] [--gap-ms N] [--seq]\n"
+                      "          [--seq-rate N] [--cmd LINE].. [--cmds FILE] [--cmd-rate N] [--cmd-window N]\n"
+                      "          [--cmd-timeout MS] [--end LINE].. [-v]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (!dev) {
+    fprintf(stderr, "%s: no device\n", argv[0]);
+    return 2;
+  }
+  if (!cmd_window) cmd_window = 1;
+  if (cmd_window > WINDOW_MAX) cmd_window = WINDOW_MAX;
+  if (cmd_rate <= 0) n_cmds = 0;
+
+  fd = open(dev, O_RDWR | O_NOCTTY);
+  if (fd < 0) fd = open(dev, O_RDONLY);
+  if (fd < 0) { perror(dev); return 1; }
+  is_tty = isatty(fd);
+  if (is_tty) {
+    struct termios t;
+    if (to_speed(baud) == B0 || tcgetattr(fd, &t) != 0) { fprintf(stderr, "%s: bad rate or not a tty\n", dev); return 1; }
+    cfmakeraw(&t);
+    cfsetispeed(&t, to_speed(baud));
+    cfsetospeed(&t, to_speed(baud));
+    tcsetattr(fd, TCSANOW, &t);
+    tcflush(fd, TCIFLUSH);
+  } else if (n_cmds || n_end) {
+    fprintf(stderr, "%s: not a tty, commands ignored\n", dev);
+    n_cmds = n_end = 0;
+  }
+  signal(SIGINT, on_int);
+  signal(SIGTERM, on_int);
+
+  t_start = now_us();
+  uint64_t next_at = t_start;
+  uint64_t until   = seconds ? t_start + (uint64_t)seconds * 1000000u : 0;
+
+  while (!stop) {
+    uint64_t t = now_us();
+    int wait = 100;
+
+    if (until && t >= until) break;
+    expire(t);
+    if (n_cmds && out.n < cmd_window && t >= next_at) {
+      send_cmd(cmds[next_cmd], t);
+      next_cmd = (next_cmd + 1) % n_cmds;
+      next_at += (uint64_t)(1000000.0 / cmd_rate);
+      if (next_at < t) next_at = t;       /* the window held us back: no catching up */
+      continue;
+    }
+    if (n_cmds && out.n < cmd_window) wait = next_at > t ? (int)((next_at - t + 999u) / 1000u) : 0;
+    if (!pump(wait)) break;
+  }
+  uint64_t t_end = now_us();
+
+  /* Closing queries: one at a time, replies printed */
+  end_phase = 1;
+  for (int i = 0; i < n_end; ++i) {
+    while (out.n && !stop) {
+      expire(now_us());
+      pump(20);
+    }
+    send_cmd(end_cmds[i], now_us());
+  }
+  while (out.n && !stop) {
+    expire(now_us());
+    pump(20);
+  }
+
+  double secs = (double)(t_end - t_start) / 1e6;
+  double span = ev.n > 1 ? (double)(ev.last_us - ev.first_us) / 1e6 : 0.0;
+  if (ev.win_n > ev.win_best) ev.win_best = ev.win_n;
+  printf("gateway: %.1f s, %llu events (%llu text, %llu binary), %.1f ev/s between the first and last, "
+         "best second %llu; %llu garbled, %llu other lines\n",
+         secs, (unsigned long long)ev.n, (unsigned long long)ev.ascii, (unsigned long long)ev.binary,
+         span > 0 ? (double)(ev.n - 1u) / span : 0.0, (unsigned long long)ev.win_best,
+         (unsigned long long)ev.garbled, (unsigned long long)ev.other);
+  printf("gateway: duplicates %llu (within %u ms); longest silence %.1f ms", (unsigned long long)ev.dup, dup_ms,
+         (double)ev.longest_us / 1000.0);
+  if (gap_ms) printf(", %llu over %u ms", (unsigned long long)ev.gaps, gap_ms);
+  printf("\n");
+  if (seq_on && ev.seq_any)
+    printf("gateway: sequence %u..%u: lost %llu, out of order %llu\n", ev.seq_first, ev.seq_last,
+           (unsigned long long)ev.lost, (unsigned long long)ev.ooo);
+  if (ev.sched.n) {
+    double least = 1e300;
+    for (uint32_t i = 0; i < ev.sched.n; ++i) if (ev.sched.v[i] < least) least = ev.sched.v[i];
+    print_pct("delay against the offered schedule", &ev.sched, least);
+  }
+  if (cs.sent) {
+    printf("gateway: commands %llu sent, %llu replies (%llu ERR, %llu BUSY), %llu without reply, %llu unsolicited\n",
+           (unsigned long long)cs.sent, (unsigned long long)cs.replies, (unsigned long long)cs.err,
+           (unsigned long long)cs.busy, (unsigned long long)cs.timeouts, (unsigned long long)cs.unsolicited);
+    print_pct("command round trip", &cs.rtt, 0.0);
+  }
+  print_metrics();
+  return 0;
+}
@@ -0,0 +1,94 @@
+/* main.c's hardware-only dependencies on the host, see app_host.h */
+#include "app_host.h"
+#include "main.h"
+#include "clock.h"
+#include "energy.h"
+#include "memmon.h"
+#include "msi_cal.h"
+#include "trace.h"
+
+I2C_HandleTypeDef  hi2c1;
+UART_HandleTypeDef huart2;
+USART_TypeDef      host_ble_port;
+unsigned           host_app_khz = 400;
+FILE              *host_swo;
+
+void MX_GPIO_Init(void) { }
+void MX_DMA_Init(void)  { }
+
+void MX_I2C1_Init(void)
+{
+  hi2c1.Init.ClockSpeed = host_app_khz * 1000u;
+}
+
+void MX_USART2_UART_Init(void)
+{
+  huart2.Instance      = &host_ble_port;
+  huart2.Init.BaudRate = 9600;
+  if (HAL_UART_Init(&huart2) != HAL_OK) Error_Handler();
+}
+
+/* The I2C peripheral only runs in CLK_BURST (clock.h) */
+static ClkProfile_t clk = CLK_BURST;
+static uint32_t     clk_switches;
+
+void CLK_Init(void) { clk = CLK_BURST; }
+
+bool CLK_Set(ClkProfile_t p)
+{
+  if (p == clk) return true;
+  clk = p;
+  clk_switches++;
+  hi2c1.Init.ClockSpeed = (p == CLK_BURST) ? host_app_khz * 1000u : 0u;
+  NRG_Clock(p == CLK_BURST);
+  return true;
+}
+
+ClkProfile_t CLK_Get(void)            { return clk; }
+uint32_t CLK_TimeIn(ClkProfile_t p)   { (void)p; return 0; }
+uint32_t CLK_Switches(void)           { return clk_switches; }
+
+void   MSICAL_Init(void)                               { }
+bool   MSICAL_Step(void)                               { return true; }
+bool   MSICAL_Error(int32_t *found, int32_t *left)     { *found = 0; *left = 0; return false; }
+int8_t MSICAL_Trim(void)                               { return 0; }
+
+void     MEM_Paint(void)              { }
+bool     MEM_Scan(uint16_t words)     { (void)words; return true; }
+uint32_t MEM_StackPeak(void)          { return 0; }
+uint32_t MEM_Headroom(void)           { return 0; }
+uint32_t SYSMEM_HeapUsed(void)        { return 0; }
+uint32_t SYSMEM_HeapPeak(void)        { return 0; }
+uint32_t SYSMEM_HeapFails(void)       { return 0; }
+
+/* SWO: only the I2C recording port, as ITM source packets */
+
+static void itm_packet(uint8_t port, uint32_t w, int size)
+{
+  fputc((port << 3) | (size == 4 ? 3 : size), host_swo);
+  for (int i = 0; i < size; ++i) fputc((int)(w >> (8 * i)) & 0xFF, host_swo);
+}
+
+bool TRACE_On(uint8_t port)
+{
+  return host_swo && port == TRACE_PORT_I2C;
+}
+
+bool TRACE_Word(uint8_t port, uint32_t w)
+{
+  if (!TRACE_On(port)) return false;
+  itm_packet(port, w, 4);
+  return true;
+}
+
+uint16_t TRACE_Write(uint8_t port, const void *data, uint16_t len)
+{
+  const uint8_t *p = data;
+  uint16_t i = 0;
+
+  if (!TRACE_On(port)) return 0;
+  for (; len - i >= 4; i = (uint16_t)(i + 4u))
+    itm_packet(port, (uint32_t)p[i] | (uint32_t)p[i + 1] << 8 | (uint32_t)p[i + 2] << 16 | (uint32_t)p[i + 3] << 24, 4);
+  for (; i < len; ++i) itm_packet(port, p[i], 1);
+  return len;
+}
@@ -0,0 +1,30 @@
+/* main.c on the host: stand-ins for what it needs from hardware-only
+   modules, for tools that build the application itself (-Dmain=app_main).
+
+   Provides hi2c1 and huart2 and the MX_ init functions (I2C at
+   host_app_khz, USART2 at 9600 on host_ble_port), clock profiles (the I2C
+   peripheral runs in CLK_BURST only and the energy model is told),
+   MSI calibration, the stack monitor and heap counters (no-ops), and SWO:
+   every trace port is off except TRACE_PORT_I2C when host_swo is open,
+   which gets ITM source packets as a probe would capture them. Sleep and
+   time (TMR_Sleep, HAL_Delay, TMR_Micros, ...) are the tool's own. */
+#ifndef APP_HOST_H
+#define APP_HOST_H
+
+#include "stm32l1xx_hal.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern unsigned      host_app_khz;    /* I2C clock in CLK_BURST, default 400 */
+extern FILE         *host_swo;        /* SWO capture out, or NULL */
+extern USART_TypeDef host_ble_port;   /* USART2 */
+
+int app_main(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* APP_HOST_H */
@@ -0,0 +1,28 @@
+/* main.c's PN532 codecs, see codecs.h. Built with -Dmain=app_main. */
+#include "../../main.c"
+#include "codecs.h"
+
+bool codec_main_send(const uint8_t *payload, uint8_t plen)
+{
+  return pn532_send(payload, plen);
+}
+
+bool codec_main_write_cmd(const uint8_t *payload, uint8_t plen)
+{
+  return pn532_write_cmd(payload, plen);
+}
+
+uint8_t codec_main_parse(const uint8_t *frame, uint32_t size, uint8_t *buf, uint8_t max)
+{
+  return pn532_parse_frame(frame, size, buf, max);
+}
+
+uint8_t codec_main_read_resp(uint8_t *buf, uint8_t max)
+{
+  return pn532_read_resp(buf, max, false);
+}
+
+uint8_t codec_main_read_uid(uint8_t brty, uint8_t *uid, uint8_t max_uid)
+{
+  return pn532_read_uid(brty, uid, max_uid);
+}
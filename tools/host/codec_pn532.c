@@ -0,0 +1,18 @@
+/* pn532.c's frame codecs, see codecs.h */
+#include "../../ble_status_test/Core/Src/pn532.c"
+#include "codecs.h"
+
+bool codec_pn532_write(uint8_t cmd, const uint8_t *data, uint8_t len)
+{
+  return write_command(cmd, data, len);
+}
+
+bool codec_pn532_ack(void)
+{
+  return read_ack(50);
+}
+
+uint16_t codec_pn532_read_resp(uint8_t *out, uint16_t out_max)
+{
+  return read_response(out, out_max, 100);
+}
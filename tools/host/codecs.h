@@ -0,0 +1,33 @@
+/* The PN532 frame codecs of main.c and pn532.c, which are static there,
+   for host benchmarks and fuzzing. codec_main.c and codec_pn532.c each
+   compile one of the files unmodified and export thin wrappers; the
+   transfers they make go to the host I2C device (host_i2c_device()). */
+#ifndef CODECS_H
+#define CODECS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* main.c: pn532_send(), pn532_write_cmd() (send + ACK), pn532_parse_frame(),
+   pn532_read_resp() (ready poll, 6-byte header read, 72-byte frame read),
+   pn532_read_uid() (one InListPassiveTarget round) */
+bool    codec_main_send(const uint8_t *payload, uint8_t plen);
+bool    codec_main_write_cmd(const uint8_t *payload, uint8_t plen);
+uint8_t codec_main_parse(const uint8_t *frame, uint32_t size, uint8_t *buf, uint8_t max);
+uint8_t codec_main_read_resp(uint8_t *buf, uint8_t max);
+uint8_t codec_main_read_uid(uint8_t brty, uint8_t *uid, uint8_t max_uid);
+
+/* pn532.c: write_command(), read_ack(), read_response(); the UID path is
+   the public PN532_ReadPassiveTargetA() */
+bool     codec_pn532_write(uint8_t cmd, const uint8_t *data, uint8_t len);
+bool     codec_pn532_ack(void);
+uint16_t codec_pn532_read_resp(uint8_t *out, uint16_t out_max);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CODECS_H */
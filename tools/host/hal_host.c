@@ -0,0 +1,483 @@
+/* Host (Linux) implementation of the HAL subset in stm32l1xx_hal.h.
+   Time is the real monotonic clock, or the virtual one; UART and I2C
+   transfers block for the wire time of their bytes at the programmed rate,
+   like the blocking HAL calls on the MCU do. Signal handlers stand in for
+   interrupts, so PRIMASK masks signals. */
+#define _GNU_SOURCE
+#include "stm32l1xx_hal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+uint32_t host_eeprom[512];
+RCC_TypeDef host_rcc = { RCC_CSR_PORRSTF };
+
+static bool     t_virtual;
+static uint64_t t_now;          /* virtual time, us */
+
+static volatile sig_atomic_t irq_off;
+static uint32_t in_event;
+
+/* Pending events, soonest first */
+#define HOST_EVENTS 64
+
+static struct {
+  uint64_t at;
+  void   (*fn)(void *arg);
+  void    *arg;
+} ev[HOST_EVENTS];
+static int n_ev;
+
+/* Run the first event if it is due by t and interrupts are on */
+static bool run_one(uint64_t t)
+{
+  void (*fn)(void *);
+  void *arg;
+
+  if (irq_off || !n_ev || ev[0].at > t) return false;
+  if (ev[0].at > t_now) t_now = ev[0].at;
+  fn  = ev[0].fn;
+  arg = ev[0].arg;
+  memmove(&ev[0], &ev[1], (size_t)--n_ev * sizeof(ev[0]));
+  irq_off = 1;
+  in_event++;
+  fn(arg);
+  in_event--;
+  irq_off = 0;
+  return true;
+}
+
+static uint64_t now_us(void)
+{
+  struct timespec ts;
+  if (t_virtual) return t_now;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint64_t t_origin;
+
+static void sleep_us(uint64_t us)
+{
+  struct timespec ts = { (time_t)(us / 1000000u), (long)(us % 1000000u) * 1000 };
+
+  if (t_virtual) {
+    uint64_t until = t_now + us;
+    while (run_one(until)) { }
+    t_now = until;
+    return;
+  }
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) { }
+}
+
+/* ---- Host time ---- */
+
+void host_time_virtual(void)
+{
+  t_virtual = true;
+  t_now     = 0;
+  t_origin  = 0;
+}
+
+uint64_t host_time_us(void)
+{
+  return now_us() - t_origin;
+}
+
+void host_time_advance(uint64_t us)
+{
+  sleep_us(us);
+}
+
+void host_at(uint64_t at_us, void (*fn)(void *arg), void *arg)
+{
+  int i = n_ev;
+
+  if (n_ev == HOST_EVENTS) {
+    fprintf(stderr, "hal_host: event queue full\n");
+    abort();
+  }
+  while (i > 0 && ev[i - 1].at > at_us) {
+    ev[i] = ev[i - 1];
+    i--;
+  }
+  ev[i].at  = at_us;
+  ev[i].fn  = fn;
+  ev[i].arg = arg;
+  n_ev++;
+}
+
+uint64_t host_next_at(void)
+{
+  return n_ev ? ev[0].at : UINT64_MAX;
+}
+
+bool host_time_sleep(uint64_t until_us)
+{
+  if (run_one(until_us)) return true;
+  if (until_us > t_now) t_now = until_us;
+  return run_one(t_now);
+}
+
+/* ---- PRIMASK ---- */
+
+static sigset_t irq_saved;
+
+uint32_t __get_PRIMASK(void)
+{
+  return (uint32_t)irq_off;
+}
+
+void __disable_irq(void)
+{
+  sigset_t all;
+  if (irq_off) return;
+  sigfillset(&all);
+  sigprocmask(SIG_BLOCK, &all, &irq_saved);
+  irq_off = 1;
+}
+
+void __enable_irq(void)
+{
+  if (!irq_off) return;
+  irq_off = 0;
+  sigprocmask(SIG_SETMASK, &irq_saved, NULL);
+  if (t_virtual) while (run_one(t_now)) { }      /* what came in while masked */
+}
+
+void __set_PRIMASK(uint32_t m)
+{
+  if (m) __disable_irq(); else __enable_irq();
+}
+
+uint32_t __get_IPSR(void)
+{
+  return in_event ? 16u : 0u;
+}
+
+__attribute__((weak)) void NVIC_SystemReset(void)
+{
+  fprintf(stderr, "hal_host: NVIC_SystemReset\n");
+  exit(3);
+}
+
+/* ---- RCC ---- */
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+  (void)RCC_OscInitStruct;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency)
+{
+  (void)RCC_ClkInitStruct;
+  (void)FLatency;
+  return HAL_OK;
+}
+
+/* ---- Core ---- */
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+  if (!t_virtual) t_origin = now_us();
+  return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void)
+{
+  if (!t_origin && !t_virtual) t_origin = now_us();
+  return (uint32_t)((now_us() - t_origin) / 1000u);
+}
+
+__attribute__((weak)) void HAL_Delay(uint32_t Delay)
+{
+  sleep_us((uint64_t)Delay * 1000u);
+}
+
+/* ---- UART ---- */
+
+static speed_t to_speed(uint32_t baud)
+{
+  switch (baud) {
+  case 9600:   return B9600;
+  case 19200:  return B19200;
+  case 38400:  return B38400;
+  case 57600:  return B57600;
+  case 115200: return B115200;
+  case 230400: return B230400;
+  default:     return B0;
+  }
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+  struct termios t;
+  speed_t sp;
+
+  if (!huart || !huart->Instance) return HAL_ERROR;
+  sp = to_speed(huart->Init.BaudRate);
+  if (sp == B0) return HAL_ERROR;
+  if (huart->Instance->peer) return HAL_OK;
+  if (tcgetattr(huart->Instance->fd, &t) != 0) return HAL_ERROR;
+  cfmakeraw(&t);
+  if (huart->Init.HwFlowCtl & UART_HWCONTROL_RTS_CTS) t.c_iflag |= IXON;
+  cfsetispeed(&t, sp);
+  cfsetospeed(&t, sp);
+  if (tcsetattr(huart->Instance->fd, TCSANOW, &t) != 0) return HAL_ERROR;
+  /* DMA transfers must not stall the caller while CTS is held */
+  return (fcntl(huart->Instance->fd, F_SETFL, fcntl(huart->Instance->fd, F_GETFL) | O_NONBLOCK) == 0)
+         ? HAL_OK : HAL_ERROR;
+}
+
+/* 8N1: ten bit times per byte */
+static uint64_t wire_us(const UART_HandleTypeDef *huart, uint16_t n)
+{
+  return (uint64_t)n * 10u * 1000000u / huart->Init.BaudRate;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+  uint16_t done = 0;
+  (void)Timeout;
+
+  if (huart->Instance->peer) {
+    huart->Instance->peer(huart->Instance->ctx, pData, Size, huart->Init.BaudRate);
+    done = Size;
+  }
+  while (done < Size) {
+    ssize_t n = write(huart->Instance->fd, pData + done, Size - done);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN) continue;
+      return HAL_ERROR;
+    }
+    done += (uint16_t)n;
+  }
+  sleep_us(wire_us(huart, Size));
+  return HAL_OK;
+}
+
+__attribute__((weak)) void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+  (void)huart;
+}
+
+static void tx_done(void *arg)
+{
+  UART_HandleTypeDef *huart = arg;
+
+  huart->Instance->tx_busy = false;
+  HAL_UART_TxCpltCallback(huart);
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+  HAL_StatusTypeDef st;
+
+  if (huart->Instance->peer && t_virtual) {
+    if (huart->Instance->tx_busy) return HAL_BUSY;
+    huart->Instance->tx_busy = true;
+    huart->Instance->peer(huart->Instance->ctx, pData, Size, huart->Init.BaudRate);
+    host_at(t_now + wire_us(huart, Size), tx_done, huart);
+    return HAL_OK;
+  }
+  if (huart->Instance->peer) {
+    st = HAL_UART_Transmit(huart, pData, Size, 0);
+    if (st == HAL_OK) HAL_UART_TxCpltCallback(huart);
+    return st;
+  }
+  if (huart->Instance->tx_busy) return HAL_BUSY;
+  huart->Instance->tx_busy = true;
+  huart->Instance->tx_ptr  = pData;
+  huart->Instance->tx_left = Size;
+  host_uart_poll(huart);
+  return HAL_OK;
+}
+
+void host_uart_poll(UART_HandleTypeDef *huart)
+{
+  USART_TypeDef *u = huart->Instance;
+  int saved = errno;
+  uint64_t t = now_us();
+
+  if (!u->tx_busy || u->peer) return;
+  while (u->tx_left) {
+    ssize_t n = write(u->fd, u->tx_ptr, u->tx_left);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && errno == EAGAIN) {             /* output stopped: CTS held */
+      if (!u->tx_held_since) u->tx_held_since = t;
+      errno = saved;
+      return;
+    }
+    if (n <= 0) break;                          /* gone: what is left is lost */
+    if (u->tx_held_since) {
+      u->tx_held_us   += t - u->tx_held_since;
+      u->tx_held_since = 0;
+    }
+    if (u->tx_end < t) u->tx_end = t;
+    u->tx_end  += wire_us(huart, (uint16_t)n);
+    u->tx_ptr  += n;
+    u->tx_left -= (uint16_t)n;
+  }
+  errno = saved;
+  if (u->tx_left == 0 && t < u->tx_end) return;
+  u->tx_left = 0;
+  u->tx_busy = false;
+  HAL_UART_TxCpltCallback(huart);
+}
+
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+  USART_TypeDef *u = huart->Instance;
+  uint32_t t0 = HAL_GetTick();
+  uint16_t got = 0;
+
+  if (u->peer) {
+    uint64_t until = t_now + (uint64_t)Timeout * 1000u;
+    while (got < Size) {
+      if (u->rx_tail != u->rx_head) {
+        pData[got++] = u->rx[u->rx_tail];
+        u->rx_tail = (uint16_t)((u->rx_tail + 1u) % sizeof(u->rx));
+        continue;
+      }
+      if (t_now >= until) return HAL_TIMEOUT;
+      (void)host_time_sleep(until);
+    }
+    return HAL_OK;
+  }
+  while (got < Size) {
+    uint32_t spent = HAL_GetTick() - t0;
+    struct pollfd p = { huart->Instance->fd, POLLIN, 0 };
+    int left = (spent >= Timeout) ? 0 : (int)(Timeout - spent);
+
+    if (poll(&p, 1, left) <= 0 || !(p.revents & POLLIN)) return HAL_TIMEOUT;
+    ssize_t n = read(huart->Instance->fd, pData + got, Size - got);
+    if (n <= 0) return HAL_ERROR;
+    got += (uint16_t)n;
+  }
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+  if (!huart->Instance->peer || !Size) return HAL_ERROR;
+  huart->Instance->dma_buf  = pData;
+  huart->Instance->dma_size = Size;
+  huart->Instance->dma_pos  = 0;
+  return HAL_OK;
+}
+
+__attribute__((weak)) void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+  (void)huart;
+  (void)Size;
+}
+
+__attribute__((weak)) void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+  (void)huart;
+}
+
+void host_uart_peer(UART_HandleTypeDef *huart, HostUartFn fn, void *ctx)
+{
+  huart->Instance->peer = fn;
+  huart->Instance->ctx  = ctx;
+}
+
+void host_uart_rx(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t len)
+{
+  USART_TypeDef *u = huart->Instance;
+
+  for (uint16_t i = 0; i < len; ++i) {
+    if (u->dma_buf) {
+      u->dma_buf[u->dma_pos++] = data[i];
+      if (u->dma_pos == u->dma_size) {
+        HAL_UARTEx_RxEventCallback(huart, u->dma_size);
+        u->dma_pos = 0;
+      }
+      continue;
+    }
+    uint16_t next = (uint16_t)((u->rx_head + 1u) % sizeof(u->rx));
+    if (next == u->rx_tail) break;                  /* overrun: the rest is lost */
+    u->rx[u->rx_head] = data[i];
+    u->rx_head = next;
+  }
+  if (u->dma_buf && u->dma_pos) HAL_UARTEx_RxEventCallback(huart, u->dma_pos);
+}
+
+/* ---- I2C ---- */
+
+static HostI2cFn i2c_fn;
+static void     *i2c_ctx;
+static uint64_t  i2c_busy;
+
+void host_i2c_device(HostI2cFn fn, void *ctx)
+{
+  i2c_fn  = fn;
+  i2c_ctx = ctx;
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
+{
+  return (hi2c && hi2c->Init.ClockSpeed) ? HAL_OK : HAL_ERROR;
+}
+
+/* START and address byte with its ACK bit; the device answers there, so a
+   NACK ends the transfer. Then the data bytes with theirs, and STOP. */
+static HAL_StatusTypeDef i2c_xfer(I2C_HandleTypeDef *hi2c, uint16_t addr, bool rx, uint8_t *data, uint16_t len)
+{
+  uint32_t hz = hi2c->Init.ClockSpeed;
+  HAL_StatusTypeDef st;
+  uint64_t us;
+
+  if (!hz) return HAL_ERROR;
+  us = 10u * 1000000u / hz;
+  sleep_us(us);
+  i2c_busy += us;
+  st = i2c_fn ? i2c_fn(i2c_ctx, addr, rx, data, len) : HAL_ERROR;
+  us = ((st == HAL_OK) ? 9u * (uint64_t)len + 1u : 1u) * 1000000u / hz;
+  sleep_us(us);
+  i2c_busy += us;
+  return st;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+  (void)Timeout;
+  return i2c_xfer(hi2c, DevAddress, false, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+  (void)Timeout;
+  return i2c_xfer(hi2c, DevAddress, true, pData, Size);
+}
+
+uint64_t host_i2c_busy_us(void)
+{
+  return i2c_busy;
+}
+
+/* ---- Data EEPROM ---- */
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Unlock(void) { return HAL_OK; }
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Lock(void)   { return HAL_OK; }
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Program(uint32_t TypeProgram, uint32_t Address, uint32_t Data)
+{
+  /* Address arrives truncated to 32 bits; only the offset matters */
+  uint32_t off = Address - (uint32_t)FLASH_EEPROM_BASE;
+
+  if (TypeProgram != FLASH_TYPEPROGRAMDATA_WORD || (off & 3u) || off >= sizeof(host_eeprom))
+    return HAL_ERROR;
+  host_eeprom[off / 4u] = Data;
+  return HAL_OK;
+}
@@ -0,0 +1,380 @@
+/* PN532 I2C transcript replay, see i2c_replay.h */
+#include "i2c_replay.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static I2cRec_t *add_rec(I2cReplay_t *r)
+{
+  if (r->nrec == r->cap) {
+    uint32_t cap = r->cap ? r->cap * 2u : 1024u;
+    I2cRec_t *p = realloc(r->rec, cap * sizeof(*p));
+    if (!p) return NULL;
+    r->rec = p;
+    r->cap = cap;
+  }
+  memset(&r->rec[r->nrec], 0, sizeof(r->rec[0]));
+  return &r->rec[r->nrec++];
+}
+
+static int hexbytes(const char *s, uint8_t *out, int max)
+{
+  int n = 0;
+  unsigned v;
+
+  while (n < max && s[0] && s[1] && sscanf(s, "%2x", &v) == 1) {
+    out[n++] = (uint8_t)v;
+    s += 2;
+  }
+  return n;
+}
+
+/* "I2C <t> <R|W> <len> <st> <dur> <rep> <hex>"; 1 taken, 0 not one, -1 bad */
+static int dump_line(I2cReplay_t *r, const char *p, uint32_t no, const char *path)
+{
+  unsigned long t;
+  unsigned len, st, dur, rep;
+  char dir;
+  int off = 0;
+  I2cRec_t one;
+
+  if (sscanf(p, "%lu %c %u %u %u %u %n", &t, &dir, &len, &st, &dur, &rep, &off) != 6) return 0;
+  if ((dir != 'R' && dir != 'W') || !rep) return -1;
+  memset(&one, 0, sizeof(one));
+  one.t_us = (uint32_t)t;
+  one.rx   = dir == 'R';
+  one.len  = (uint16_t)len;
+  one.st   = (uint8_t)(st & 3u);
+  one.line = no;
+  one.have = (uint16_t)hexbytes(p + off, one.data, I2C_REPLAY_BYTES);
+  if (one.st == HAL_OK && one.have < len) {
+    fprintf(stderr, "%s:%u: %u of %u bytes; a trace dump, not a recording\n", path, no, one.have, len);
+    return -1;
+  }
+  /* Folded status polls: one record each */
+  for (unsigned i = 0; i < rep; ++i) {
+    I2cRec_t *e = add_rec(r);
+    if (!e) return -1;
+    *e = one;
+  }
+  return 1;
+}
+
+static void add_uid(I2cReplay_t *r, const uint8_t *uid, uint8_t len, bool prefix, uint32_t no)
+{
+  I2cUid_t *u;
+
+  if (!len || r->nuids >= I2C_REPLAY_UIDS) return;
+  u = &r->uids[r->nuids++];
+  memcpy(u->uid, uid, len);
+  u->len    = len;
+  u->prefix = prefix;
+  u->line   = no;
+}
+
+/* ---- Saleae Logic 2 I2C export ---- */
+
+enum { COL_TYPE, COL_TIME, COL_ACK, COL_ADDR, COL_READ, COL_DATA, COL_N };
+
+typedef struct {
+  int       col[COL_N];
+  bool      open, ours;
+  double    t0;
+  I2cRec_t *cur;
+} Csv_t;
+
+/* Split a CSV line in place; quotes are dropped */
+static int fields(char *s, char **f, int max)
+{
+  int n = 0;
+
+  while (n < max) {
+    char *w = s;
+    f[n++] = s;
+    while (*s && *s != ',' && *s != '\r' && *s != '\n') {
+      if (*s != '"') *w++ = *s;
+      s++;
+    }
+    if (*s != ',') { *w = 0; break; }
+    *w = 0;
+    s++;
+  }
+  return n;
+}
+
+static bool csv_header(Csv_t *c, char *line)
+{
+  static const char *const k_names[COL_N] = { "type", "start_time", "ack", "address", "read", "data" };
+  char *f[16];
+  int n = fields(line, f, 16);
+
+  for (int k = 0; k < COL_N; ++k) {
+    c->col[k] = -1;
+    for (int i = 0; i < n; ++i)
+      if (!strcmp(f[i], k_names[k])) c->col[k] = i;
+  }
+  return c->col[COL_TYPE] >= 0 && c->col[COL_TIME] >= 0 && c->col[COL_ADDR] >= 0 && c->col[COL_DATA] >= 0;
+}
+
+static int csv_row(I2cReplay_t *r, Csv_t *c, char *line, uint32_t no)
+{
+  char *f[16];
+  int n = fields(line, f, 16);
+  const char *type;
+  double t;
+
+#define COL(k) (c->col[k] >= 0 && c->col[k] < n ? f[c->col[k]] : "")
+  type = COL(COL_TYPE);
+  t    = atof(COL(COL_TIME));
+  if (!strcmp(type, "start")) {
+    c->open = true;
+    c->ours = false;
+    c->t0   = t;
+    c->cur  = NULL;
+  } else if (!strcmp(type, "address") && c->open) {
+    unsigned a = (unsigned)strtoul(COL(COL_ADDR), NULL, 0);
+    c->ours = (a == 0x24u || (a & ~1u) == 0x48u);
+    if (!c->ours) return 1;
+    if (!(c->cur = add_rec(r))) return -1;
+    c->cur->t_us = (uint32_t)(c->t0 * 1e6);
+    c->cur->rx   = a == 0x49u || !strcmp(COL(COL_READ), "true");
+    c->cur->st   = (c->col[COL_ACK] >= 0 && strcmp(COL(COL_ACK), "true")) ? HAL_ERROR : HAL_OK;
+    c->cur->line = no;
+  } else if (!strcmp(type, "data") && c->ours && c->cur) {
+    if (c->cur->have < I2C_REPLAY_BYTES) c->cur->data[c->cur->have++] = (uint8_t)strtoul(COL(COL_DATA), NULL, 0);
+    c->cur->len++;
+  } else if (!strcmp(type, "stop")) {
+    c->open = false;
+    c->cur  = NULL;
+  }
+#undef COL
+  return 1;
+}
+
+/* The frame clock: one sample per frame read */
+static void clk_stop(I2cReplay_t *r)
+{
+  uint64_t dt;
+  I2cCpu_t *k = r->clk_kind;
+
+  if (!r->clk_ns) return;
+  dt = now_ns() - r->clk_ns;
+  dt = dt > r->clk_cost ? dt - r->clk_cost : 0;
+  r->clk_ns = 0;
+  if (k->n++ == 0 || dt < k->min) k->min = dt;
+  if (dt > k->max) k->max = dt;
+  k->sum += dt;
+}
+
+static void clk_start(I2cReplay_t *r, const uint8_t *d, uint16_t n)
+{
+  uint16_t i = 1;
+
+  if (n < 7 || !(d[0] & 0x01)) return;
+  while (i + 2u < n && !(d[i] == 0x00 && d[i + 1] == 0x00 && d[i + 2] == 0xFF)) i++;
+  if (i + 4u >= n) return;
+  if (d[i + 3] == 0x00 && d[i + 4] == 0xFF) {
+    r->clk_kind = &r->cpu_ack;
+  } else if ((uint8_t)(d[i + 3] + d[i + 4]) == 0 && i + 5u + d[i + 3] + 2u <= n) {
+    r->clk_kind = &r->cpu_resp;
+  } else {
+    return;                       /* header only: the frame is in the next read */
+  }
+  r->clk_ns = now_ns();
+}
+
+/* "W 12 000000FF.." into buf; the bytes of writes only */
+static int xfer_text(char *buf, size_t size, bool rx, const uint8_t *data, uint16_t len)
+{
+  int w = snprintf(buf, size, "%c %u%s", rx ? 'R' : 'W', len, rx ? "" : " ");
+
+  for (uint16_t i = 0; !rx && i < len && i < 16u && (size_t)w + 3u < size; ++i)
+    w += snprintf(buf + w, size - (size_t)w, "%02X", data[i]);
+  return w;
+}
+
+static void diverge(I2cReplay_t *r, const I2cRec_t *e, bool rx, const uint8_t *data, uint16_t len)
+{
+  char got[48], want[48];
+
+  r->diverged = true;
+  r->end_us   = host_time_us();
+  xfer_text(got, sizeof(got), rx, data, len);
+  if (!e) {
+    snprintf(r->why, sizeof(r->why), "the end of the transcript: driver %s", got);
+    return;
+  }
+  xfer_text(want, sizeof(want), e->rx, e->data, e->len);
+  snprintf(r->why, sizeof(r->why), "line %u: recorded %s, driver %s", e->line, want, got);
+}
+
+static bool is_poll(const I2cRec_t *e)
+{
+  return e->rx && e->len == 1u && (e->st != HAL_OK || !(e->data[0] & 0x01));
+}
+
+static HAL_StatusTypeDef xfer(void *ctx, uint16_t addr, bool rx, uint8_t *data, uint16_t len)
+{
+  I2cReplay_t *r = ctx;
+  uint64_t now = host_time_us();
+  const I2cRec_t *e;
+  uint32_t k;
+
+  clk_stop(r);
+  if (addr != (0x24u << 1)) return HAL_ERROR;
+  if (r->diverged || r->pos >= r->tail) {
+    r->extra++;
+    return HAL_ERROR;
+  }
+
+  /* Skip the polls ahead to the next transfer that is not one */
+  for (k = r->pos; k < r->nrec && is_poll(&r->rec[k]); ++k) { }
+
+  if (rx && len == 1u) {
+    r->polls++;
+    if (k < r->nrec && r->rec[k].rx && r->rec[k].len == 1u) {
+      /* The recorded ready poll: ready once the recorded wait is over */
+      if (now - r->anchor_host < (uint32_t)(r->rec[k].t_us - r->anchor_rec)) {
+        data[0] = 0x00;
+        return HAL_OK;
+      }
+    } else {
+      /* The recording gave up polling; so far the driver has not */
+      data[0] = 0x00;
+      return HAL_OK;
+    }
+  }
+
+  if (k >= r->nrec) {
+    diverge(r, NULL, rx, data, len);
+    return HAL_ERROR;
+  }
+  e = &r->rec[k];
+  if (e->rx != rx || (e->st == HAL_OK && e->len != len) ||
+      (!rx && e->st == HAL_OK && memcmp(e->data, data, len))) {
+    diverge(r, e, rx, data, len);
+    return HAL_ERROR;
+  }
+  r->pos         = k + 1u;
+  r->matched++;
+  r->anchor_host = now;
+  r->anchor_rec  = e->t_us;
+  if (r->pos >= r->tail) r->end_us = now;
+  if (e->st != HAL_OK) return (HAL_StatusTypeDef)e->st;
+  if (rx) {
+    memcpy(data, e->data, len);
+    clk_start(r, data, len);
+  }
+  return HAL_OK;
+}
+
+/* ---------------- Public API ---------------- */
+
+int i2c_replay_load(I2cReplay_t *r, const char *path)
+{
+  FILE *f = fopen(path, "r");
+  char line[1024];
+  uint32_t no = 0;
+  Csv_t csv = { .open = false };
+  bool is_csv = false;
+
+  memset(r, 0, sizeof(*r));
+  if (!f) { perror(path); return -1; }
+  while (fgets(line, sizeof(line), f)) {
+    const char *p;
+    int res = 1;
+
+    no++;
+    if (no == 1 && !strncmp(line, "name,type,start_time", 20)) {
+      if (!(is_csv = csv_header(&csv, line))) res = -1;
+      csv.open = false;
+    } else if (is_csv) {
+      res = csv_row(r, &csv, line, no);
+    } else if ((p = strstr(line, "I2C ")) && strncmp(p + 4, "BEGIN", 5) && strncmp(p + 4, "END", 3)) {
+      res = dump_line(r, p + 4, no, path);
+    } else if ((p = strstr(line, "UID:"))) {
+      uint8_t uid[10];
+      add_uid(r, uid, (uint8_t)hexbytes(p + 4, uid, 10), false, no);
+    } else if ((p = strstr(line, "[ev ] uid "))) {
+      uint8_t uid[3];
+      add_uid(r, uid, (uint8_t)hexbytes(p + 10, uid, 3), true, no);
+    }
+    if (res < 0) {
+      fprintf(stderr, "%s:%u: bad line: %s", path, no, line);
+      fclose(f);
+      return -1;
+    }
+  }
+  fclose(f);
+  if (!r->nrec) {
+    fprintf(stderr, "%s: no PN532 transfers\n", path);
+    return -1;
+  }
+  r->anchor_rec = r->rec[0].t_us;
+  for (r->tail = r->nrec; r->tail && is_poll(&r->rec[r->tail - 1u]); --r->tail) { }
+
+  r->clk_cost = UINT64_MAX;
+  for (int i = 0; i < 1000; ++i) {
+    uint64_t a = now_ns(), b = now_ns();
+    if (b - a < r->clk_cost) r->clk_cost = b - a;
+  }
+  return 0;
+}
+
+void i2c_replay_attach(I2cReplay_t *r)
+{
+  r->anchor_host = host_time_us();
+  host_i2c_device(xfer, r);
+}
+
+void i2c_replay_uid(I2cReplay_t *r, const uint8_t *uid, uint8_t len)
+{
+  const I2cUid_t *u;
+
+  if (r->uid_pos >= r->nuids) {
+    if (r->nuids) r->uid_bad++;         /* more than recorded */
+    return;
+  }
+  u = &r->uids[r->uid_pos++];
+  if ((u->prefix ? len >= u->len : len == u->len) && !memcmp(u->uid, uid, u->len)) r->uid_ok++;
+  else r->uid_bad++;
+}
+
+void i2c_replay_idle(I2cReplay_t *r)
+{
+  clk_stop(r);
+}
+
+bool i2c_replay_over(const I2cReplay_t *r)
+{
+  return r->diverged || r->pos >= r->tail;
+}
+
+int i2c_replay_report(const I2cReplay_t *r, FILE *out)
+{
+  static const char *const k_kind[2] = { "ACK", "response" };
+  const I2cCpu_t *cpu[2] = { &r->cpu_ack, &r->cpu_resp };
+  bool ok = !r->diverged && r->pos >= r->tail && !r->uid_bad && r->uid_ok == r->nuids;
+
+  fprintf(out, "replay: %u transfers matched up to record %u of %u (%u status polls answered), %u refused after\n",
+          r->matched, r->pos, r->nrec, r->polls, r->extra);
+  if (r->diverged) fprintf(out, "replay: driver went another way at %s\n", r->why);
+  else if (r->pos < r->tail) fprintf(out, "replay: stopped at line %u\n", r->rec[r->pos].line);
+  if (r->nuids)
+    fprintf(out, "replay: UIDs %u of %u as recorded, %u different\n", r->uid_ok, r->nuids, r->uid_bad);
+  for (int i = 0; i < 2; ++i)
+    if (cpu[i]->n)
+      fprintf(out, "replay: %-8s frames %u, host ns per frame min %llu avg %.0f max %llu\n", k_kind[i],
+              cpu[i]->n, (unsigned long long)cpu[i]->min, (double)cpu[i]->sum / cpu[i]->n,
+              (unsigned long long)cpu[i]->max);
+  fprintf(out, "replay: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
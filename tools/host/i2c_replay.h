@@ -0,0 +1,113 @@
+/* Replay of a recorded PN532 I2C transcript on the host I2C bus
+   (host_i2c_device()), in place of the emulator.
+
+   A transcript is what the firmware or a logic analyser saw on the bus:
+     - "I2C <t_us> <R|W> <len> <status> <dur_us> <repeats> <hex>" lines, as
+       in the firmware's trace dumps (i2c_trace.h) but with every byte: the
+       SWO stream on TRACE_PORT_I2C decoded by tools/swo_decode.c. Anything
+       before "I2C" on a line (timestamps, prefixes) is skipped; dump lines
+       with only the first bytes of a frame are refused.
+     - "UID:<hex>" lines and swo_decode "[ev ] uid XXXXXX.." events: the UIDs
+       the firmware reported, in order (an event gives the first 3 bytes).
+     - or a Saleae Logic 2 I2C analyser export (CSV with a "name,type,
+       start_time,..." header); transfers to other addresses are skipped.
+   Everything else is ignored.
+
+   The driver under test must make the same transfers in the same order:
+   direction, length and, for writes, every byte. Reads get the recorded
+   bytes and HAL status. Status polls are the exception, since how often
+   the driver polls depends on its delays: busy or NACKed 1-byte reads are
+   answered busy until as much time has passed since the last matched
+   transfer as had in the recording, then the recorded ready read is
+   served. The first difference stops the comparison and is reported with
+   the transcript line. After the last record every transfer NACKs.
+
+   Each read that returned a whole frame starts a host clock that stops at
+   the driver's next transfer or at i2c_replay_idle(): the host time the
+   driver spent on that frame (checks, parsing, deciding what next). */
+#ifndef I2C_REPLAY_H
+#define I2C_REPLAY_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef I2C_REPLAY_BYTES
+#define I2C_REPLAY_BYTES  96     /* longest transfer kept */
+#endif
+#ifndef I2C_REPLAY_UIDS
+#define I2C_REPLAY_UIDS   256
+#endif
+
+typedef struct {
+  uint32_t t_us;
+  uint16_t len;                  /* requested */
+  uint16_t have;                 /* bytes captured */
+  uint8_t  rx;
+  uint8_t  st;                   /* HAL_StatusTypeDef */
+  uint32_t line;                 /* in the transcript */
+  uint8_t  data[I2C_REPLAY_BYTES];
+} I2cRec_t;
+
+typedef struct {
+  uint8_t  uid[10];
+  uint8_t  len;
+  bool     prefix;               /* only the first len bytes are known */
+  uint32_t line;
+} I2cUid_t;
+
+/* Host ns per frame, by kind */
+typedef struct {
+  uint32_t n;
+  uint64_t sum, min, max;
+} I2cCpu_t;
+
+typedef struct {
+  I2cRec_t *rec;
+  uint32_t  nrec, cap, pos;
+  uint32_t  tail;                /* records from here on are all polls */
+  I2cUid_t  uids[I2C_REPLAY_UIDS];
+  uint32_t  nuids, uid_pos;
+
+  uint64_t  anchor_host;         /* host time of the last matched transfer */
+  uint32_t  anchor_rec;          /* ... and its recorded time */
+  bool      diverged;
+  char      why[200];            /* the first difference */
+  uint64_t  end_us;              /* host time the replay ran out or diverged */
+
+  uint32_t  matched, polls, extra;
+  uint32_t  uid_ok, uid_bad;
+  I2cCpu_t  cpu_ack, cpu_resp;
+  uint64_t  clk_ns;              /* frame clock start, 0 = stopped */
+  I2cCpu_t *clk_kind;
+  uint64_t  clk_cost;            /* back-to-back clock reads, subtracted */
+} I2cReplay_t;
+
+/* Load a transcript; 0, or -1 with a message on stderr */
+int  i2c_replay_load(I2cReplay_t *r, const char *path);
+
+/* Become the device on the host I2C bus */
+void i2c_replay_attach(I2cReplay_t *r);
+
+/* The driver reported a UID: compare with the next recorded one */
+void i2c_replay_uid(I2cReplay_t *r, const uint8_t *uid, uint8_t len);
+
+/* The driver is done with the frame it read (went idle, returned) */
+void i2c_replay_idle(I2cReplay_t *r);
+
+/* Transcript used up, or the driver went another way */
+bool i2c_replay_over(const I2cReplay_t *r);
+
+/* Outcome and frame times; returns 0 if the driver made the recorded
+   decisions, 1 if not */
+int  i2c_replay_report(const I2cReplay_t *r, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* I2C_REPLAY_H */
@@ -0,0 +1,299 @@
+/* Emulated PN532, see pn532_emu.h */
+#include "pn532_emu.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define NEVER  UINT64_MAX
+
+enum { ST_IDLE = 0, ST_ACK, ST_RESP };
+
+static const uint8_t k_ack[6] = { 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00 };
+
+void pn532_emu_init(Pn532Emu_t *e)
+{
+  memset(e, 0, sizeof(*e));
+  e->t.wake_us = 2000;
+  e->t.ack_us  = 600;
+  e->t.fw_us   = 1200;
+  e->t.sam_us  = 1000;
+  e->t.list_us = 3500;
+  e->t.miss_us = 0;
+  e->asleep    = true;
+}
+
+/* 00 00 FF LEN LCS payload DCS 00 as the pending frame */
+static void put_frame(Pn532Emu_t *e, const uint8_t *p, uint8_t n)
+{
+  uint8_t dcs = 0;
+  uint8_t w = 0;
+
+  e->frame[w++] = 0x00;
+  e->frame[w++] = 0x00;
+  e->frame[w++] = 0xFF;
+  e->frame[w++] = n;
+  e->frame[w++] = (uint8_t)(~n + 1);
+  for (uint8_t i = 0; i < n; ++i) {
+    e->frame[w++] = p[i];
+    dcs += p[i];
+  }
+  e->frame[w++] = (uint8_t)(~dcs + 1);
+  e->frame[w++] = 0x00;
+  e->frame_len = w;
+  if (e->corrupt_left) {
+    e->corrupt_left--;
+    e->frame[w - 2] ^= 0xFF;
+  }
+  memcpy(e->last, e->frame, w);
+  e->last_len = w;
+}
+
+const Pn532Card_t *pn532_emu_card_at(const Pn532Emu_t *e, uint64_t now_us)
+{
+  for (int i = 0; i < e->ncards; ++i)
+    if (now_us >= e->cards[i].from_us && now_us < e->cards[i].to_us) return &e->cards[i];
+  return NULL;
+}
+
+/* The first card to enter the field after now */
+static const Pn532Card_t *next_card(const Pn532Emu_t *e, uint64_t now_us)
+{
+  const Pn532Card_t *c = NULL;
+
+  for (int i = 0; i < e->ncards; ++i)
+    if (e->cards[i].from_us > now_us && (!c || e->cards[i].from_us < c->from_us)) c = &e->cards[i];
+  return c;
+}
+
+static void list_resp(Pn532Emu_t *e, const Pn532Card_t *c)
+{
+  uint8_t r[20] = { 0xD5, 0x4B, 0x00 };
+  uint8_t n = 3;
+
+  if (c) {
+    r[2]   = 0x01;                            /* NbTg */
+    r[n++] = 0x01;                            /* Tg */
+    r[n++] = 0x00;                            /* ATQA */
+    r[n++] = (c->len == 4) ? 0x04 : 0x44;
+    r[n++] = (c->len == 4) ? 0x08 : 0x00;     /* SAK */
+    r[n++] = c->len;
+    memcpy(&r[n], c->uid, c->len);
+    n = (uint8_t)(n + c->len);
+    e->st.hits++;
+  }
+  put_frame(e, r, n);
+}
+
+/* ACK read: run the command; its response is ready after the delay */
+static void run(Pn532Emu_t *e, uint64_t now)
+{
+  static const uint8_t k_fw[]  = { 0xD5, 0x03, 0x32, 0x01, 0x06, 0x07 };
+  static const uint8_t k_sam[] = { 0xD5, 0x15 };
+  static const uint8_t k_err[] = { 0x7F };
+
+  e->state = ST_RESP;
+  switch (e->cmd) {
+  case 0x02:
+    put_frame(e, k_fw, sizeof(k_fw));
+    e->ready_at = now + e->t.fw_us;
+    break;
+  case 0x14:
+    put_frame(e, k_sam, sizeof(k_sam));
+    e->ready_at = now + e->t.sam_us;
+    break;
+  case 0x4A: {
+    const Pn532Card_t *c = (e->brty == 0x00) ? pn532_emu_card_at(e, now) : NULL;
+
+    e->st.lists++;
+    if (c) {
+      list_resp(e, c);
+      e->ready_at = now + e->t.list_us;
+    } else if (e->t.miss_us) {
+      list_resp(e, NULL);
+      e->ready_at = now + e->t.miss_us;
+    } else {
+      c = (e->brty == 0x00) ? next_card(e, now) : NULL;
+      list_resp(e, c);
+      e->ready_at = c ? c->from_us + e->t.list_us : NEVER;
+    }
+    break;
+  }
+  default:
+    put_frame(e, k_err, sizeof(k_err));
+    e->ready_at = now + e->t.fw_us;
+    break;
+  }
+}
+
+static void apply_faults(Pn532Emu_t *e, uint64_t now)
+{
+  for (int i = 0; i < e->nfaults; ++i) {
+    Pn532Fault_t *f = &e->faults[i];
+
+    if (f->done || f->at_us > now) continue;
+    f->done = true;
+    if (f->kind == PN532_EMU_NACK)         e->nack_left    = (uint16_t)(e->nack_left + f->count);
+    else if (f->kind == PN532_EMU_CORRUPT) e->corrupt_left = (uint16_t)(e->corrupt_left + f->count);
+    else {
+      e->asleep = true;
+      e->state  = ST_IDLE;
+    }
+  }
+}
+
+/* A host frame: command, ACK (abort) or NACK (send the response again) */
+static void host_frame(Pn532Emu_t *e, const uint8_t *d, uint16_t len, uint64_t now)
+{
+  uint16_t i = 0;
+  uint8_t n, sum = 0;
+
+  while (i + 1u < len && !(d[i] == 0x00 && d[i + 1] == 0xFF)) i++;
+  if (i + 3u >= len) goto bad;
+  n = d[i + 2];
+  if (n == 0x00 && d[i + 3] == 0xFF) {
+    if (e->state != ST_IDLE) e->st.aborts++;
+    e->state = ST_IDLE;
+    return;
+  }
+  if (n == 0xFF && d[i + 3] == 0x00) {
+    if (!e->last_len) return;
+    memcpy(e->frame, e->last, e->last_len);
+    e->frame_len = e->last_len;
+    e->state     = ST_RESP;
+    e->ready_at  = now;
+    return;
+  }
+  if ((uint8_t)(n + d[i + 3]) != 0 || n < 2 || i + 4u + n + 1u > len) goto bad;
+  for (uint8_t k = 0; k <= n; ++k) sum += d[i + 4 + k];
+  if (sum != 0 || d[i + 4] != 0xD4) goto bad;
+
+  e->st.cmds++;
+  e->cmd  = d[i + 5];
+  e->brty = (e->cmd == 0x4A && n >= 4) ? d[i + 7] : 0x00;
+  memcpy(e->frame, k_ack, sizeof(k_ack));
+  e->frame_len = sizeof(k_ack);
+  e->state     = ST_ACK;
+  e->ready_at  = now + e->t.ack_us;
+  return;
+bad:
+  e->st.bad_frames++;
+}
+
+static HAL_StatusTypeDef xfer(void *ctx, uint16_t addr, bool rx, uint8_t *data, uint16_t len)
+{
+  Pn532Emu_t *e = ctx;
+  uint64_t now = host_time_us();
+  bool ready;
+
+  if (addr != (0x24u << 1)) return HAL_ERROR;
+  apply_faults(e, now);
+  if (e->asleep) {
+    e->asleep   = false;
+    e->awake_at = now + e->t.wake_us;
+  }
+  if (now < e->awake_at || e->nack_left) {
+    if (e->nack_left) e->nack_left--;
+    e->st.nacks++;
+    return HAL_ERROR;
+  }
+  e->st.bytes += len;
+
+  if (!rx) {
+    e->st.writes++;
+    host_frame(e, data, len, now);
+    return HAL_OK;
+  }
+
+  e->st.reads++;
+  ready = e->state != ST_IDLE && now >= e->ready_at;
+  if (len == 1) {
+    e->st.status_polls++;
+    if (!ready) e->st.busy_polls++;
+  }
+  memset(data, 0, len);
+  if (!len) return HAL_OK;
+  data[0] = ready ? 0x01 : 0x00;
+  if (!ready || len == 1) return HAL_OK;
+  memcpy(&data[1], e->frame, (len - 1u < e->frame_len) ? len - 1u : e->frame_len);
+  if (e->state == ST_ACK) run(e, now);
+  return HAL_OK;
+}
+
+/* ---------------- Public API ---------------- */
+
+void pn532_emu_attach(Pn532Emu_t *e)
+{
+  host_i2c_device(xfer, e);
+}
+
+bool pn532_emu_card(Pn532Emu_t *e, uint64_t from_us, uint64_t to_us, const uint8_t *uid, uint8_t len)
+{
+  Pn532Card_t *c;
+
+  if (e->ncards >= PN532_EMU_CARDS || !len || len > sizeof(c->uid)) return false;
+  c = &e->cards[e->ncards++];
+  c->from_us = from_us;
+  c->to_us   = to_us ? to_us : NEVER;
+  c->len     = len;
+  memcpy(c->uid, uid, len);
+  return true;
+}
+
+bool pn532_emu_fault(Pn532Emu_t *e, uint64_t at_us, Pn532FaultKind_t kind, uint16_t count)
+{
+  Pn532Fault_t *f;
+
+  if (e->nfaults >= PN532_EMU_FAULTS) return false;
+  f = &e->faults[e->nfaults++];
+  f->at_us = at_us;
+  f->kind  = (uint8_t)kind;
+  f->count = count;
+  f->done  = false;
+  return true;
+}
+
+int pn532_emu_line(Pn532Emu_t *e, const char *line)
+{
+  char word[16], hex[32], field[8];
+  double a, b;
+  unsigned n;
+  int off = 0;
+
+  while (*line == ' ' || *line == '\t') line++;
+  if (!*line || *line == '#' || *line == '\n' || *line == '\r') return 1;
+  if (sscanf(line, "%15s %n", word, &off) != 1) return 1;
+  line += off;
+
+  if (!strcmp(word, "card")) {
+    uint8_t uid[10];
+    uint8_t len = 0;
+
+    if (sscanf(line, "%lf %lf %31s", &a, &b, hex) != 3) return -1;
+    for (const char *p = hex; p[0] && p[1] && len < sizeof(uid); p += 2) {
+      if (sscanf(p, "%2x", &n) != 1) return -1;
+      uid[len++] = (uint8_t)n;
+    }
+    return pn532_emu_card(e, (uint64_t)(a * 1000.0), (uint64_t)(b * 1000.0), uid, len) ? 1 : -1;
+  }
+  if (!strcmp(word, "nack") || !strcmp(word, "corrupt")) {
+    if (sscanf(line, "%lf %u", &a, &n) != 2) return -1;
+    return pn532_emu_fault(e, (uint64_t)(a * 1000.0), word[0] == 'n' ? PN532_EMU_NACK : PN532_EMU_CORRUPT,
+                           (uint16_t)n) ? 1 : -1;
+  }
+  if (!strcmp(word, "sleep")) {
+    if (sscanf(line, "%lf", &a) != 1) return -1;
+    return pn532_emu_fault(e, (uint64_t)(a * 1000.0), PN532_EMU_SLEEP, 0) ? 1 : -1;
+  }
+  if (!strcmp(word, "timing")) {
+    if (sscanf(line, "%7s %u", field, &n) != 2) return -1;
+    if      (!strcmp(field, "wake")) e->t.wake_us = n;
+    else if (!strcmp(field, "ack"))  e->t.ack_us  = n;
+    else if (!strcmp(field, "fw"))   e->t.fw_us   = n;
+    else if (!strcmp(field, "sam"))  e->t.sam_us  = n;
+    else if (!strcmp(field, "list")) e->t.list_us = n;
+    else if (!strcmp(field, "miss")) e->t.miss_us = n;
+    else return -1;
+    return 1;
+  }
+  return 0;
+}
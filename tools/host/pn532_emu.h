@@ -0,0 +1,121 @@
+/* Emulated PN532 on the host I2C bus (host_i2c_device()).
+
+   Speaks the host-controller protocol of UM0701 over I2C: every read starts
+   with the status byte (bit 0 = ready) and, once ready, returns the pending
+   frame from its first byte; commands are normal information frames,
+   checked for LEN/LCS/DCS and answered with ACK, then with the response
+   after a processing delay. The host's own ACK frame aborts a command, its
+   NACK frame asks for the last response again. An invalid frame is ignored,
+   like the chip does.
+
+   Implemented: GetFirmwareVersion, SAMConfiguration and InListPassiveTarget
+   (one ISO14443A target); anything else gets the syntax error frame. Cards
+   are scripted as time windows in the field. Timing runs on host time, so
+   on the virtual clock the chip's delays and the bus wire time make up a
+   deterministic timeline. */
+#ifndef PN532_EMU_H
+#define PN532_EMU_H
+
+#include "stm32l1xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef PN532_EMU_CARDS
+#define PN532_EMU_CARDS   256
+#endif
+#ifndef PN532_EMU_FAULTS
+#define PN532_EMU_FAULTS  32
+#endif
+
+/* Chip delays, us. Estimates for a PN532 v1.6; measure and override. */
+typedef struct {
+  uint32_t wake_us;     /* asleep: the first transfer NACKs and wakes it */
+  uint32_t ack_us;      /* command written to ACK ready */
+  uint32_t fw_us;       /* ACK read to response ready, per command */
+  uint32_t sam_us;
+  uint32_t list_us;     /* InListPassiveTarget with a card in the field */
+  uint32_t miss_us;     /* ... without one: 0 waits for a card (MxRtyPassiveActivation 0xFF) */
+} Pn532Timing_t;
+
+typedef struct {
+  uint64_t from_us, to_us;   /* in the field for [from, to) */
+  uint8_t  uid[10];
+  uint8_t  len;
+} Pn532Card_t;
+
+typedef enum {
+  PN532_EMU_NACK = 0,   /* the next n transfers NACK their address */
+  PN532_EMU_CORRUPT,    /* the next n response frames go out with a bad DCS */
+  PN532_EMU_SLEEP,      /* the chip is asleep again (power glitch) */
+} Pn532FaultKind_t;
+
+typedef struct {
+  uint64_t at_us;
+  uint8_t  kind;        /* Pn532FaultKind_t */
+  uint16_t count;
+  bool     done;
+} Pn532Fault_t;
+
+typedef struct {
+  uint32_t writes, reads, status_polls, busy_polls;
+  uint32_t nacks;        /* transfers NACKed: asleep or injected */
+  uint32_t bad_frames;   /* host frames that did not check out */
+  uint32_t aborts;       /* commands cancelled by a host ACK */
+  uint32_t cmds, lists, hits;
+  uint64_t bytes;        /* data bytes both ways */
+} Pn532EmuStats_t;
+
+typedef struct {
+  Pn532Timing_t t;
+  Pn532Card_t   cards[PN532_EMU_CARDS];
+  int           ncards;
+  Pn532Fault_t  faults[PN532_EMU_FAULTS];
+  int           nfaults;
+
+  /* chip state */
+  bool     asleep;
+  uint64_t awake_at;
+  uint8_t  state;          /* internal */
+  uint8_t  cmd;            /* command in progress */
+  uint8_t  brty;
+  uint64_t ready_at;       /* ACK or response ready */
+  uint8_t  frame[64];      /* pending frame, without the status byte */
+  uint8_t  frame_len;
+  uint8_t  last[64];       /* last response, for a host NACK */
+  uint8_t  last_len;
+  uint16_t nack_left, corrupt_left;
+
+  Pn532EmuStats_t st;
+} Pn532Emu_t;
+
+/* Defaults: asleep, no cards, the timing above */
+void pn532_emu_init(Pn532Emu_t *e);
+
+/* Become the device on the host I2C bus */
+void pn532_emu_attach(Pn532Emu_t *e);
+
+bool pn532_emu_card(Pn532Emu_t *e, uint64_t from_us, uint64_t to_us, const uint8_t *uid, uint8_t len);
+bool pn532_emu_fault(Pn532Emu_t *e, uint64_t at_us, Pn532FaultKind_t kind, uint16_t count);
+
+/* One script line; times in ms, UID in hex:
+     card <from> <to> <uid>        a card in the field (to = 0: for good)
+     nack <at> <count>
+     corrupt <at> <count>
+     sleep <at>
+     timing <field> <us>           wake, ack, fw, sam, list or miss
+   Returns 1 if the line was taken, 0 if it is not a PN532 line (so callers
+   can mix in their own), -1 if it is one but malformed. Blank lines and
+   '#' comments are taken. */
+int pn532_emu_line(Pn532Emu_t *e, const char *line);
+
+/* The card in the field at host time now, or NULL */
+const Pn532Card_t *pn532_emu_card_at(const Pn532Emu_t *e, uint64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* PN532_EMU_H */
@@ -0,0 +1,221 @@
+/* Host (Linux) stand-in for the STM32L1 HAL.
+   Only the types and calls the Core/ modules use are provided. UART handles
+   carry a file descriptor (a pty, usually) or an in-process peer instead of
+   a register block, and I2C transfers go to an emulated device
+   (host_i2c_device()), so driver code can be compiled unmodified against
+   emulated peripherals. Time is the monotonic clock, or a virtual one that
+   only moves when something takes time (host_time_virtual()); on it,
+   host_at() events play the interrupts. */
+#ifndef HOST_STM32L1XX_HAL_H
+#define HOST_STM32L1XX_HAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define __IO volatile
+#define __weak __attribute__((weak))
+#define __NO_RETURN __attribute__((__noreturn__))
+
+typedef enum {
+  HAL_OK      = 0x00U,
+  HAL_ERROR   = 0x01U,
+  HAL_BUSY    = 0x02U,
+  HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+/* ---- UART ---- */
+
+/* In-process peer (virtual time): called as a transmission starts, with the
+   rate it goes out at; byte i is on the other end 10 * (i + 1) bit times
+   later. */
+typedef void (*HostUartFn)(void *ctx, const uint8_t *data, uint16_t len, uint32_t baud);
+
+typedef struct {
+  int fd;                     /* pty / tty the "wire" is attached to */
+  HostUartFn peer;            /* or this, see host_uart_peer() */
+  void      *ctx;
+  uint8_t    rx[256];         /* received, for HAL_UART_Receive */
+  uint16_t   rx_head, rx_tail;
+  uint8_t   *dma_buf;         /* HAL_UARTEx_ReceiveToIdle_DMA, circular */
+  uint16_t   dma_size, dma_pos;
+  bool       tx_busy;
+  const uint8_t *tx_ptr;      /* fd: DMA bytes not yet taken by the pty */
+  uint16_t   tx_left;
+  uint64_t   tx_end;          /* when the last byte taken is off the wire */
+  uint64_t   tx_held_since;   /* CTS holding the transfer since, 0 = not */
+  uint64_t   tx_held_us;      /* total time CTS held transfers */
+} USART_TypeDef;
+
+typedef struct {
+  uint32_t BaudRate;
+  uint32_t WordLength;
+  uint32_t StopBits;
+  uint32_t Parity;
+  uint32_t Mode;
+  uint32_t HwFlowCtl;
+  uint32_t OverSampling;
+} UART_InitTypeDef;
+
+typedef struct __UART_HandleTypeDef {
+  USART_TypeDef    *Instance;
+  UART_InitTypeDef  Init;
+} UART_HandleTypeDef;
+
+#define UART_WORDLENGTH_8B    0x00000000U
+#define UART_STOPBITS_1       0x00000000U
+#define UART_PARITY_NONE      0x00000000U
+#define UART_MODE_TX_RX       0x0000000CU
+#define UART_HWCONTROL_NONE   0x00000000U
+#define UART_HWCONTROL_RTS_CTS 0x00000300U
+#define UART_OVERSAMPLING_16  0x00000000U
+
+/* A pty has no modem lines, so with UART_HWCONTROL_RTS_CTS the far end
+   carries CTS in band: XOFF (0x13) deasserts it, XON (0x11) asserts it,
+   and the kernel stops our output in between (IXON on the fd). */
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+/* On a fd, the bytes go out as the pty takes them and the transfer
+   completes (HAL_UART_TxCpltCallback) from host_uart_poll() once they are
+   off the wire; call that from the tool's interrupt stand-in. */
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+void host_uart_poll(UART_HandleTypeDef *huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+/* Circular: a burst is followed by the idle event (Size = DMA position),
+   with one at the wrap (Size = buffer size) on the way */
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+
+/* Virtual time only: attach a peer instead of a fd, and hand bytes to the
+   receiver (from a host_at() event, as they finish arriving). With a peer,
+   HAL_UART_Transmit_DMA completes from an event after the wire time. */
+void host_uart_peer(UART_HandleTypeDef *huart, HostUartFn fn, void *ctx);
+void host_uart_rx(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t len);
+
+/* ---- I2C: master transfers to one emulated device ---- */
+typedef struct {
+  int unused;
+} I2C_TypeDef;
+
+typedef struct {
+  uint32_t ClockSpeed;        /* SCL, Hz; 0 = peripheral off */
+  uint32_t DutyCycle;
+  uint32_t OwnAddress1;
+  uint32_t AddressingMode;
+  uint32_t DualAddressMode;
+  uint32_t OwnAddress2;
+  uint32_t GeneralCallMode;
+  uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef struct __I2C_HandleTypeDef {
+  I2C_TypeDef     *Instance;
+  I2C_InitTypeDef  Init;
+} I2C_HandleTypeDef;
+
+/* The device is called once the address byte is on the wire: it fills or
+   takes the data and returns HAL_OK, or HAL_ERROR to NACK the address.
+   addr is the 8-bit (shifted) address. */
+typedef HAL_StatusTypeDef (*HostI2cFn)(void *ctx, uint16_t addr, bool rx, uint8_t *data, uint16_t len);
+void host_i2c_device(HostI2cFn fn, void *ctx);
+uint64_t host_i2c_busy_us(void);   /* bus time of all transfers so far */
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+
+/* ---- Data EEPROM (backed by host RAM) ---- */
+extern uint32_t host_eeprom[512];
+#define FLASH_EEPROM_BASE           ((uintptr_t)host_eeprom)
+#define FLASH_TYPEPROGRAMDATA_WORD  (0x02U)
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Unlock(void);
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Lock(void);
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Program(uint32_t TypeProgram, uint32_t Address, uint32_t Data);
+
+/* ---- Cortex-M intrinsics: signal handlers (or host_at() events) play
+   the interrupts, so PRIMASK blocks signals and defers events ---- */
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t m);
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_IPSR(void);    /* nonzero inside a host_at() event */
+#define __DMB()  __sync_synchronize()
+#define __WFI()  ((void)0)
+#define __CLZ(x) ((uint8_t)((x) ? __builtin_clz(x) : 32))
+void NVIC_SystemReset(void);  /* weak; exits */
+
+/* ---- RCC, PWR: what SystemClock_Config() and the reset flags need ---- */
+typedef struct {
+  volatile uint32_t CSR;
+} RCC_TypeDef;
+extern RCC_TypeDef host_rcc;
+#define RCC                 (&host_rcc)
+#define RCC_CSR_RMVF        (1UL << 24)
+#define RCC_CSR_PORRSTF     (1UL << 27)
+
+typedef struct {
+  uint32_t PLLState, PLLSource, PLLMUL, PLLDIV;
+} RCC_PLLInitTypeDef;
+
+typedef struct {
+  uint32_t OscillatorType, HSEState, LSEState, HSIState, HSICalibrationValue;
+  uint32_t LSIState, MSIState, MSICalibrationValue, MSIClockRange;
+  RCC_PLLInitTypeDef PLL;
+} RCC_OscInitTypeDef;
+
+typedef struct {
+  uint32_t ClockType, SYSCLKSource, AHBCLKDivider, APB1CLKDivider, APB2CLKDivider;
+} RCC_ClkInitTypeDef;
+
+#define RCC_OSCILLATORTYPE_MSI        0x00000010U
+#define RCC_MSI_ON                    0x00000001U
+#define RCC_MSIRANGE_5                0x0000A000U
+#define RCC_PLL_NONE                  0x00000000U
+#define RCC_CLOCKTYPE_SYSCLK          0x00000001U
+#define RCC_CLOCKTYPE_HCLK            0x00000002U
+#define RCC_CLOCKTYPE_PCLK1           0x00000004U
+#define RCC_CLOCKTYPE_PCLK2           0x00000008U
+#define RCC_SYSCLKSOURCE_MSI          0x00000000U
+#define RCC_SYSCLK_DIV1               0x00000000U
+#define RCC_HCLK_DIV1                 0x00000000U
+#define FLASH_LATENCY_0               0x00000000U
+#define PWR_REGULATOR_VOLTAGE_SCALE1  0x00000800U
+#define __HAL_PWR_VOLTAGESCALING_CONFIG(r)  ((void)(r))
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct);
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency);
+
+/* ---- Core ---- */
+HAL_StatusTypeDef HAL_Init(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+/* ---- Host time ----
+   After host_time_virtual() the clock starts at 0 and moves only through
+   host_time_advance(): HAL_Delay() (weak, so a build can bring its own),
+   and the wire time of UART and I2C transfers, advance it instead of
+   sleeping. Runs are then deterministic and as fast as the host allows.
+   Events due on the way run in order, as interrupts: not while PRIMASK is
+   set, and with it set while they run. */
+void     host_time_virtual(void);
+uint64_t host_time_us(void);
+void     host_time_advance(uint64_t us);
+
+void     host_at(uint64_t at_us, void (*fn)(void *arg), void *arg);
+uint64_t host_next_at(void);             /* UINT64_MAX: none */
+
+/* WFI: advance to until_us, or less if an event runs on the way. Returns
+   true if one did. */
+bool     host_time_sleep(uint64_t until_us);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* HOST_STM32L1XX_HAL_H */
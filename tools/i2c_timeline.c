@@ -0,0 +1,169 @@
+/* PN532 I2C trace timeline.
+
+   Reads a diagnostics log (BLE, UART or the SWO text port, e.g. the output
+   of swo_decode) and picks out the I2C trace dumps the firmware writes on
+   "SET i2c 1" or after a streak of PN532 faults (i2c_trace.h). Every dump
+   is printed as a timeline relative to its first transaction, each entry
+   annotated with what it means in the PN532 host protocol: status polls,
+   ACK/NACK, command and response frames by name, and anything malformed.
+   Other log lines are ignored.
+
+   Build: cc -O2 -Wall -o i2c_timeline tools/i2c_timeline.c
+   Run:   ./i2c_timeline log.txt [--gap-ms 20]
+          ./swo_decode capture.bin | ./i2c_timeline */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const struct { uint8_t code; const char *name; } k_cmds[] = {
+  { 0x00, "Diagnose" },            { 0x02, "GetFirmwareVersion" },
+  { 0x04, "GetGeneralStatus" },    { 0x06, "ReadRegister" },
+  { 0x08, "WriteRegister" },       { 0x0C, "ReadGPIO" },
+  { 0x0E, "WriteGPIO" },           { 0x10, "SetSerialBaudRate" },
+  { 0x12, "SetParameters" },       { 0x14, "SAMConfiguration" },
+  { 0x16, "PowerDown" },           { 0x32, "RFConfiguration" },
+  { 0x58, "RFRegulationTest" },    { 0x56, "InJumpForDEP" },
+  { 0x46, "InJumpForPSL" },        { 0x4A, "InListPassiveTarget" },
+  { 0x50, "InATR" },               { 0x4E, "InPSL" },
+  { 0x40, "InDataExchange" },      { 0x42, "InCommunicateThru" },
+  { 0x44, "InDeselect" },          { 0x52, "InRelease" },
+  { 0x54, "InSelect" },            { 0x60, "InAutoPoll" },
+  { 0x8C, "TgInitAsTarget" },      { 0x92, "TgSetGeneralBytes" },
+  { 0x86, "TgGetData" },           { 0x8E, "TgSetData" },
+  { 0x94, "TgSetMetaData" },       { 0x88, "TgGetInitiatorCommand" },
+  { 0x90, "TgResponseToInitiator" }, { 0x8A, "TgGetTargetStatus" },
+};
+
+static const char *const k_status[4] = { "OK", "ERROR", "BUSY", "TIMEOUT" };
+
+static double gap_ms = 20.0;
+static unsigned dumps, entries, bad;
+
+static const char *cmd_name(uint8_t code)
+{
+  for (size_t i = 0; i < sizeof(k_cmds) / sizeof(k_cmds[0]); ++i)
+    if (k_cmds[i].code == code) return k_cmds[i].name;
+  return "?";
+}
+
+/* Normal frame header at p: 00 00 FF LEN LCS TFI CMD (need = bytes known) */
+static void frame(char *out, size_t size, const uint8_t *p, int have, int dir_tfi)
+{
+  if (have < 5 || p[0] != 0x00 || p[1] != 0x00 || p[2] != 0xFF) {
+    snprintf(out, size, "no frame start");
+    bad++;
+    return;
+  }
+  if (p[3] == 0x00 && p[4] == 0xFF) { snprintf(out, size, "ACK"); return; }
+  if (p[3] == 0xFF && p[4] == 0x00) { snprintf(out, size, "NACK"); return; }
+  if ((uint8_t)(p[3] + p[4]) != 0) {
+    snprintf(out, size, "bad LCS (LEN %u)", p[3]);
+    bad++;
+    return;
+  }
+  if (have < 6) { snprintf(out, size, "frame LEN %u", p[3]); return; }
+  if (p[3] == 0x01 && p[5] == 0x7F) { snprintf(out, size, "error frame"); return; }
+  if (p[5] != dir_tfi) {
+    snprintf(out, size, "unexpected TFI %02X (LEN %u)", p[5], p[3]);
+    bad++;
+    return;
+  }
+  if (have < 7) { snprintf(out, size, "frame LEN %u", p[3]); return; }
+  if (dir_tfi == 0xD4)
+    snprintf(out, size, "cmd %s (%02X) LEN %u", cmd_name(p[6]), p[6], p[3]);
+  else
+    snprintf(out, size, "resp %s (%02X) LEN %u", cmd_name((uint8_t)(p[6] - 1u)), p[6], p[3]);
+}
+
+static void annotate(char *out, size_t size, char dir, unsigned len, unsigned st,
+                     const uint8_t *d, int have)
+{
+  if (st != 0) { snprintf(out, size, "transfer failed"); bad++; return; }
+  if (dir == 'W') {
+    /* pn532_send(): one 00 preamble byte ahead of the 00 FF start code */
+    if (have >= 1 && d[0] == 0x00) frame(out, size, d + 1, have - 1, 0xD4);
+    else frame(out, size, d, have, 0xD4);
+    return;
+  }
+  if (have < 1) { snprintf(out, size, "?"); return; }
+  if (len == 1) { snprintf(out, size, (d[0] & 0x01) ? "ready" : "busy"); return; }
+  if (!(d[0] & 0x01)) { snprintf(out, size, "read while busy"); bad++; return; }
+  frame(out, size, d + 1, have - 1, 0xD5);
+}
+
+static int hexbytes(const char *s, uint8_t *out, int max)
+{
+  int n = 0;
+  while (n < max && s[0] && s[1]) {
+    unsigned v;
+    if (sscanf(s, "%2x", &v) != 1) break;
+    out[n++] = (uint8_t)v;
+    s += 2;
+  }
+  return n;
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = NULL;
+  FILE *in;
+  char line[512];
+  int in_dump = 0;
+  uint32_t t_first = 0, t_end_prev = 0;
+  int first = 1;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--gap-ms") && i + 1 < argc) gap_ms = atof(argv[++i]);
+    else if (argv[i][0] != '-' || !strcmp(argv[i], "-")) path = argv[i];
+    else { fprintf(stderr, "usage: %s [file|-] [--gap-ms N]\n", argv[0]); return 2; }
+  }
+  in = (!path || !strcmp(path, "-")) ? stdin : fopen(path, "r");
+  if (!in) { perror(path); return 1; }
+
+  while (fgets(line, sizeof(line), in)) {
+    char *p = strstr(line, "I2C ");
+    unsigned long t;
+    char dir;
+    unsigned len, st, dur, rep;
+    int off = 0;
+
+    if (!p) continue;
+    p += 4;
+    if (!strncmp(p, "BEGIN", 5)) {
+      dumps++;
+      in_dump = 1;
+      first = 1;
+      p[strcspn(p, "\r\n")] = 0;
+      printf("\n=== dump %u:%s\n", dumps, p + 5);
+      printf("%10s %9s %-3s %4s %8s  %s\n", "t ms", "+gap ms", "dir", "len", "us", "meaning");
+      continue;
+    }
+    if (!strncmp(p, "END", 3)) {
+      in_dump = 0;
+      continue;
+    }
+    if (!in_dump) continue;
+    if (sscanf(p, "%lu %c %u %u %u %u %n", &t, &dir, &len, &st, &dur, &rep, &off) != 6) continue;
+
+    uint8_t d[32];
+    char what[96];
+    int have = hexbytes(p + off, d, (int)sizeof(d));
+    uint32_t t32 = (uint32_t)t;
+    double gap;
+
+    if (first) { t_first = t32; t_end_prev = t32; first = 0; }
+    gap = (double)(int32_t)(t32 - t_end_prev) / 1000.0;
+    annotate(what, sizeof(what), dir, len, st & 3u, d, have);
+    if (gap >= gap_ms) printf("%10s %9s     ... %.1f ms idle\n", "", "", gap);
+    printf("%10.3f %9.3f %-3c %4u %8u  %s%s", (double)(uint32_t)(t32 - t_first) / 1000.0, gap, dir,
+           len, dur, st ? k_status[st & 3u] : "", st ? " " : "");
+    printf("%s", what);
+    if (rep > 1) printf("  x%u (last %u us)", rep, dur);
+    printf("\n");
+    entries++;
+    t_end_prev = (rep > 1) ? t32 : t32 + dur;     /* folded polls: end unknown */
+  }
+  fprintf(stderr, "i2c_timeline: %u dumps, %u transactions, %u anomalies\n", dumps, entries, bad);
+  return 0;
+}
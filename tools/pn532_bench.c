@@ -0,0 +1,175 @@
+/* PN532 driver benchmark on virtual time.
+
+   Runs the firmware's pn532.c on the host against the emulated PN532
+   (tools/host/pn532_emu.h) on the virtual clock: HAL_Delay and the wire
+   time of every I2C transfer at --khz advance it, and the chip answers
+   after its modelled processing delays. Nothing depends on the speed of
+   the PC, so two runs give the same numbers and a driver change shows up
+   as a difference in them.
+
+   Sequence: PN532_Begin until it succeeds (the chip starts asleep), one
+   PN532_GetFirmwareVersion, then --polls calls of PN532_ReadPassiveTargetA
+   --gap-ms apart. By default a card with --uid sits in the field for the
+   whole run; --script replaces that with card windows and faults
+   (pn532_emu_line() format). For each operation: count, failures, virtual
+   time min/avg/max, and per call the bus time, transfers, status polls and
+   bytes.
+
+   --replay plays a recorded bus transcript to the driver instead
+   (tools/host/i2c_replay.h): the same sequence runs until the transcript
+   is used up, and the exit status says whether the driver made the
+   recorded transfers and found the recorded UIDs.
+
+   Build: cc -O2 -Wall -Itools/host -Ible_status_test/Core/Inc -o pn532_bench \
+             tools/pn532_bench.c ble_status_test/Core/Src/pn532.c \
+             tools/host/pn532_emu.c tools/host/i2c_replay.c tools/host/hal_host.c
+   Run:   ./pn532_bench [--khz 100|400] [--polls 100] [--gap-ms 0] [--timeout-ms 100]
+                        [--uid 04A1B2C3] [--script cards.txt] [--replay recording.txt] */
+#include "pn532.h"
+#include "pn532_emu.h"
+#include "i2c_replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+I2C_HandleTypeDef hi2c1;
+static Pn532Emu_t emu;
+static I2cReplay_t replay;
+
+void Error_Handler(void)
+{
+  fprintf(stderr, "Error_Handler\n");
+  exit(1);
+}
+
+typedef struct {
+  const char *name;
+  uint32_t n, fail;
+  uint64_t min, max, sum;
+  uint64_t bus_us, xfers, polls, bytes;
+} Op_t;
+
+static Op_t ops[] = { { .name = "begin" }, { .name = "firmware" }, { .name = "poll" } };
+
+/* Run one call and charge its virtual time and bus traffic to op */
+#define MEASURE(op, call)                                                     \
+  do {                                                                        \
+    uint64_t t0 = host_time_us(), b0 = host_i2c_busy_us();                    \
+    Pn532EmuStats_t s0 = emu.st;                                              \
+    bool ok_ = (call);                                                        \
+    uint64_t dt = host_time_us() - t0;                                        \
+    (op)->n++;                                                                \
+    if (!ok_) (op)->fail++;                                                   \
+    if ((op)->n == 1 || dt < (op)->min) (op)->min = dt;                       \
+    if (dt > (op)->max) (op)->max = dt;                                       \
+    (op)->sum    += dt;                                                       \
+    (op)->bus_us += host_i2c_busy_us() - b0;                                  \
+    (op)->xfers  += (emu.st.reads + emu.st.writes + emu.st.nacks) -           \
+                    (s0.reads + s0.writes + s0.nacks);                        \
+    (op)->polls  += emu.st.status_polls - s0.status_polls;                    \
+    (op)->bytes  += emu.st.bytes - s0.bytes;                                  \
+  } while (0)
+
+static int load_script(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  char line[160];
+  int no = 0;
+
+  if (!f) { perror(path); return -1; }
+  while (fgets(line, sizeof(line), f)) {
+    no++;
+    if (pn532_emu_line(&emu, line) != 1) {
+      fprintf(stderr, "%s:%d: bad line\n", path, no);
+      fclose(f);
+      return -1;
+    }
+  }
+  fclose(f);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned khz = 100, polls = 100, gap_ms = 0, timeout_ms = 100;
+  const char *uid_hex = "04A1B2C3", *script = NULL, *rec = NULL;
+  uint8_t uid[10], ulen = 0;
+  uint32_t fw = 0;
+  unsigned hits = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--khz") && i + 1 < argc) khz = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--polls") && i + 1 < argc) polls = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--gap-ms") && i + 1 < argc) gap_ms = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--timeout-ms") && i + 1 < argc) timeout_ms = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--uid") && i + 1 < argc) uid_hex = argv[++i];
+    else if (!strcmp(argv[i], "--script") && i + 1 < argc) script = argv[++i];
+    else if (!strcmp(argv[i], "--replay") && i + 1 < argc) rec = argv[++i];
+    else {
+      fprintf(stderr, "usage: %s [--khz 100|400] [--polls N] [--gap-ms N] [--timeout-ms N]\n"
+                      "          [--uid HEX] [--script file] [--replay file]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  host_time_virtual();
+  HAL_Init();
+  hi2c1.Init.ClockSpeed = khz * 1000u;
+  pn532_emu_init(&emu);
+  pn532_emu_attach(&emu);
+  if (rec) {
+    if (i2c_replay_load(&replay, rec) < 0) return 1;
+    i2c_replay_attach(&replay);
+  } else if (script) {
+    if (load_script(script) < 0) return 1;
+  } else {
+    for (const char *p = uid_hex; p[0] && p[1] && ulen < sizeof(uid); p += 2) {
+      unsigned v;
+      if (sscanf(p, "%2x", &v) != 1) break;
+      uid[ulen++] = (uint8_t)v;
+    }
+    if (!pn532_emu_card(&emu, 0, 0, uid, ulen)) { fprintf(stderr, "bad --uid\n"); return 2; }
+  }
+
+  /* The chip NACKs while it wakes up; retry the way a caller would */
+  for (unsigned i = 0; i < 20; ++i) {
+    bool ok;
+    MEASURE(&ops[0], (ok = PN532_Begin()));
+    i2c_replay_idle(&replay);
+    if (ok) break;
+    HAL_Delay(1);
+  }
+  MEASURE(&ops[1], PN532_GetFirmwareVersion(&fw));
+  i2c_replay_idle(&replay);
+  if (rec) polls = UINT16_MAX;                      /* until the transcript is used up */
+  for (unsigned i = 0; i < polls && !(rec && i2c_replay_over(&replay)); ++i) {
+    uint8_t got[10], n = 0;
+    MEASURE(&ops[2], PN532_ReadPassiveTargetA(got, &n, (uint16_t)timeout_ms));
+    i2c_replay_idle(&replay);
+    if (n) {
+      hits++;
+      if (rec) i2c_replay_uid(&replay, got, n);
+    }
+    if (gap_ms) HAL_Delay(gap_ms);
+  }
+  if (rec) polls = ops[2].n;
+
+  printf("I2C %u kHz, firmware %08lX, %u/%u polls with a card, %.3f ms virtual\n", khz,
+         (unsigned long)fw, hits, polls, (double)host_time_us() / 1000.0);
+  printf("%-9s %6s %5s %9s %9s %9s %9s %6s %6s %6s\n", "op", "n", "fail", "min us", "avg us",
+         "max us", "bus us", "xfers", "polls", "bytes");
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+    const Op_t *o = &ops[i];
+    double n = o->n ? (double)o->n : 1.0;
+    if (!o->n) continue;
+    printf("%-9s %6u %5u %9llu %9.0f %9llu %9.0f %6.1f %6.1f %6.1f\n", o->name, o->n, o->fail,
+           (unsigned long long)o->min, (double)o->sum / n, (unsigned long long)o->max,
+           (double)o->bus_us / n, (double)o->xfers / n, (double)o->polls / n, (double)o->bytes / n);
+  }
+  if (rec) return i2c_replay_report(&replay, stdout);
+  printf("chip: %u cmds, %u aborts, %u bad frames, %u NACKs, %u of %u status polls busy\n",
+         emu.st.cmds, emu.st.aborts, emu.st.bad_frames, emu.st.nacks, emu.st.busy_polls,
+         emu.st.status_polls);
+  return 0;
+}
@@ -0,0 +1,216 @@
+/* Scheduler host test.
+
+   Runs the firmware's sched.c and tmr.c on the host. SIGALRM plays the
+   USART interrupt and posts HIGH calls at a fixed rate; periodic timers post
+   a NORMAL "card poll" that keeps the CPU busy for a while and a LOW
+   housekeeping call. TMR_Sleep() is provided here: it blocks signals, checks
+   for pending work and waits in ppoll(), which unblocks them atomically,
+   the way PRIMASK + WFI does on the MCU.
+
+   Checks that calls run in priority order, that a full queue drops and
+   counts instead of overwriting, and that no interrupt post is lost or
+   reordered under load; reports queue depth and post-to-run latency.
+
+   Build: cc -O2 -Wall -Itools/host -Ible_status_test/Core/Inc -o sched_sim \
+             tools/sched_sim.c ble_status_test/Core/Src/sched.c \
+             ble_status_test/Core/Src/tmr.c tools/host/hal_host.c
+   Run:   ./sched_sim [--secs 2] [--isr-us 250] [--poll-us 1000] */
+#define _GNU_SOURCE
+#include "sched.h"
+#include "tmr.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+void Error_Handler(void)
+{
+  fprintf(stderr, "Error_Handler\n");
+  exit(1);
+}
+
+static uint64_t now_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/* ---- host TMR_Sleep ---- */
+
+static uint64_t slept_us;
+
+void TMR_Sleep(uint32_t max_ms)
+{
+  sigset_t all, open;
+  struct timespec ts;
+  uint32_t ms;
+  uint64_t t0;
+
+  sigfillset(&all);
+  sigprocmask(SIG_BLOCK, &all, &open);
+  ms = TMR_NextDue(max_ms);
+  if (!TMR_WakePending() && ms) {
+    ts.tv_sec  = (time_t)(ms / 1000u);
+    ts.tv_nsec = (long)(ms % 1000u) * 1000000L;
+    t0 = now_us();
+    ppoll(NULL, 0, &ts, &open);
+    slept_us += now_us() - t0;
+  }
+  sigprocmask(SIG_SETMASK, &open, NULL);
+}
+
+/* ---- phase 1: ordering and overflow ---- */
+
+static char order[32];
+static int  order_n;
+
+static void record(void *arg)
+{
+  order[order_n++] = (char)(uintptr_t)arg;
+}
+
+static int check_order(void)
+{
+  static const struct { const char *tag; uint8_t prio; } posts[] = {
+    { "l", SCHED_PRIO_LOW }, { "n", SCHED_PRIO_NORMAL }, { "H", SCHED_PRIO_HIGH },
+    { "L", SCHED_PRIO_LOW }, { "h", SCHED_PRIO_HIGH },   { "N", SCHED_PRIO_NORMAL },
+  };
+  uint32_t drops0 = SCHED_Dropped();
+  int fail = 0;
+
+  for (size_t i = 0; i < sizeof(posts) / sizeof(posts[0]); ++i)
+    (void)SCHED_Post(record, (void *)(uintptr_t)posts[i].tag[0], posts[i].prio);
+  while (SCHED_RunOnce()) { }
+  order[order_n] = 0;
+  if (strcmp(order, "HhnNlL") != 0) {
+    printf("order: got %s, want HhnNlL\n", order);
+    fail = 1;
+  }
+
+  order_n = 0;
+  for (uint32_t i = 0; i < SCHED_QUEUE_LEN + 2u; ++i)
+    (void)SCHED_Post(record, (void *)(uintptr_t)('a' + i), SCHED_PRIO_LOW);
+  while (SCHED_RunOnce()) { }
+  if (SCHED_Dropped() - drops0 != 2u || order_n != (int)SCHED_QUEUE_LEN || order[0] != 'a') {
+    printf("overflow: ran %d, dropped %lu, want %u and 2\n", order_n,
+           (unsigned long)(SCHED_Dropped() - drops0), (unsigned)SCHED_QUEUE_LEN);
+    fail = 1;
+  }
+  printf("order/overflow: %s\n", fail ? "FAIL" : "ok");
+  return fail;
+}
+
+/* ---- phase 2: interrupt posts under load ---- */
+
+#define LAT_SLOTS 256u
+
+static volatile uint32_t isr_seq, isr_posted, isr_lost;
+static uint64_t isr_at[LAT_SLOTS];
+static uint32_t isr_ran, isr_gaps, isr_next;
+static uint64_t lat_max, lat_sum;
+static uint32_t poll_us = 1000, polls, chores;
+
+static void isr_task(void *arg)
+{
+  uint32_t seq = (uint32_t)(uintptr_t)arg;
+  uint64_t lat = now_us() - isr_at[seq % LAT_SLOTS];
+
+  if (seq < isr_next) isr_gaps++;                 /* reordered */
+  else isr_gaps += seq - isr_next;                /* skipped: must be a drop */
+  isr_next = seq + 1u;
+  isr_ran++;
+  lat_sum += lat;
+  if (lat > lat_max) lat_max = lat;
+}
+
+static void on_alarm(int sig)
+{
+  uint32_t seq = isr_seq++;
+  (void)sig;
+  isr_at[seq % LAT_SLOTS] = now_us();
+  if (SCHED_Post(isr_task, (void *)(uintptr_t)seq, SCHED_PRIO_HIGH)) isr_posted++;
+  else isr_lost++;
+}
+
+static void poll_task(void *arg)
+{
+  uint64_t t0 = now_us();
+  (void)arg;
+  while (now_us() - t0 < poll_us) { }             /* I2C transaction stand-in */
+  polls++;
+}
+
+static void chore_task(void *arg)
+{
+  (void)arg;
+  chores++;
+}
+
+static void poll_due(void *arg)  { (void)arg; (void)SCHED_Post(poll_task,  NULL, SCHED_PRIO_NORMAL); }
+static void chore_due(void *arg) { (void)arg; (void)SCHED_Post(chore_task, NULL, SCHED_PRIO_LOW); }
+
+int main(int argc, char **argv)
+{
+  uint32_t secs = 2, isr_us = 250;
+  Tmr_t poll_tmr, chore_tmr;
+  struct itimerval it;
+  uint64_t t0, run_us;
+  int fail;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--secs") && i + 1 < argc)         secs    = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--isr-us") && i + 1 < argc)  isr_us  = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--poll-us") && i + 1 < argc) poll_us = (uint32_t)atoi(argv[++i]);
+    else { fprintf(stderr, "usage: %s [--secs N] [--isr-us N] [--poll-us N]\n", argv[0]); return 2; }
+  }
+
+  HAL_Init();
+  fail = check_order();
+
+  memset(&poll_tmr, 0, sizeof(poll_tmr));
+  memset(&chore_tmr, 0, sizeof(chore_tmr));
+  TMR_Start(&poll_tmr, 5, 5, poll_due, NULL);
+  TMR_Start(&chore_tmr, 50, 50, chore_due, NULL);
+
+  signal(SIGALRM, on_alarm);
+  it.it_interval.tv_sec  = 0;
+  it.it_interval.tv_usec = (suseconds_t)isr_us;
+  it.it_value = it.it_interval;
+  setitimer(ITIMER_REAL, &it, NULL);
+
+  t0 = now_us();
+  while (now_us() - t0 < (uint64_t)secs * 1000000u) {
+    if (SCHED_RunOnce()) continue;
+    if (TMR_Poll()) continue;
+    TMR_Sleep(UINT32_MAX);
+  }
+  memset(&it, 0, sizeof(it));
+  setitimer(ITIMER_REAL, &it, NULL);
+  while (SCHED_RunOnce()) { }
+  run_us = now_us() - t0;
+
+  printf("isr posts %lu, ran %lu, dropped %lu, gaps %lu\n",
+         (unsigned long)isr_posted, (unsigned long)isr_ran,
+         (unsigned long)isr_lost, (unsigned long)isr_gaps);
+  printf("latency avg %lu us, max %lu us (poll task %lu us)\n",
+         (unsigned long)(isr_ran ? lat_sum / isr_ran : 0),
+         (unsigned long)lat_max, (unsigned long)poll_us);
+  printf("polls %lu, chores %lu, asleep %lu%%\n", (unsigned long)polls,
+         (unsigned long)chores, (unsigned long)(slept_us * 100u / run_us));
+  printf("high water: high %u, normal %u, low %u (of %u)\n",
+         SCHED_HighWater(SCHED_PRIO_HIGH), SCHED_HighWater(SCHED_PRIO_NORMAL),
+         SCHED_HighWater(SCHED_PRIO_LOW), (unsigned)SCHED_QUEUE_LEN);
+
+  if (isr_ran != isr_posted || isr_gaps != isr_lost) {
+    printf("interrupt posts: FAIL\n");
+    fail = 1;
+  } else {
+    printf("interrupt posts: ok\n");
+  }
+  return fail;
+}
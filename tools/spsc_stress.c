@@ -0,0 +1,189 @@
+/* SPSC ring stress test and microbenchmark.
+
+   Instantiates spsc.h on the host. Stress: a producer and a consumer thread
+   move a numbered sequence through small rings, mixing single and batch
+   calls and DMA-style span()/drop(), and the consumer checks that every
+   element arrives once and in order. Bench: nanoseconds and TSC cycles per
+   element for push/pop and for batches, single threaded. On the target,
+   the same loops can be timed with DWT->CYCCNT. A side that cannot make
+   progress yields, so this also works on a single CPU.
+
+   Build: cc -O2 -Wall -pthread -Itools/host -iquote ble_status_test/Core/Inc \
+             -o spsc_stress tools/spsc_stress.c
+   Run:   ./spsc_stress [--count 2000000]
+   (-iquote so that <sched.h> is the system one, not the firmware's) */
+#include "spsc.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+SPSC_DEFINE(q8,  uint32_t, 8)
+SPSC_DEFINE(q64, uint32_t, 64)
+SPSC_DEFINE(qb,  uint8_t,  128)
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t cycles(void)
+{
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/* ---- stress ---- */
+
+static uint32_t count = 2000000u;
+static q8_t     ring8;
+static q64_t    ring64;
+static volatile int failed;
+
+static void *produce8(void *arg)
+{
+  uint32_t next = 0, batch[5];
+  (void)arg;
+  while (next < count && !failed) {
+    if (next & 1u) {
+      if (q8_push(&ring8, &next)) next++;
+      else sched_yield();
+    } else {
+      uint16_t n = (uint16_t)(1u + next % 5u), got;
+      if (n > count - next) n = (uint16_t)(count - next);
+      for (uint16_t i = 0; i < n; ++i) batch[i] = next + i;
+      got = (next & 2u) ? q8_push_n(&ring8, batch, n)
+                        : (q8_push_all(&ring8, batch, n) ? n : 0);
+      if (!got) sched_yield();
+      next += got;
+    }
+  }
+  return NULL;
+}
+
+static void *consume8(void *arg)
+{
+  uint32_t want = 0, v[6];
+  (void)arg;
+  while (want < count && !failed) {
+    uint16_t n;
+    if (want % 3u == 0) {
+      n = q8_pop(&ring8, v) ? 1 : 0;
+    } else {
+      n = q8_pop_n(&ring8, v, 6);
+    }
+    if (!n) sched_yield();
+    for (uint16_t i = 0; i < n; ++i, ++want) {
+      if (v[i] != want) {
+        printf("q8: got %u, want %u\n", v[i], want);
+        failed = 1;
+        break;
+      }
+    }
+  }
+  return NULL;
+}
+
+/* DMA style: read in place via span(), then release */
+static void *produce64(void *arg)
+{
+  uint32_t next = 0, batch[17];
+  (void)arg;
+  while (next < count && !failed) {
+    uint16_t n = (uint16_t)(1u + next % 17u), got;
+    if (n > count - next) n = (uint16_t)(count - next);
+    for (uint16_t i = 0; i < n; ++i) batch[i] = next + i;
+    got = q64_push_n(&ring64, batch, n);
+    if (!got) sched_yield();
+    next += got;
+  }
+  return NULL;
+}
+
+static void *consume64(void *arg)
+{
+  uint32_t want = 0, *p;
+  (void)arg;
+  while (want < count && !failed) {
+    uint16_t n = q64_span(&ring64, &p);
+    if (!n) sched_yield();
+    for (uint16_t i = 0; i < n; ++i, ++want) {
+      if (p[i] != want) {
+        printf("q64: got %u, want %u\n", p[i], want);
+        failed = 1;
+        break;
+      }
+    }
+    q64_drop(&ring64, n);
+  }
+  return NULL;
+}
+
+static void stress(const char *name, void *(*prod)(void *), void *(*cons)(void *))
+{
+  pthread_t tp, tc;
+  uint64_t t0 = now_ns(), dt;
+  pthread_create(&tc, NULL, cons, NULL);
+  pthread_create(&tp, NULL, prod, NULL);
+  pthread_join(tp, NULL);
+  pthread_join(tc, NULL);
+  dt = now_ns() - t0;
+  printf("stress %-5s %u elements, %.1f M/s: %s\n", name, count,
+         (double)count * 1000.0 / (double)dt, failed ? "FAIL" : "ok");
+}
+
+/* ---- bench ---- */
+
+#define BENCH_N  10000000u
+
+static qb_t ringb;
+
+static void bench(void)
+{
+  uint8_t  buf[20], b = 0;
+  uint64_t t0, c0;
+  volatile uint32_t sink = 0;
+
+  t0 = now_ns(); c0 = cycles();
+  for (uint32_t i = 0; i < BENCH_N; ++i) {
+    (void)qb_push(&ringb, &b);
+    (void)qb_pop(&ringb, &b);
+    sink += b;
+  }
+  printf("push+pop   1 byte : %5.2f ns, %5.1f cycles / byte\n",
+         (double)(now_ns() - t0) / BENCH_N, (double)(cycles() - c0) / BENCH_N);
+
+  memset(buf, 0x5A, sizeof(buf));
+  t0 = now_ns(); c0 = cycles();
+  for (uint32_t i = 0; i < BENCH_N / 20u; ++i) {
+    (void)qb_push_all(&ringb, buf, sizeof(buf));
+    sink += qb_pop_n(&ringb, buf, sizeof(buf));
+  }
+  printf("push+pop  20 bytes: %5.2f ns, %5.1f cycles / byte\n",
+         (double)(now_ns() - t0) / BENCH_N, (double)(cycles() - c0) / BENCH_N);
+  (void)sink;
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--count") && i + 1 < argc) count = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else { fprintf(stderr, "usage: %s [--count N]\n", argv[0]); return 2; }
+  }
+  stress("q8", produce8, consume8);
+  stress("q64", produce64, consume64);
+  bench();
+  return failed;
+}
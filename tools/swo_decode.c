@@ -0,0 +1,238 @@
+/* SWO/ITM stream decoder.
+
+   Reads raw SWO bytes as captured from PB3 (a USB-UART at TRACE_SWO_HZ, or
+   a debugger's SWO capture with its own TPIU setup disabled) and prints the
+   firmware's trace ports in time order: log text (port 0), events (port 1)
+   and profiler samples (port 2), see trace.h. Times come from the ITM local
+   timestamps (64 core cycles per unit) converted with the clock announced
+   by the last TRACE_EV_CLK event. PN532 I2C recordings (port 3, built with
+   TRACE_I2C 1) come out as one I2C trace dump with every byte, between
+   "I2C BEGIN" and "I2C END": input for i2c_timeline and for replay
+   (tools/host/i2c_replay.h).
+
+   Build: cc -O2 -Wall -Itools/host -Ible_status_test/Core/Inc -o swo_decode \
+             tools/swo_decode.c
+   Run:   stty -F /dev/ttyUSB0 raw 131072 && cat /dev/ttyUSB0 | ./swo_decode
+          ./swo_decode capture.bin [--prescale 64] [--khz 32000] */
+#include "trace.h"
+#include "prof.h"
+#include "i2c_trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ProfId_t order */
+static const char *const k_prof[PROF_N] = {
+  "pn_tx", "pn_ready", "pn_ack", "pn_rx", "pn_parse", "poll", "ble_print", "cmd",
+};
+
+static const char *const k_events[] = {
+  [TRACE_EV_CLK]    = "clk",
+  [TRACE_EV_POLL]   = "poll",
+  [TRACE_EV_UID]    = "uid",
+  [TRACE_EV_TXFULL] = "txfull",
+  [TRACE_EV_CMD]    = "cmd",
+  [TRACE_EV_MEMLOW] = "memlow",
+};
+#define N_EVENTS  (sizeof(k_events) / sizeof(k_events[0]))
+
+static FILE    *in;
+static double   now_ms;             /* time of the last timestamp packet */
+static uint32_t khz = 32000;
+static uint32_t prescale = 64;
+static uint32_t overflows, unknown;
+
+/* Items seen since the last timestamp; they are stamped with the next one */
+#define PEND_MAX  64
+static char pend[PEND_MAX][600];
+static int  pend_n;
+
+static char text[256];
+static int  text_n;
+
+static void flush(char mark)
+{
+  for (int i = 0; i < pend_n; ++i)
+    printf("%12.3f%c %s\n", now_ms, mark, pend[i]);
+  pend_n = 0;
+}
+
+static void add(const char *s)
+{
+  if (pend_n == PEND_MAX) flush('~');
+  snprintf(pend[pend_n++], sizeof(pend[0]), "%s", s);
+}
+
+static int next(void)
+{
+  return fgetc(in);
+}
+
+/* 7-bit groups while bit 7 is set, up to 4 bytes (5 for extension packets) */
+static uint32_t continuation(int max)
+{
+  uint32_t v = 0;
+  for (int i = 0; i < max; ++i) {
+    int b = next();
+    if (b < 0) break;
+    v |= (uint32_t)(b & 0x7F) << (7 * i);
+    if (!(b & 0x80)) break;
+  }
+  return v;
+}
+
+static void on_text(uint32_t w, int size)
+{
+  char line[300];
+  for (int i = 0; i < size; ++i) {
+    char c = (char)(w >> (8 * i));
+    if (c == '\r') continue;
+    if (c != '\n' && text_n < (int)sizeof(text) - 1) { text[text_n++] = c; continue; }
+    if (c != '\n') continue;
+    text[text_n] = 0;
+    snprintf(line, sizeof(line), "[log] %s", text);
+    add(line);
+    text_n = 0;
+  }
+}
+
+static void on_event(uint32_t w)
+{
+  char line[96];
+  uint32_t id = w >> 24, v = w & 0x00FFFFFFu;
+  const char *name = (id < N_EVENTS && k_events[id]) ? k_events[id] : NULL;
+
+  if (id == TRACE_EV_CLK && v) khz = v;
+  if (id == TRACE_EV_UID)
+    snprintf(line, sizeof(line), "[ev ] uid %02X%02X%02X..", v >> 16, (v >> 8) & 0xFFu, v & 0xFFu);
+  else if (name)
+    snprintf(line, sizeof(line), "[ev ] %s %u", name, v);
+  else
+    snprintf(line, sizeof(line), "[ev ] #%u %u", id, v);
+  add(line);
+}
+
+static void on_prof(uint32_t w)
+{
+  char line[96];
+  uint32_t id = w >> 24, t = w & 0x00FFFFFFu;
+  snprintf(line, sizeof(line), "[prf] %-9s %u.%u us", id < PROF_N ? k_prof[id] : "?", t / 10u, t % 10u);
+  add(line);
+}
+
+/* Port 3: header word, start time, then len bytes in packets of any size */
+static struct {
+  int      state;                   /* 0 header, 1 time, 2 bytes */
+  uint32_t hdr, t_us;
+  uint16_t got;
+  uint8_t  data[255];
+  bool     begun;
+} rec;
+static uint32_t rec_lost;
+
+static void rec_done(void)
+{
+  static const char k_hex[] = "0123456789ABCDEF";
+  char line[600];
+  uint32_t len = rec.hdr & 0xFFu;
+  int w = snprintf(line, sizeof(line), "I2C %lu %c %u %u %u 1 ", (unsigned long)rec.t_us,
+                   (rec.hdr >> 23 & 1u) ? 'R' : 'W', len, rec.hdr >> 21 & 3u, rec.hdr >> 8 & 0x1FFFu);
+
+  if (!rec.begun) {
+    add("I2C BEGIN recording");
+    rec.begun = true;
+  }
+  for (uint32_t i = 0; i < len && w + 3 < (int)sizeof(line); ++i) {
+    line[w++] = k_hex[rec.data[i] >> 4];
+    line[w++] = k_hex[rec.data[i] & 0x0Fu];
+  }
+  line[w] = 0;
+  add(line);
+  rec.state = 0;
+}
+
+static void on_i2c(uint32_t w, int size)
+{
+  if (rec.state == 2) {
+    for (int i = 0; i < size && rec.state == 2; ++i) {
+      rec.data[rec.got++] = (uint8_t)(w >> (8 * i));
+      if (rec.got == (rec.hdr & 0xFFu)) rec_done();
+    }
+    return;
+  }
+  if (size != 4) { rec_lost++; return; }
+  if (rec.state == 1) {
+    rec.t_us  = w;
+    rec.got   = 0;
+    rec.state = 2;
+    if (!(rec.hdr & 0xFFu)) rec_done();
+  } else if (w >> 24 == I2CT_REC_MAGIC) {
+    rec.hdr   = w;
+    rec.state = 1;
+  } else {
+    rec_lost++;                     /* out of step after a dropped word */
+  }
+}
+
+static void on_timestamp(uint32_t units)
+{
+  now_ms += (double)units * prescale / (double)khz;
+  flush(' ');
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = NULL;
+  int zeros = 0, b;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--prescale") && i + 1 < argc) prescale = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--khz") && i + 1 < argc) khz = (uint32_t)atoi(argv[++i]);
+    else if (argv[i][0] != '-' || !strcmp(argv[i], "-")) path = argv[i];
+    else { fprintf(stderr, "usage: %s [file|-] [--prescale N] [--khz N]\n", argv[0]); return 2; }
+  }
+  in = (!path || !strcmp(path, "-")) ? stdin : fopen(path, "rb");
+  if (!in) { perror(path); return 1; }
+
+  while ((b = next()) >= 0) {
+    if (b == 0x00) { zeros++; continue; }                 /* synchronisation */
+    if (zeros) {
+      bool sync = (zeros >= 5 && b == 0x80);
+      zeros = 0;
+      if (sync) continue;
+    }
+    if (b == 0x70) {                                      /* overflow: packets lost */
+      overflows++;
+      add("[---] overflow");
+    } else if ((b & 0x0F) == 0x00) {                      /* local timestamp */
+      on_timestamp((b & 0x80) ? continuation(4) : (uint32_t)((b >> 4) & 0x7));
+    } else if (b == 0x94 || b == 0xB4) {                  /* global timestamp */
+      (void)continuation(5);
+    } else if ((b & 0x0B) == 0x08) {                      /* extension */
+      if (b & 0x80) (void)continuation(5);
+    } else if (b & 0x03) {                                /* source packet */
+      static const int k_size[4] = { 0, 1, 2, 4 };
+      int size = k_size[b & 0x03], port = b >> 3;
+      uint32_t w = 0;
+      for (int i = 0; i < size; ++i) {
+        int c = next();
+        if (c < 0) break;
+        w |= (uint32_t)c << (8 * i);
+      }
+      if (b & 0x04) continue;                             /* DWT hardware packet */
+      if (port == TRACE_PORT_TEXT)                    on_text(w, size);
+      else if (port == TRACE_PORT_EVENT && size == 4) on_event(w);
+      else if (port == TRACE_PORT_PROF && size == 4)  on_prof(w);
+      else if (port == TRACE_PORT_I2C)                on_i2c(w, size);
+    } else {
+      unknown++;
+    }
+  }
+  if (rec.begun) add("I2C END");
+  flush('~');
+  if (text_n) { text[text_n] = 0; printf("%12.3f~ [log] %s\n", now_ms, text); }
+  fprintf(stderr, "swo_decode: %u overflow, %u unknown header bytes, %u I2C words out of step\n",
+          overflows, unknown, rec_lost);
+  return 0;
+}